@@ -115,21 +115,69 @@
 #include <string.h>
 #include "hanparser.h"
 #include "readings.h"
+#include "report_policy.h"
+#include "report_queue.h"
+#include "tx_feedback.h"
+#include "energy_estimator.h"
+#include "apparent_energy.h"
+#include "signal_filter.h"
+#include "report_backlog.h"
+#include "statistics.h"
+#include "timeseries.h"
+#include "history_wire.h"
+#include "meter_value.h"
+#include "frame_cost.h"
+#include "multi_cmd.h"
+#include "meter_report_cache.h"
+#include "CC_MeterTableMonitor.h"
+#include "CC_ManufacturerProprietary.h"
+#include "han_tunnel.h"
 #include "em_usart.h"
+#include "em_emu.h"
+#include "em_cmu.h"
 
 #include "CC_Configuration.h"
 
 /*********************** AMS2ZWAVE function prototypes ************************/
 void HAN_callback(const han_parser_data_t* decoded_data);
+void HAN_processReadings(void);
 void HAN_serial_rx();
+void HAN_tunnelFrame(void);
+void HAN_powerfail();
 void HAN_setup();
 void HAN_loadFromNVM(void);
-void HAN_storeToNVM(bool update_meter, bool update_accumulated);
+bool HAN_storeToNVM(bool update_meter, bool update_accumulated);
+void HAN_scheduleStoreToNVM(bool update_meter, bool update_accumulated);
+void HAN_resetValues(void);
 void HAN_resetNVM(void);
+uint32_t HAN_hashGsin(const char* gsin);
+bool HAN_isActiveMeter(const char* gsin);
+void HAN_switchMeterProfile(const han_parser_data_t* decoded_data, uint32_t gsin_hash);
+uint32_t HAN_retainTimestamp(void);
+uint32_t HAN_retainMaxAge(void);
 
 void* CC_Meter_prepare_zaf_tse_data(RECEIVE_OPTIONS_TYPE_EX* pRxOpt);
 void CC_Meter_update_power(void);
 void CC_Meter_update_energy(void);
+void CC_Meter_update_energy_export(void);
+void CC_Meter_update_reactive_power(void);
+void CC_Meter_update_reactive_energy(void);
+void CC_Meter_update_apparent_energy(void);
+void CC_Meter_update_snapshot(void);
+void CC_Meter_update_voltage(uint8_t phase);
+void CC_Meter_update_current(uint8_t phase);
+void CC_Meter_update_energy_estimate(void);
+void CC_Meter_stream_power(void);
+uint32_t CC_Meter_energy_estimate(void);
+int32_t CC_Meter_net_power(void);
+int32_t CC_Meter_net_reactive_power(void);
+int32_t CC_Meter_filtered_power(void);
+int32_t CC_Meter_filtered_current(uint8_t phase);
+int32_t CC_Meter_phase_voltage(uint8_t phase);
+int32_t CC_Meter_phase_current(uint8_t phase);
+void CC_Meter_refresh_report_cache(void);
+void CC_Meter_backlog_result(bool success);
+uint32_t CC_Meter_uptime_s(void);
 void CC_Meter_report_unhandled_as_voltage(
     TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
     void* pData);
@@ -149,6 +197,12 @@ handleCommandClassConfiguration(
   RECEIVE_OPTIONS_TYPE_EX *rxOpt,
   ZW_APPLICATION_TX_BUFFER *pCmd,
   uint8_t cmdLength);
+
+received_frame_status_t
+handleCommandClassMultiCmd(
+  RECEIVE_OPTIONS_TYPE_EX *rxOpt,
+  ZW_APPLICATION_TX_BUFFER *pCmd,
+  uint8_t cmdLength);
 /******************* end AMS2ZWAVE function prototypes ************************/
 
 /****************************************************************************/
@@ -189,9 +243,13 @@ static uint8_t cmdClassListNonSecureNotIncluded[] =
   COMMAND_CLASS_ZWAVEPLUS_INFO,
   COMMAND_CLASS_METER_V5,
   COMMAND_CLASS_CONFIGURATION_V4,
+  COMMAND_CLASS_MULTI_CMD,
+  COMMAND_CLASS_METER_TBL_MONITOR_V2,
+  COMMAND_CLASS_MANUFACTURER_PROPRIETARY,
   COMMAND_CLASS_ASSOCIATION_V2,
   COMMAND_CLASS_ASSOCIATION_GRP_INFO,
   COMMAND_CLASS_MULTI_CHANNEL_ASSOCIATION_V2,
+  COMMAND_CLASS_MULTI_CHANNEL_V4,
   COMMAND_CLASS_TRANSPORT_SERVICE_V2,
   COMMAND_CLASS_VERSION,
   COMMAND_CLASS_MANUFACTURER_SPECIFIC,
@@ -224,8 +282,12 @@ static uint8_t cmdClassListSecure[] =
   COMMAND_CLASS_VERSION,
   COMMAND_CLASS_METER_V5,
   COMMAND_CLASS_CONFIGURATION_V4,
+  COMMAND_CLASS_MULTI_CMD,
+  COMMAND_CLASS_METER_TBL_MONITOR_V2,
+  COMMAND_CLASS_MANUFACTURER_PROPRIETARY,
   COMMAND_CLASS_ASSOCIATION,
   COMMAND_CLASS_MULTI_CHANNEL_ASSOCIATION_V2,
+  COMMAND_CLASS_MULTI_CHANNEL_V4,
   COMMAND_CLASS_ASSOCIATION_GRP_INFO,
   COMMAND_CLASS_MANUFACTURER_SPECIFIC,
   COMMAND_CLASS_DEVICE_RESET_LOCALLY,
@@ -245,6 +307,63 @@ app_node_information_t m_AppNIF =
   DEVICE_OPTIONS_MASK, {GENERIC_TYPE, SPECIFIC_TYPE}
 };
 
+/**
+ * One endpoint per phase, each a meter of its own for voltage and current, and
+ * one for the estimated energy so it can't be mistaken for the meter reading
+ */
+static EP_FUNCTIONALITY_DATA endPointFunctionality =
+{
+  NUMBER_OF_INDIVIDUAL_ENDPOINTS,         /**< nbrIndividualEndpoints 7 bit*/
+  RES_ZERO,                               /**< resIndZeorBit 1 bit*/
+  NUMBER_OF_AGGREGATED_ENDPOINTS,         /**< nbrAggregatedEndpoints 7 bit*/
+  RES_ZERO,                               /**< resAggZeorBit 1 bit*/
+  RES_ZERO,                               /**< resZero 6 bit*/
+  ENDPOINT_IDENTICAL_DEVICE_CLASS_YES,    /**< identical 1 bit*/
+  ENDPOINT_DYNAMIC_NO                     /**< dynamic 1 bit*/
+};
+
+static uint8_t ep_noSec_InclNonSecure[] =
+{
+  COMMAND_CLASS_ZWAVEPLUS_INFO,
+  COMMAND_CLASS_METER_V5,
+  COMMAND_CLASS_ASSOCIATION_V2,
+  COMMAND_CLASS_ASSOCIATION_GRP_INFO,
+  COMMAND_CLASS_MULTI_CHANNEL_ASSOCIATION_V2,
+  COMMAND_CLASS_SECURITY,
+  COMMAND_CLASS_SECURITY_2,
+  COMMAND_CLASS_SUPERVISION
+};
+
+static uint8_t ep_noSec_InclSecure[] =
+{
+  COMMAND_CLASS_ZWAVEPLUS_INFO,
+  COMMAND_CLASS_SUPERVISION
+};
+
+static uint8_t ep_sec_InclSecure[] =
+{
+  COMMAND_CLASS_METER_V5,
+  COMMAND_CLASS_ASSOCIATION,
+  COMMAND_CLASS_MULTI_CHANNEL_ASSOCIATION_V2,
+  COMMAND_CLASS_ASSOCIATION_GRP_INFO
+};
+
+#define METER_ENDPOINT_NIF \
+  { GENERIC_TYPE_METER, SPECIFIC_TYPE_SIMPLE_METER, \
+    { \
+      {ep_noSec_InclNonSecure, sizeof(ep_noSec_InclNonSecure)}, \
+      {{ep_noSec_InclSecure, sizeof(ep_noSec_InclSecure)}, {ep_sec_InclSecure, sizeof(ep_sec_InclSecure)}} \
+    } \
+  }
+
+static EP_NIF endpointsNIF[NUMBER_OF_ENDPOINTS] =
+{
+  METER_ENDPOINT_NIF, /* EP 1: L1 */
+  METER_ENDPOINT_NIF, /* EP 2: L2 */
+  METER_ENDPOINT_NIF, /* EP 3: L3 */
+  METER_ENDPOINT_NIF  /* EP 4: energy estimate */
+};
+
 
 /**
 * Set up security keys to request when joining a network.
@@ -284,16 +403,26 @@ static const SProtocolConfig_t ProtocolConfig = {
  * Setup AGI lifeline table from config_app.h
  */
 CMD_CLASS_GRP  agiTableLifeLine[] = {AGITABLE_LIFELINE_GROUP};
+CMD_CLASS_GRP  agiTableLifeLineEndpoints[] = {AGITABLE_LIFELINE_GROUP_EP1_4};
 
-// Removed all references to AGI root device, since we don't associate with any
-// device besides lifeline
+/**
+ * Setup AGI root device groups table from config_app.h
+ */
+AGI_GROUP agiTableRootDeviceGroups[] = {AGITABLE_ROOTDEVICE_GROUPS};
 
 /**************************************************************************************************
  * Configuration for Z-Wave Plus Info CC
  **************************************************************************************************
  */
+static SEndpointIcon ZWavePlusEndpointIcons[] = {ENDPOINT_ICONS};
+
+static SEndpointIconList ZWavePlusEndpointIconList = {
+                                                      .pEndpointInfo = ZWavePlusEndpointIcons,
+                                                      .endpointInfoSize = sizeof_array(ZWavePlusEndpointIcons)
+};
+
 static const SCCZWavePlusInfo CCZWavePlusInfo = {
-                               .pEndpointIconList = NULL,
+                               .pEndpointIconList = &ZWavePlusEndpointIconList,
                                .roleType = APP_ROLE_TYPE,
                                .nodeType = APP_NODE_TYPE,
                                .installerIconType = APP_ICON_TYPE,
@@ -322,7 +451,12 @@ SApplicationHandles* g_pAppHandles;
 // Prioritized events that can wakeup protocol thread.
 typedef enum EApplicationEvent
 {
-  EAPPLICATIONEVENT_TIMER = 0,
+  EAPPLICATIONEVENT_POWERFAIL = 0,  /* Supply voltage is dropping, flagged by
+                                     * the EMU voltage monitor. Triggers an
+                                     * emergency save of the meter state.
+                                     * First, so nothing else queued up gets
+                                     * to eat into the hold-up time. */
+  EAPPLICATIONEVENT_TIMER,
   EAPPLICATIONEVENT_ZWRX,
   EAPPLICATIONEVENT_ZWCOMMANDSTATUS,
   EAPPLICATIONEVENT_APP,
@@ -343,7 +477,8 @@ static SEventDistributor g_EventDistributor;
 // Event distributor event handler table
 static const EventDistributorEventHandler g_aEventHandlerTable[] =
 {
-  AppTimerNotificationHandler,  // Event 0
+  HAN_powerfail,                // Event 0
+  AppTimerNotificationHandler,
   EventHandlerZwRx,
   EventHandlerZwCommandStatus,
   EventHandlerApp,
@@ -385,6 +520,11 @@ static RECEIVE_OPTIONS_TYPE_EX zaf_tse_local_actuation = {
 
 static nvm3_Handle_t* pFileSystemApplication;
 
+/**
+ * Set when the readings were restored from retained RAM at startup.
+ */
+static bool warm_start = false;
+
 /****************************************************************************/
 /*                              EXPORTED DATA                               */
 /****************************************************************************/
@@ -397,6 +537,7 @@ static nvm3_Handle_t* pFileSystemApplication;
 
 void DeviceResetLocallyDone(TRANSMISSION_RESULT * pTransmissionResult);
 void DeviceResetLocally(void);
+static void OtaFinished(OTA_STATUS otaStatus);
 STATE_APP GetAppState(void);
 void AppStateManager(EVENT_APP event);
 static void ChangeState(STATE_APP newState);
@@ -478,7 +619,15 @@ static void EventHandlerZwCommandStatus(void)
           DPRINT("Tx Status received\r\n");
           if (ZAF_TSE_TXCallback == pTxStatus->Handle)
           {
-            // TSE do not use the TX result to anything. Hence, we pass NULL.
+            // The outcome of meter reports feeds the reporting backoff.
+            uint8_t level = tx_feedback_backoff_level;
+            tx_feedback_result(TRANSMIT_COMPLETE_OK == pTxStatus->TxStatus,
+                               pTxStatus->ExtendedTxStatus.TransmitTicks * 10);
+            if (level != tx_feedback_backoff_level)
+            {
+              DPRINTF("Reporting backoff level %u\n", tx_feedback_backoff_level);
+            }
+            CC_Meter_backlog_result(TRANSMIT_COMPLETE_OK == pTxStatus->TxStatus);
             ZAF_TSE_TXCallback(NULL);
           }
           else if (pTxStatus->Handle)
@@ -863,6 +1012,18 @@ Transport_ApplicationCommandHandlerEx(
     case COMMAND_CLASS_CONFIGURATION_V4:
       frame_status = handleCommandClassConfiguration(rxOpt, pCmd, cmdLength);
       break;
+
+    case COMMAND_CLASS_MULTI_CMD:
+      frame_status = handleCommandClassMultiCmd(rxOpt, pCmd, cmdLength);
+      break;
+
+    case COMMAND_CLASS_METER_TBL_MONITOR_V2:
+      frame_status = handleCommandClassMeterTableMonitor(rxOpt, pCmd, cmdLength);
+      break;
+
+    case COMMAND_CLASS_MANUFACTURER_PROPRIETARY:
+      frame_status = handleCommandClassManufacturerProprietary(rxOpt, pCmd, cmdLength);
+      break;
   }
   return frame_status;
 }
@@ -882,14 +1043,29 @@ static void doRemainingInitialization()
   /* Load the application settings from NVM3 file system */
   LoadConfiguration();
 
+  /* Resume with the readings from before a soft/watchdog reset, if any */
+  warm_start = readings_restore(HAN_retainTimestamp(), HAN_retainMaxAge(),
+                                CMU_ClockFreqGet(cmuClock_RTCC),
+                                xTaskGetTickCount() * portTICK_PERIOD_MS);
+  DPRINTF("%s start\n", warm_start ? "Warm" : "Cold");
+
+  /* Have Meter Get answers ready from the start */
+  CC_Meter_refresh_report_cache();
+
   // Setup AGI group lists
   AGI_Init();
   CC_AGI_LifeLineGroupSetup(agiTableLifeLine, (sizeof(agiTableLifeLine)/sizeof(CMD_CLASS_GRP)), ENDPOINT_ROOT );
+  AGI_ResourceGroupSetup(agiTableRootDeviceGroups, (sizeof(agiTableRootDeviceGroups)/sizeof(AGI_GROUP)), ENDPOINT_ROOT);
+  CC_AGI_LifeLineGroupSetup(agiTableLifeLineEndpoints, (sizeof(agiTableLifeLineEndpoints)/sizeof(CMD_CLASS_GRP)), ENDPOINT_1 );
+  CC_AGI_LifeLineGroupSetup(agiTableLifeLineEndpoints, (sizeof(agiTableLifeLineEndpoints)/sizeof(CMD_CLASS_GRP)), ENDPOINT_2 );
+  CC_AGI_LifeLineGroupSetup(agiTableLifeLineEndpoints, (sizeof(agiTableLifeLineEndpoints)/sizeof(CMD_CLASS_GRP)), ENDPOINT_3 );
+  CC_AGI_LifeLineGroupSetup(agiTableLifeLineEndpoints, (sizeof(agiTableLifeLineEndpoints)/sizeof(CMD_CLASS_GRP)), ENDPOINT_ENERGY_ESTIMATE );
 
   /*
    * Initialize Event Scheduler.
    */
   Transport_OnApplicationInitSW( &m_AppNIF, NULL);
+  Transport_AddEndpointSupport( &endPointFunctionality, endpointsNIF, NUMBER_OF_ENDPOINTS);
 
   /* Enter SmartStart*/
   /* Protocol will commence SmartStart only if the node is NOT already included in the network */
@@ -897,6 +1073,10 @@ static void doRemainingInitialization()
 
   /* Init state machine*/
   ZAF_EventHelperEventEnqueue(EVENT_EMPTY);
+
+  if (warm_start) {
+    ZAF_EventHelperEventEnqueue(EVENT_APP_WARM_START);
+  }
 }
 
 /**
@@ -917,6 +1097,14 @@ AppStateManager(EVENT_APP event)
     DeviceResetLocally();
   }
 
+  // The readings are worked through whatever the state, the reports only go
+  // out when idle
+  if (EVENT_APP_POWER_UPDATE_FAST == event ||
+      EVENT_APP_POWER_UPDATE_SLOW == event ||
+      EVENT_APP_ENERGY_UPDATE == event) {
+    HAN_processReadings();
+  }
+
   switch(currentState)
   {
 
@@ -933,7 +1121,7 @@ AppStateManager(EVENT_APP event)
         HAN_setup();
         break;
       }
-      CC_FirmwareUpdate_Init(NULL, NULL, NULL, true);
+      CC_FirmwareUpdate_Init(NULL, NULL, OtaFinished, true);
       ChangeState(STATE_APP_IDLE);
       break;
 
@@ -977,45 +1165,114 @@ AppStateManager(EVENT_APP event)
         ChangeState(STATE_APP_LEARN_MODE);
       }
 
+      // Which readings are worth a report is up to the reporting policy
+      uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
       bool send_power_report = false;
+      bool send_energy_report = false;
+      bool send_export_report = false;
+      bool send_reactive_report = false;
+
       // ACTION: AMS2ZWAVE list 1 received (2.5s interval)
       if (EVENT_APP_POWER_UPDATE_FAST == event ||
           EVENT_APP_POWER_UPDATE_SLOW == event ||
           EVENT_APP_ENERGY_UPDATE == event) {
-        if( CC_ConfigurationData.power_change_for_meter_report > 0 ) {
-          uint32_t watt_trigger = CC_ConfigurationData.power_change_for_meter_report * 100;
-          if( active_power_watt > last_reported_power_watt + watt_trigger ||
-              ((last_reported_power_watt >= watt_trigger) && (active_power_watt < last_reported_power_watt - watt_trigger)) ) {
-            send_power_report = true;
-          }
-        }
+        send_power_report = report_policy_evaluate(METRIC_POWER, CC_Meter_filtered_power(), now_ms);
+      }
+
+      // ACTION: every power reading goes out on the power stream, if anyone
+      // listens to it
+      if (EVENT_APP_POWER_UPDATE_FAST == event ||
+          EVENT_APP_POWER_UPDATE_SLOW == event ||
+          EVENT_APP_ENERGY_UPDATE == event) {
+        CC_Meter_stream_power();
+      }
+
+      // ACTION: reactive power comes with list 2 and 3, and follows the same
+      // policy as active power
+      if (EVENT_APP_POWER_UPDATE_SLOW == event ||
+          EVENT_APP_ENERGY_UPDATE == event) {
+        send_reactive_report = report_policy_evaluate(METRIC_REACTIVE_POWER, CC_Meter_net_reactive_power(), now_ms);
+      }
+
+      // ACTION: tunnel a raw HAN frame to the controller
+      if (EVENT_APP_HAN_FRAME == event) {
+        HAN_tunnelFrame();
       }
 
       // ACTION: AMS2ZWAVE list 2 received (10s interval)
+      // Each phase reports from its own endpoint, and only when its own
+      // values call for it. These aren't part of the root bundle.
       if (EVENT_APP_POWER_UPDATE_SLOW == event ||
           EVENT_APP_ENERGY_UPDATE == event) {
-        // 'slow' updates still come in every 10 seconds. Considering the low
-        // throughput of a z-wave network, reporting every 30s is more than
-        // plenty (and maybe still unwanted).
-        static uint8_t iterations = 0;
-        if(CC_ConfigurationData.amount_of_10s_reports_for_meter_report > 0) {
-          iterations++;
-          if(iterations >= CC_ConfigurationData.amount_of_10s_reports_for_meter_report) {
-              send_power_report = true;
-              iterations = 0;
+        uint8_t phases = is_3phase ? 3 : 1;
+        for (uint8_t phase = 1; phase <= phases; phase++) {
+          if (report_policy_evaluate(METRIC_VOLTAGE_L1 + phase - 1, CC_Meter_phase_voltage(phase), now_ms)) {
+            CC_Meter_update_voltage(phase);
+          }
+          if (report_policy_evaluate(METRIC_CURRENT_L1 + phase - 1, CC_Meter_filtered_current(phase), now_ms)) {
+            CC_Meter_update_current(phase);
           }
         }
       }
 
-      // ACTION: report on hourly update
+      // ACTION: report the energy estimate in between hourly readings
+      bool send_estimate_report = false;
+      if ((EVENT_APP_POWER_UPDATE_FAST == event ||
+           EVENT_APP_POWER_UPDATE_SLOW == event) &&
+          energy_estimator_valid()) {
+        send_estimate_report = report_policy_evaluate(METRIC_ENERGY_ESTIMATE,
+                                                      CC_Meter_energy_estimate(),
+                                                      now_ms);
+      }
+
+      // ACTION: AMS2ZWAVE list 3 received (hourly)
       if (EVENT_APP_ENERGY_UPDATE == event) {
-        if(CC_ConfigurationData.enable_hourly_report == 1) {
+        send_energy_report = report_policy_evaluate(METRIC_ENERGY, total_meter_reading - meter_offset, now_ms);
+        // Only sites which have ever produced anything get export reports
+        if (total_export_reading != 0) {
+          send_export_report = report_policy_evaluate(METRIC_ENERGY_EXPORT, total_export_reading - export_offset, now_ms);
+        }
+        // Not part of the bundle, these go out on their own
+        if (total_reactive_import_reading != 0 &&
+            report_policy_evaluate(METRIC_REACTIVE_ENERGY, total_reactive_import_reading, now_ms)) {
+          CC_Meter_update_reactive_energy();
+        }
+        if (apparent_energy_total() != 0 &&
+            report_policy_evaluate(METRIC_APPARENT_ENERGY, apparent_energy_total(), now_ms)) {
+          CC_Meter_update_apparent_energy();
+        }
+      }
+
+      // ACTION: report the retained readings right away after a warm start
+      if (EVENT_APP_WARM_START == event && list1_recv) {
+        report_policy_reported(METRIC_POWER, CC_Meter_filtered_power(), now_ms);
+        send_power_report = true;
+      }
+
+      if(CC_ConfigurationData.bundle_reports == 1) {
+        // One bundle carries all of them
+        if (send_power_report || send_energy_report || send_export_report ||
+            send_reactive_report) {
+          CC_Meter_update_snapshot();
+        }
+      } else {
+        if (send_power_report) {
+          CC_Meter_update_power();
+        }
+        if (send_energy_report) {
           CC_Meter_update_energy();
         }
+        if (send_export_report) {
+          CC_Meter_update_energy_export();
+        }
+        if (send_reactive_report) {
+          CC_Meter_update_reactive_power();
+        }
       }
 
-      if (send_power_report) {
-        CC_Meter_update_power();
+      // Not part of the bundle, it's on an endpoint of its own
+      if (send_estimate_report) {
+        CC_Meter_update_energy_estimate();
       }
 
       if (EVENT_APP_UNHANDLED_STATUS == event) {
@@ -1080,6 +1337,11 @@ AppStateManager(EVENT_APP event)
         DPRINT("\r\nLEARN MODE FINISH\r\n");
         ChangeState(STATE_APP_IDLE);
 
+        /* Give a freshly included controller the full picture right away */
+        if (EINCLUSIONSTATE_EXCLUDED != g_pAppHandles->pNetworkInfo->eInclusionState) {
+          CC_Meter_update_snapshot();
+        }
+
         /* If we are in a network and the Identify LED state was changed to idle due to learn mode, report it to lifeline */
         CC_Indicator_RefreshIndicatorProperties();
         ZAF_TSE_Trigger((void *)CC_Indicator_report_stx, &ZAF_TSE_localActuationIdentifyData, true);
@@ -1158,6 +1420,21 @@ DeviceResetLocally(void)
   CC_DeviceResetLocally_notification_tx(&lifelineProfile, DeviceResetLocallyDone);
 }
 
+/**
+ * @brief Called when a firmware update has ended. A successful one reboots
+ * into the new image, so configuration changes waiting for their commit
+ * window have to go out first.
+ * @param otaStatus Outcome of the update.
+ */
+static void
+OtaFinished(OTA_STATUS otaStatus)
+{
+  if (OTA_STATUS_DONE == otaStatus)
+  {
+    CC_Configuration_flush();
+  }
+}
+
 /**
  * @brief See description for function prototype in CC_Version.h.
  */
@@ -1481,25 +1758,100 @@ void HAN_serial_rx(void)
     han_parser_input_byte(rxBuf.data[read_buffer][i]);
   }
 
+  // Raw frames are collected next to the parser, and sent from the event loop
+  if(CC_ConfigurationData.han_tunnel == 1) {
+    bool frame_ready = false;
+    for(size_t i = 0; i < bytes; i++) {
+      frame_ready |= han_tunnel_input_byte(rxBuf.data[read_buffer][i]);
+    }
+    if(frame_ready) {
+      ZAF_EventHelperEventEnqueue(EVENT_APP_HAN_FRAME);
+    }
+  }
+
   rxBuf.data_size[read_buffer] = 0xFFFFFFFFUL;
 }
 
 // Business logic goes here!
 
+// Hash of the GSIN in meter_id, which keys the profile table
+static uint32_t active_meter_hash = 0;
+
+// A different GSIN has to come with this many list 2/3 frames in a row before
+// the meter counts as replaced, as switching wipes the history and statistics.
+// Until then the readings are taken as usual, except for the energy registers:
+// those would end up in the profile of the active meter.
+#define HAN_METER_SWITCH_FRAMES 3
+
+static struct {
+  char gsin[sizeof(meter_id)];
+  uint8_t frames;
+} han_meter_candidate;
+
+static bool HAN_isGsin(const char* stored, const char* gsin);
+static void HAN_copyString(char* dst, size_t dst_size, const char* src);
+
+// How often to routinely store the hourly accumulated value
+#define HAN_NVM_ACCUMULATED_INTERVAL_HOURS 6
+
+// What HAN_callback took in that HAN_processReadings() has yet to work through
+static struct {
+  uint32_t received_ms;
+  uint32_t timestamp;   // meter clock of the hourly frame
+  bool power;
+  bool line;
+  bool energy;
+} han_pending;
+
 // Receive decoded packet from parser and trigger event
 void HAN_callback(const han_parser_data_t* decoded_data) {
   bool is_list2 = false;
   bool is_list3 = false;
+  bool meter_pending = false;
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
 
   if(decoded_data->has_meter_data) {
-    if(memcmp(meter_id, decoded_data->meter_gsin, strlen(decoded_data->meter_gsin) + 1) != 0) {
-      // We got attached to a different meter than the one we were previously attached to
-      // invalidate persistently stored parameters
-      HAN_resetNVM();
+    // The GSIN itself tells whether this is still the active meter. Only a
+    // different one gets hashed, to look up its profile.
+    bool switch_meter = false;
+    if(HAN_isActiveMeter(decoded_data->meter_gsin)) {
+      han_meter_candidate.frames = 0;
+    } else if(active_meter_hash == 0) {
+      // Without an active meter there's nothing to lose by switching now
+      switch_meter = true;
+    } else {
+      if(han_meter_candidate.frames == 0 ||
+         !HAN_isGsin(han_meter_candidate.gsin, decoded_data->meter_gsin)) {
+        HAN_copyString(han_meter_candidate.gsin, sizeof(han_meter_candidate.gsin),
+                       decoded_data->meter_gsin);
+        han_meter_candidate.frames = 0;
+      }
+      meter_pending = ++han_meter_candidate.frames < HAN_METER_SWITCH_FRAMES;
+      switch_meter = !meter_pending;
+    }
 
-      // reset all in-RAM values too
+    if(switch_meter) {
+      han_meter_candidate.frames = 0;
+
+      // We got attached to a different meter than the one we were previously
+      // attached to. Park the state of the old meter in its profile and pick
+      // up where we left off with the new one, if we've seen it before.
+      HAN_switchMeterProfile(decoded_data, HAN_hashGsin(decoded_data->meter_gsin));
+
+      // reset all in-RAM values, they belong to the previous meter
       active_power_watt = 0;
+      active_power_export_watt = 0;
+      reactive_power_import_var = 0;
+      reactive_power_export_var = 0;
       last_reported_power_watt = 0;
+      report_policy_reset();
+      report_queue_reset();
+      energy_estimator_reset();
+      statistics_reset();
+      timeseries_reset();
+      signal_filter_reset();
+      report_backlog_reset();
+      CC_MeterTableMonitor_resetHistory();
 
       voltage_l1 = 0;
       voltage_l2 = 0;
@@ -1508,33 +1860,33 @@ void HAN_callback(const han_parser_data_t* decoded_data) {
       current_l1 = 0;
       current_l2 = 0;
       current_l3 = 0;
-
-      // Store new meter identity
-      memcpy(meter_id, decoded_data->meter_gsin,
-        (sizeof(meter_id) < strlen(decoded_data->meter_gsin) + 1 ?
-          sizeof(meter_id) :
-          strlen(decoded_data->meter_gsin) + 1) );
-      memcpy(meter_model, decoded_data->meter_model,
-        (sizeof(meter_model) < strlen(decoded_data->meter_model) + 1 ?
-          sizeof(meter_model) :
-          strlen(decoded_data->meter_gsin) + 1) );
-
-      HAN_storeToNVM(true, false);
     }
   }
 
+  han_pending.received_ms = now_ms;
+
   if(decoded_data->has_power_data) {
       active_power_watt = decoded_data->active_power_import;
-      DPRINTF("Active power: %d W\n", active_power_watt);
+      // list 1 only carries import power, export and reactive power come
+      // with lists 2 and 3
+      if(decoded_data->has_line_data || decoded_data->has_energy_data) {
+        active_power_export_watt = decoded_data->active_power_export;
+        reactive_power_import_var = decoded_data->reactive_power_import;
+        reactive_power_export_var = decoded_data->reactive_power_export;
+      }
       list1_recv = true;
+      han_pending.power = true;
   }
 
-  if(decoded_data->has_energy_data) {
+  if(decoded_data->has_energy_data && !meter_pending) {
       total_meter_reading = decoded_data->active_energy_import;
-      DPRINTF("Hourly report: accumulated %d Wh\n", total_meter_reading);
+      total_export_reading = decoded_data->active_energy_export;
+      total_reactive_import_reading = decoded_data->reactive_energy_import;
+      total_reactive_export_reading = decoded_data->reactive_energy_export;
       list3_recv = true;
+      han_pending.energy = true;
+      han_pending.timestamp = decoded_data->timestamp;
       is_list3 = true;
-      HAN_storeToNVM(false, true);
   }
 
   if(decoded_data->has_line_data) {
@@ -1550,6 +1902,7 @@ void HAN_callback(const han_parser_data_t* decoded_data) {
 
       is_list2 = true;
       list2_recv = true;
+      han_pending.line = true;
   }
 
   if((is_list3 || is_list2) &&
@@ -1558,18 +1911,388 @@ void HAN_callback(const han_parser_data_t* decoded_data) {
     Board_IndicatorControl(200, 800, 1, false);
   }
 
+  // The rest of the work on the readings happens in HAN_processReadings(),
+  // from the event loop
   if(is_list3) {
-      DPRINT("Triggering list3 event\n");
       ZAF_EventHelperEventEnqueue(EVENT_APP_ENERGY_UPDATE);
   } else if(is_list2) {
-      DPRINT("Triggering list2 event\n");
       ZAF_EventHelperEventEnqueue(EVENT_APP_POWER_UPDATE_SLOW);
   } else {
-      DPRINT("Triggering list1 event\n");
       ZAF_EventHelperEventEnqueue(EVENT_APP_POWER_UPDATE_FAST);
   }
 }
 
+// Feed the readings HAN_callback took in to everything derived from them:
+// filters, history, statistics, the estimate and the Meter Get answers.
+// Runs on the update events, ahead of the report decisions, in every state.
+void HAN_processReadings(void)
+{
+  uint32_t now_ms = han_pending.received_ms;
+
+  // Parameters 40-42 can change at any time, the filters start over when so
+  signal_filter_config_t filter_config = {
+    .median_size = CC_ConfigurationData.filter_median_size,
+    .ewma_shift = CC_ConfigurationData.filter_ewma_shift,
+    .hysteresis_pct = CC_ConfigurationData.filter_hysteresis_pct,
+  };
+  signal_filter_configure(&filter_config);
+
+  if(han_pending.power) {
+      DPRINTF("Active power: %d W import, %d W export\n", active_power_watt, active_power_export_watt);
+      energy_estimator_add_power(active_power_watt, now_ms);
+      statistics_add(STATISTICS_POWER, active_power_watt, now_ms);
+      signal_filter_add(SIGNAL_FILTER_POWER, CC_Meter_net_power());
+      timeseries_append(CC_Meter_net_power(), now_ms);
+  }
+
+  if(han_pending.energy) {
+      DPRINTF("Hourly report: accumulated %d Wh import, %d Wh export\n", total_meter_reading, total_export_reading);
+      DPRINTF("Hourly report: accumulated %d varh import, %d varh export\n", total_reactive_import_reading, total_reactive_export_reading);
+      apparent_energy_update(total_meter_reading + total_export_reading,
+                             total_reactive_import_reading + total_reactive_export_reading);
+
+      // The hourly frame carries the meter's clock, stamp the history with it
+      if(han_pending.timestamp != 0) {
+        last_total_reading_timestamp = han_pending.timestamp;
+        CC_MeterTableMonitor_setTime(han_pending.timestamp, now_ms);
+      }
+      CC_MeterTableMonitor_addHistory(total_meter_reading, now_ms);
+
+      energy_estimator_reconcile(total_meter_reading);
+
+      // The reading is re-sent by the meter every hour, and the emergency save
+      // on power loss takes care of having a recent copy at startup. So only
+      // write it out routinely every few hours to spare the flash.
+      static uint8_t hours_since_store = 0;
+      if(++hours_since_store >= HAN_NVM_ACCUMULATED_INTERVAL_HOURS) {
+        hours_since_store = 0;
+        HAN_scheduleStoreToNVM(false, true);
+      }
+  }
+
+  if(han_pending.line) {
+      signal_filter_add(SIGNAL_FILTER_CURRENT_L1, current_l1);
+      if(is_3phase) {
+        signal_filter_add(SIGNAL_FILTER_CURRENT_L2, current_l2);
+        signal_filter_add(SIGNAL_FILTER_CURRENT_L3, current_l3);
+      }
+
+      statistics_add(STATISTICS_VOLTAGE_L1, voltage_l1, now_ms);
+      statistics_add(STATISTICS_CURRENT_L1, current_l1, now_ms);
+      if(is_3phase) {
+        statistics_add(STATISTICS_VOLTAGE_L2, voltage_l2, now_ms);
+        statistics_add(STATISTICS_VOLTAGE_L3, voltage_l3, now_ms);
+        statistics_add(STATISTICS_CURRENT_L2, current_l2, now_ms);
+        statistics_add(STATISTICS_CURRENT_L3, current_l3, now_ms);
+      }
+  }
+
+  han_pending.power = false;
+  han_pending.energy = false;
+  han_pending.line = false;
+
+  readings_retain(HAN_retainTimestamp(), xTaskGetTickCount() * portTICK_PERIOD_MS);
+
+  // Keep the statistics available through the configuration parameters fresh
+  statistics_select(CC_ConfigurationData.statistics_metric,
+                    CC_ConfigurationData.statistics_window);
+
+  // Encode the Meter Get answers now, rather than on every Get
+  CC_Meter_refresh_report_cache();
+}
+
+// Readings are retained across soft and watchdog resets for at most this long
+#define HAN_WARM_START_MAX_AGE_S 30
+
+// The RTCC keeps counting across a soft or watchdog reset, unlike the RTOS tick
+uint32_t HAN_retainTimestamp(void)
+{
+  return RTCC->CNT;
+}
+
+uint32_t HAN_retainMaxAge(void)
+{
+  return HAN_WARM_START_MAX_AGE_S * CMU_ClockFreqGet(cmuClock_RTCC);
+}
+
+#define FILE_ID_GSIN 0x0010
+#define FILE_ID_MODEL 0x0011
+#define FILE_ID_ACCUMULATED 0x0020
+#define FILE_ID_ACCUMULATED_RESET 0x0021
+#define FILE_ID_EXPORT_ACCUMULATED 0x0022
+#define FILE_ID_EXPORT_ACCUMULATED_RESET 0x0023
+#define FILE_ID_APPARENT_ENERGY 0x0024
+#define FILE_ID_METER_PROFILES 0x0030
+#define FILE_ID_EMERGENCY_SAVE 0x0040
+#define FILE_ID_EMERGENCY_SAVE_TIMING 0x0041
+#define FILE_ID_REPORT_BACKLOG 0x0042
+
+/* Write-behind persistence of the meter state.
+ *
+ * HAN_callback runs from inside the parser, which runs from HAN_serial_rx
+ * before the shadow buffer has been released. Any flash operation done there
+ * directly delays the next buffer swap, which is exactly when the ISR is at
+ * risk of overflowing the active buffer. So the callback only marks what needs
+ * to be stored, and this job does the actual writing later on from a timer.
+ *
+ * The job only writes when the HAN line is idle (the ISR hasn't started
+ * filling the active buffer yet), meaning we're in the gap between two frames
+ * and have the most headroom before the next swap is needed. If a write fails,
+ * it is retried with exponential backoff instead of asserting, since losing
+ * an NVM write is not worth bricking the device over.
+ */
+#define HAN_NVM_FLUSH_DELAY_MS      500
+#define HAN_NVM_FLUSH_RETRY_MIN_MS  1000
+#define HAN_NVM_FLUSH_RETRY_MAX_MS  (10UL * 60UL * 1000UL)
+
+static struct {
+  SSwTimer timer;
+  bool     timer_registered;
+  bool     meter_dirty;       // GSIN and model need to be written
+  bool     accumulated_dirty; // accumulated value and offset need to be written
+  uint32_t retry_delay_ms;    // delay before the next attempt after a failure
+  uint32_t failures;          // total amount of failed flush attempts
+} han_nvm_job = {
+  .timer_registered = false,
+  .meter_dirty = false,
+  .accumulated_dirty = false,
+  .retry_delay_ms = HAN_NVM_FLUSH_RETRY_MIN_MS,
+  .failures = 0,
+};
+
+static bool HAN_lineIdle(void)
+{
+  return rxBuf.data_size[rxBuf.active_buffer] == 0xFFFFFFFFUL;
+}
+
+static void HAN_nvmFlushJob(SSwTimer* pTimer)
+{
+  (void)pTimer;
+
+  if(!han_nvm_job.meter_dirty && !han_nvm_job.accumulated_dirty) {
+    return;
+  }
+
+  if(!HAN_lineIdle()) {
+    // A frame is coming in, try again once it has been handled
+    TimerStart(&han_nvm_job.timer, HAN_NVM_FLUSH_DELAY_MS);
+    return;
+  }
+
+  bool update_meter = han_nvm_job.meter_dirty;
+  bool update_accumulated = han_nvm_job.accumulated_dirty;
+  han_nvm_job.meter_dirty = false;
+  han_nvm_job.accumulated_dirty = false;
+
+  if(!HAN_storeToNVM(update_meter, update_accumulated)) {
+    // Put back what we didn't manage to write, unless it was marked again
+    han_nvm_job.meter_dirty |= update_meter;
+    han_nvm_job.accumulated_dirty |= update_accumulated;
+    han_nvm_job.failures++;
+
+    DPRINTF("NVM flush failed (%u), retrying in %u ms\n",
+            han_nvm_job.failures, han_nvm_job.retry_delay_ms);
+    TimerStart(&han_nvm_job.timer, han_nvm_job.retry_delay_ms);
+
+    han_nvm_job.retry_delay_ms *= 2;
+    if(han_nvm_job.retry_delay_ms > HAN_NVM_FLUSH_RETRY_MAX_MS) {
+      han_nvm_job.retry_delay_ms = HAN_NVM_FLUSH_RETRY_MAX_MS;
+    }
+    return;
+  }
+
+  han_nvm_job.retry_delay_ms = HAN_NVM_FLUSH_RETRY_MIN_MS;
+}
+
+// Mark meter data as needing to be stored. Safe to call from the parse path.
+void HAN_scheduleStoreToNVM(bool update_meter, bool update_accumulated)
+{
+  han_nvm_job.meter_dirty |= update_meter;
+  han_nvm_job.accumulated_dirty |= update_accumulated;
+
+  // Registered on first use, since NVM resets can happen during startup before
+  // the HAN side of the application has been set up.
+  if(!han_nvm_job.timer_registered) {
+    AppTimerRegister(&han_nvm_job.timer, false, HAN_nvmFlushJob);
+    han_nvm_job.timer_registered = true;
+  }
+
+  // Don't cut short a pending backoff by restarting the timer
+  if(!TimerIsActive(&han_nvm_job.timer)) {
+    TimerStart(&han_nvm_job.timer, HAN_NVM_FLUSH_DELAY_MS);
+  }
+}
+
+/* Emergency save on power loss
+ *
+ * The device is powered from the HAN port, which can disappear at any time.
+ * The EMU voltage monitor watches AVDD and fires when it drops below
+ * HAN_POWERFAIL_THRESHOLD_MV, which happens once the DCDC runs out of input
+ * and the supply capacitors start to discharge. At that point, there's a few
+ * ms of hold-up time left to get the state which hasn't been written yet into
+ * flash, using a single compact object.
+ *
+ * The time the save takes is measured with the DWT cycle counter and written
+ * out as a second object afterwards. If that object is present at the next
+ * startup, the hold-up time was sufficient for the save and the measurement is
+ * printed. Pending configuration changes and the report backlog only go out
+ * after that, since losing them costs a lot less than losing the readings.
+ */
+#define HAN_POWERFAIL_THRESHOLD_MV 2900
+
+typedef struct {
+  uint32_t gsin_hash;           // meter the values below belong to
+  uint32_t total_meter_reading;
+  uint32_t meter_offset;
+  uint32_t energy_estimate;     // highest energy estimate published
+  uint32_t total_export_reading;
+  uint32_t export_offset;
+} han_emergency_record_t;
+
+// Kept off the stack, it takes a few hundred bytes
+static report_backlog_image_t han_backlog_image;
+
+static void HAN_powerfailArm(void)
+{
+  EMU_IntClear(EMU_IFC_VMONAVDDFALL);
+  EMU_IntEnable(EMU_IEN_VMONAVDDFALL);
+}
+
+static void HAN_powerfailSetup(void)
+{
+  EMU_VmonInit_TypeDef vmon_init = EMU_VMONINIT_DEFAULT;
+  vmon_init.channel = emuVmonChannel_AVDD;
+  vmon_init.threshold = HAN_POWERFAIL_THRESHOLD_MV;
+  vmon_init.riseWakeup = false;
+  vmon_init.fallWakeup = false;
+  vmon_init.enable = true;
+  EMU_VmonInit(&vmon_init);
+
+  // Cycle counter for measuring the emergency save
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  HAN_powerfailArm();
+  NVIC_ClearPendingIRQ(EMU_IRQn);
+  NVIC_SetPriority(EMU_IRQn, 4);
+  NVIC_EnableIRQ(EMU_IRQn);
+}
+
+void EMU_IRQHandler(void)
+{
+  uint32_t flags = EMU_IntGet() & EMU_IntGetEnabled();
+  EMU_IntClear(flags);
+
+  if(flags & EMU_IF_VMONAVDDFALL) {
+    // One-shot until the save is done, the supply will be bouncing around
+    EMU_IntDisable(EMU_IEN_VMONAVDDFALL);
+
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    xTaskNotifyFromISR(g_AppTaskHandle,
+                       1 << EAPPLICATIONEVENT_POWERFAIL,
+                       eSetBits,
+                       &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+  }
+}
+
+void HAN_powerfail(void)
+{
+  uint32_t start = DWT->CYCCNT;
+
+  han_emergency_record_t record = {
+    .gsin_hash = active_meter_hash,
+    .total_meter_reading = total_meter_reading,
+    .meter_offset = meter_offset,
+    .energy_estimate = energy_estimator_estimate(),
+    .total_export_reading = total_export_reading,
+    .export_offset = export_offset,
+  };
+  Ecode_t result = nvm3_writeData(pFileSystemApplication,
+                                  FILE_ID_EMERGENCY_SAVE, &record, sizeof(record));
+
+  // A meter switch waiting for its flush has to make it as well, or the record
+  // won't match the meter which gets loaded at the next startup
+  if(han_nvm_job.meter_dirty || han_nvm_job.accumulated_dirty) {
+    bool update_meter = han_nvm_job.meter_dirty;
+    bool update_accumulated = han_nvm_job.accumulated_dirty;
+    han_nvm_job.meter_dirty = false;
+    han_nvm_job.accumulated_dirty = false;
+
+    if(!HAN_storeToNVM(update_meter, update_accumulated)) {
+      han_nvm_job.meter_dirty |= update_meter;
+      han_nvm_job.accumulated_dirty |= update_accumulated;
+      result = ECODE_NVM3_ERR_WRITE_FAILED;
+    }
+  }
+
+  uint32_t save_us = (DWT->CYCCNT - start) / (SystemCoreClockGet() / 1000000UL);
+
+  if(result == ECODE_NVM3_OK) {
+    nvm3_writeData(pFileSystemApplication,
+                   FILE_ID_EMERGENCY_SAVE_TIMING, &save_us, sizeof(save_us));
+  }
+
+  // The rest is nice to have, if there's hold-up time left for it.
+  // Configuration changes waiting for their commit window:
+  CC_Configuration_flush();
+
+  // Reports the controller hasn't got yet
+  if(CC_ConfigurationData.backlog_nvm_spill == 1 && report_backlog_count() > 0) {
+    report_backlog_save(&han_backlog_image, CC_Meter_uptime_s());
+    nvm3_writeData(pFileSystemApplication,
+                   FILE_ID_REPORT_BACKLOG, &han_backlog_image, sizeof(han_backlog_image));
+  }
+
+  // If we're still alive, it was a dip rather than a power loss
+  if(EMU_VmonChannelStatusGet(emuVmonChannel_AVDD)) {
+    HAN_powerfailArm();
+  }
+}
+
+// Pick up the state saved on power loss, if it is newer than what we have
+static void HAN_loadEmergencyRecord(void)
+{
+  uint32_t save_us;
+  if(nvm3_readData(pFileSystemApplication, FILE_ID_EMERGENCY_SAVE_TIMING,
+                   &save_us, sizeof(save_us)) == ECODE_NVM3_OK) {
+    DPRINTF("Last emergency save took %u us\n", save_us);
+    nvm3_deleteObject(pFileSystemApplication, FILE_ID_EMERGENCY_SAVE_TIMING);
+  }
+
+  // They go out once the first report after startup gets through
+  if(nvm3_readData(pFileSystemApplication, FILE_ID_REPORT_BACKLOG,
+                   &han_backlog_image, sizeof(han_backlog_image)) == ECODE_NVM3_OK) {
+    report_backlog_load(&han_backlog_image, CC_Meter_uptime_s());
+    DPRINTF("Restored %u undelivered reports\n", report_backlog_count());
+    nvm3_deleteObject(pFileSystemApplication, FILE_ID_REPORT_BACKLOG);
+  }
+
+  han_emergency_record_t record;
+  if(nvm3_readData(pFileSystemApplication, FILE_ID_EMERGENCY_SAVE,
+                   &record, sizeof(record)) != ECODE_NVM3_OK) {
+    return;
+  }
+
+  if(record.gsin_hash == active_meter_hash &&
+     record.total_meter_reading >= total_meter_reading) {
+    total_meter_reading = record.total_meter_reading;
+    meter_offset = record.meter_offset;
+    total_export_reading = record.total_export_reading;
+    export_offset = record.export_offset;
+    list3_recv = (total_meter_reading != 0);
+    DPRINT("Restored meter data from emergency save\n");
+
+    // Whatever the estimate said before, it mustn't go back from there
+    energy_estimator_restore(record.energy_estimate);
+
+    // Fold it back into the regular objects so the record can go
+    HAN_scheduleStoreToNVM(false, true);
+  }
+
+  nvm3_deleteObject(pFileSystemApplication, FILE_ID_EMERGENCY_SAVE);
+}
+
 void HAN_setup(void)
 {
   // Turn on uart1 for HAN input @ 2400 baud
@@ -1616,19 +2339,48 @@ void HAN_setup(void)
 
 
   han_parser_set_callback(&HAN_callback);
+
+  HAN_powerfailSetup();
 }
 
 
-#define FILE_ID_GSIN 0x0010
-#define FILE_ID_MODEL 0x0011
-#define FILE_ID_ACCUMULATED 0x0020
-#define FILE_ID_ACCUMULATED_RESET 0x0021
+
+/* Per-meter state profiles
+ *
+ * Devices get moved between meters (test benches, or a meter swap by the grid
+ * operator), and some meters have been seen to transiently report a different
+ * GSIN. Instead of wiping the accumulated value and reset offset each time the
+ * GSIN changes, the state of the last few meters is kept in a small table.
+ * Switching back to a known meter is then a matter of swapping profiles.
+ *
+ * The active meter's values live in the FILE_ID_GSIN..FILE_ID_ACCUMULATED_RESET
+ * objects like before. The profile table only gets written on a switch, so it
+ * doesn't add to the hourly NVM writes.
+ */
+#define HAN_METER_PROFILE_COUNT 4
+
+typedef struct {
+  uint32_t gsin_hash;           // HAN_hashGsin(meter_id), 0 = unused slot
+  uint32_t last_used;           // switch sequence number, for evicting the oldest
+  char     meter_id[20];
+  char     meter_model[20];
+  uint32_t total_meter_reading;
+  uint32_t meter_offset;
+  uint32_t total_export_reading;
+  uint32_t export_offset;
+  apparent_energy_state_t apparent_energy;
+} han_meter_profile_t;
+
+static han_meter_profile_t han_meter_profiles[HAN_METER_PROFILE_COUNT];
+static uint32_t han_meter_profile_sequence = 0;
 
 void HAN_printPersistentData(void) {
   DPRINTF("Meter GSIN: %s\n", meter_id);
   DPRINTF("Meter model: %s\n", meter_model);
   DPRINTF("Last reading: %u.%u kWh\n", total_meter_reading / 1000, total_meter_reading % 1000);
   DPRINTF("ZWave reset value: %u.%u kWh\n", meter_offset / 1000, meter_offset % 1000);
+  DPRINTF("Last export reading: %u.%u kWh\n", total_export_reading / 1000, total_export_reading % 1000);
+  DPRINTF("ZWave export reset value: %u.%u kWh\n", export_offset / 1000, export_offset % 1000);
 }
 
 void HAN_loadFromNVM(void) {
@@ -1662,6 +2414,22 @@ void HAN_loadFromNVM(void) {
     list3_recv = true;
   }
 
+  // Profiles of previously seen meters. Not having these is not a reason to
+  // throw away the active meter's data (e.g. after a firmware upgrade).
+  result = nvm3_readData(pFileSystemApplication,
+                         FILE_ID_METER_PROFILES, han_meter_profiles, sizeof(han_meter_profiles));
+  if(result != ECODE_NVM3_OK) {
+    memset(han_meter_profiles, 0, sizeof(han_meter_profiles));
+  }
+
+  for(size_t i = 0; i < HAN_METER_PROFILE_COUNT; i++) {
+    if(han_meter_profiles[i].last_used > han_meter_profile_sequence) {
+      han_meter_profile_sequence = han_meter_profiles[i].last_used;
+    }
+  }
+
+  active_meter_hash = meter_id[0] != 0 ? HAN_hashGsin(meter_id) : 0;
+
   // node-specific reset value
   result = nvm3_readData(pFileSystemApplication,
                          FILE_ID_ACCUMULATED_RESET, &meter_offset, sizeof(meter_offset));
@@ -1670,77 +2438,241 @@ void HAN_loadFromNVM(void) {
     return HAN_resetNVM();
   }
 
+  // Export register. Missing on devices upgraded from firmware which didn't
+  // know about export yet, which is no reason to drop the import data.
+  result = nvm3_readData(pFileSystemApplication,
+                         FILE_ID_EXPORT_ACCUMULATED, &total_export_reading, sizeof(total_export_reading));
+  if(result == ECODE_NVM3_OK) {
+    result = nvm3_readData(pFileSystemApplication,
+                           FILE_ID_EXPORT_ACCUMULATED_RESET, &export_offset, sizeof(export_offset));
+  }
+  if(result != ECODE_NVM3_OK) {
+    total_export_reading = 0;
+    export_offset = 0;
+  }
+
+  // Apparent energy, same story. Starts over from the next hourly reading.
+  apparent_energy_state_t apparent_state;
+  result = nvm3_readData(pFileSystemApplication,
+                         FILE_ID_APPARENT_ENERGY, &apparent_state, sizeof(apparent_state));
+  if(result == ECODE_NVM3_OK) {
+    apparent_energy_set_state(&apparent_state);
+  }
+
+  // Last, the record saved on power loss is newer than all of the above
+  HAN_loadEmergencyRecord();
+
   DPRINT("Loaded meter data from NVM:\n");
   HAN_printPersistentData();
   DPRINT("===========================\n");
 }
 
-void HAN_storeToNVM(bool update_meter, bool update_accumulated) {
-  Ecode_t result = ECODE_NVM3_OK;
-  // Store persistently saved values to NVM on update
-  if(update_meter) {
-    // Meter GSIN
-    result = nvm3_writeData(pFileSystemApplication,
-                            FILE_ID_GSIN, meter_id, sizeof(meter_id));
-    ASSERT(ECODE_NVM3_OK == result);
+// GSINs are kept cut to fit meter_id, so only compare what's kept
+static bool HAN_isGsin(const char* stored, const char* gsin) {
+  return strncmp(stored, gsin, sizeof(meter_id) - 1) == 0;
+}
 
-    // Meter model
-    result = nvm3_writeData(pFileSystemApplication,
-                            FILE_ID_MODEL, meter_model, sizeof(meter_model));
-    ASSERT(ECODE_NVM3_OK == result);
-  }
+bool HAN_isActiveMeter(const char* gsin) {
+  return active_meter_hash != 0 && HAN_isGsin(meter_id, gsin);
+}
+
+// FNV-1a over the GSIN string, as far as meter_id keeps it. Never returns 0,
+// which marks 'no meter'.
+uint32_t HAN_hashGsin(const char* gsin) {
+  uint32_t hash = 2166136261UL;
+  for(size_t i = 0; i < sizeof(meter_id) - 1 && gsin[i] != 0; i++) {
+    hash ^= (uint8_t)gsin[i];
+    hash *= 16777619UL;
+  }
+  return hash != 0 ? hash : 1;
+}
+
+static void HAN_copyString(char* dst, size_t dst_size, const char* src) {
+  size_t length = strlen(src);
+  if(length > dst_size - 1) {
+    length = dst_size - 1;
+  }
+  memcpy(dst, src, length);
+  memset(&dst[length], 0, dst_size - length);
+}
+
+static han_meter_profile_t* HAN_findMeterProfile(uint32_t gsin_hash, const char* gsin) {
+  for(size_t i = 0; i < HAN_METER_PROFILE_COUNT; i++) {
+    // The string compare only happens on a hash hit, i.e. once per switch
+    if(han_meter_profiles[i].gsin_hash == gsin_hash &&
+       HAN_isGsin(han_meter_profiles[i].meter_id, gsin)) {
+      return &han_meter_profiles[i];
+    }
+  }
+  return NULL;
+}
+
+static han_meter_profile_t* HAN_allocateMeterProfile(void) {
+  han_meter_profile_t* oldest = &han_meter_profiles[0];
+  for(size_t i = 0; i < HAN_METER_PROFILE_COUNT; i++) {
+    if(han_meter_profiles[i].gsin_hash == 0) {
+      return &han_meter_profiles[i];
+    }
+    if(han_meter_profiles[i].last_used < oldest->last_used) {
+      oldest = &han_meter_profiles[i];
+    }
+  }
+  DPRINTF("Evicting meter profile %s\n", oldest->meter_id);
+  return oldest;
+}
+
+// Park the active meter's state in its profile and make the meter identified
+// by decoded_data the active one. Only touches RAM, the NVM write is deferred.
+void HAN_switchMeterProfile(const han_parser_data_t* decoded_data, uint32_t gsin_hash) {
+  han_meter_profile_sequence++;
+
+  if(active_meter_hash != 0) {
+    han_meter_profile_t* previous = HAN_findMeterProfile(active_meter_hash, meter_id);
+    if(previous == NULL) {
+      previous = HAN_allocateMeterProfile();
+    }
+    previous->gsin_hash = active_meter_hash;
+    previous->last_used = han_meter_profile_sequence;
+    memcpy(previous->meter_id, meter_id, sizeof(previous->meter_id));
+    memcpy(previous->meter_model, meter_model, sizeof(previous->meter_model));
+    previous->total_meter_reading = total_meter_reading;
+    previous->meter_offset = meter_offset;
+    previous->total_export_reading = total_export_reading;
+    previous->export_offset = export_offset;
+    apparent_energy_get_state(&previous->apparent_energy);
+  }
+
+  han_meter_profile_t* next = HAN_findMeterProfile(gsin_hash, decoded_data->meter_gsin);
+
+  HAN_resetValues();
+  HAN_copyString(meter_id, sizeof(meter_id), decoded_data->meter_gsin);
+  HAN_copyString(meter_model, sizeof(meter_model), decoded_data->meter_model);
+  active_meter_hash = gsin_hash;
+
+  if(next != NULL) {
+    total_meter_reading = next->total_meter_reading;
+    meter_offset = next->meter_offset;
+    total_export_reading = next->total_export_reading;
+    export_offset = next->export_offset;
+    apparent_energy_set_state(&next->apparent_energy);
+    next->last_used = han_meter_profile_sequence;
+    list3_recv = (total_meter_reading != 0);
+    DPRINTF("Switched to known meter %s\n", meter_id);
+  } else {
+    DPRINTF("Switched to new meter %s\n", meter_id);
+  }
+
+  HAN_scheduleStoreToNVM(true, true);
+}
+
+bool HAN_storeToNVM(bool update_meter, bool update_accumulated) {
+  Ecode_t result = ECODE_NVM3_OK;
+  // Store persistently saved values to NVM on update
+  if(update_meter) {
+    // Meter GSIN
+    result = nvm3_writeData(pFileSystemApplication,
+                            FILE_ID_GSIN, meter_id, sizeof(meter_id));
+    if(result != ECODE_NVM3_OK) {
+      return false;
+    }
+
+    // Meter model
+    result = nvm3_writeData(pFileSystemApplication,
+                            FILE_ID_MODEL, meter_model, sizeof(meter_model));
+    if(result != ECODE_NVM3_OK) {
+      return false;
+    }
+
+    // Profiles only change together with the meter identity
+    result = nvm3_writeData(pFileSystemApplication,
+                            FILE_ID_METER_PROFILES, han_meter_profiles, sizeof(han_meter_profiles));
+    if(result != ECODE_NVM3_OK) {
+      return false;
+    }
+  }
 
   if(update_accumulated) {
     // Accumulated value
     result = nvm3_writeData(pFileSystemApplication,
                             FILE_ID_ACCUMULATED, &total_meter_reading, sizeof(total_meter_reading));
-    ASSERT(ECODE_NVM3_OK == result);
+    if(result != ECODE_NVM3_OK) {
+      return false;
+    }
 
     // node-specific reset value
     result = nvm3_writeData(pFileSystemApplication,
                           FILE_ID_ACCUMULATED_RESET, &meter_offset, sizeof(meter_offset));
-    ASSERT(ECODE_NVM3_OK == result);
+    if(result != ECODE_NVM3_OK) {
+      return false;
+    }
+
+    // Export value and its reset value
+    result = nvm3_writeData(pFileSystemApplication,
+                            FILE_ID_EXPORT_ACCUMULATED, &total_export_reading, sizeof(total_export_reading));
+    if(result != ECODE_NVM3_OK) {
+      return false;
+    }
+
+    result = nvm3_writeData(pFileSystemApplication,
+                            FILE_ID_EXPORT_ACCUMULATED_RESET, &export_offset, sizeof(export_offset));
+    if(result != ECODE_NVM3_OK) {
+      return false;
+    }
+
+    // Apparent energy, built up from the hourly readings
+    apparent_energy_state_t apparent_state;
+    apparent_energy_get_state(&apparent_state);
+    result = nvm3_writeData(pFileSystemApplication,
+                            FILE_ID_APPARENT_ENERGY, &apparent_state, sizeof(apparent_state));
+    if(result != ECODE_NVM3_OK) {
+      return false;
+    }
   }
 
   DPRINT("Stored meter data to NVM:\n");
   HAN_printPersistentData();
   DPRINT("===========================\n");
+  return true;
 }
 
-void HAN_resetNVM(void) {
+// Reset the in-RAM copy of the persistent meter values without touching NVM
+void HAN_resetValues(void) {
   memset(meter_id, 0, sizeof(meter_id));
   memset(meter_model, 0, sizeof(meter_model));
   total_meter_reading = 0;
   meter_offset = 0;
+  total_export_reading = 0;
+  export_offset = 0;
+  total_reactive_import_reading = 0;
+  total_reactive_export_reading = 0;
+  apparent_energy_reset();
 
   // Invalidate reporting accumulated data
   list2_recv = false;
   list3_recv = false;
   is_3phase = false;
+  energy_estimator_reset();
+  statistics_reset();
+  CC_MeterTableMonitor_resetHistory();
+}
 
-  // Set GSIN to {0}
-  Ecode_t result = nvm3_writeData(pFileSystemApplication,
-                                  FILE_ID_GSIN, meter_id, sizeof(meter_id));
-  ASSERT(ECODE_NVM3_OK == result);
-
-  // Set meter model to {0}
-  result = nvm3_writeData(pFileSystemApplication,
-                          FILE_ID_MODEL, meter_model, sizeof(meter_model));
-  ASSERT(ECODE_NVM3_OK == result);
-
-  // Set accumulated value to 0
-  result = nvm3_writeData(pFileSystemApplication,
-                          FILE_ID_ACCUMULATED, &total_meter_reading, sizeof(total_meter_reading));
-  ASSERT(ECODE_NVM3_OK == result);
-
-  // Set node-specific reset value 0
-  result = nvm3_writeData(pFileSystemApplication,
-                          FILE_ID_ACCUMULATED_RESET, &meter_offset, sizeof(meter_offset));
-  ASSERT(ECODE_NVM3_OK == result);
+void HAN_resetNVM(void) {
+  HAN_resetValues();
+  memset(han_meter_profiles, 0, sizeof(han_meter_profiles));
+  han_meter_profile_sequence = 0;
+  active_meter_hash = 0;
+
+  // Whatever the write-behind job had pending is superseded by this reset
+  han_nvm_job.meter_dirty = false;
+  han_nvm_job.accumulated_dirty = false;
+
+  if(!HAN_storeToNVM(true, true)) {
+    // Leave it to the persistence job to get the reset values out
+    HAN_scheduleStoreToNVM(true, true);
+    return;
+  }
 
-  DPRINT("Reset meter data in NVM:\n");
-  HAN_printPersistentData();
-  DPRINT("===========================\n");
+  DPRINT("Reset meter data in NVM\n");
 }
 
 /*******************************************************************************
@@ -1754,7 +2686,8 @@ typedef struct s_CC_meter_data_t_
 {
   RECEIVE_OPTIONS_TYPE_EX rxOptions; /**< rxOptions */
 } s_CC_meter_data_t;
-s_CC_meter_data_t ZAF_TSE_MeterData;
+// One per endpoint, since the TSE keeps a trigger per endpoint
+s_CC_meter_data_t ZAF_TSE_MeterData[NUMBER_OF_ENDPOINTS + 1];
 
 /**
  * Prepare the data input for the TSE for any Meter CC command based on the pRxOption pointer.
@@ -1763,67 +2696,232 @@ s_CC_meter_data_t ZAF_TSE_MeterData;
 void* CC_Meter_prepare_zaf_tse_data(RECEIVE_OPTIONS_TYPE_EX* pRxOpt)
 {
   /* Copy the RxOption in the data and return the pointer */
-  ZAF_TSE_MeterData.rxOptions = *pRxOpt;
-  return &ZAF_TSE_MeterData;
+  uint8_t endpoint = pRxOpt->destNode.endpoint <= NUMBER_OF_ENDPOINTS ? pRxOpt->destNode.endpoint : ENDPOINT_ROOT;
+  ZAF_TSE_MeterData[endpoint].rxOptions = *pRxOpt;
+  return &ZAF_TSE_MeterData[endpoint];
 }
 
-#define SCALE_KWH 0x0
-#define SCALE_KVAH 0x1
-#define SCALE_W 0x2
-#define SCALE_V 0x4
-#define SCALE_A 0x05
-
-#define RT_DEFAULT 0x0
-#define RT_IMPORT 0x1
-#define RT_EXPORT 0x2
-
 #define PRECISION_WHOLE 0x0
 #define PRECISION_1_DECIMAL 0x1
 #define PRECISION_2_DECIMAL 0x2
 #define PRECISION_3_DECIMAL 0x3
 
+// Meter Report V5 with the value (and previous value) in the smallest signed
+// field that holds them, see meter_value.h. A delta time of 0 means there's no
+// previous value, in which case that field is left out of the frame.
+uint8_t set_meter_report_value(ZW_APPLICATION_TX_BUFFER *pTxBuf, uint8_t rate, uint8_t scale, uint8_t precision, int32_t value, int32_t previous, uint16_t delta_time_s)
+{
+  uint8_t* pFrame = (uint8_t*)pTxBuf;
+  pFrame[0] = COMMAND_CLASS_METER_V5;
+  pFrame[1] = METER_REPORT_V5;
+  return 2 + meter_value_encode(&pFrame[2], rate, scale, precision, value, previous, delta_time_s);
+}
+
 uint8_t set_meter_report_uint32(ZW_APPLICATION_TX_BUFFER *pTxBuf, uint8_t rate, uint8_t scale, uint8_t precision, uint32_t value)
 {
-  pTxBuf->ZW_MeterReport4byteV5Frame.cmdClass = COMMAND_CLASS_METER_V5;
-  pTxBuf->ZW_MeterReport4byteV5Frame.cmd = METER_REPORT_V5;
+  return set_meter_report_value(pTxBuf, rate, scale, precision, (int32_t)value, 0, 0);
+}
+
+// Delta time field of a Meter Report, in seconds. 0 is reserved for 'no
+// previous value', anything longer than the field can hold is capped.
+static uint16_t meter_delta_time(uint32_t delta_ms)
+{
+  uint32_t delta_s = (delta_ms + 500) / 1000;
+  if(delta_s == 0) {
+    delta_s = 1;
+  }
+  return delta_s > 0xFFFF ? 0xFFFF : (uint16_t)delta_s;
+}
+
+// Root reports built for the lifeline are noted here while a frame is being put
+// together, so they can go into the backlog if the frame doesn't get through.
+// Reports from the endpoints aren't kept: the next one of a phase supersedes
+// the last, and the estimate is superseded by the hourly reading anyway.
+#define METER_REPORT_CAPTURE_SIZE 8
+
+static report_backlog_entry_t meter_report_capture[METER_REPORT_CAPTURE_SIZE];
+static uint8_t meter_report_capture_count = 0;
+
+uint32_t CC_Meter_uptime_s(void)
+{
+  return xTaskGetTickCount() * portTICK_PERIOD_MS / 1000;
+}
+
+static void CC_Meter_capture_report(report_metric_t metric, uint8_t rate, uint8_t scale, uint8_t precision, int32_t value)
+{
+  if((metric >= METRIC_VOLTAGE_L1 && metric <= METRIC_CURRENT_L3) ||
+     metric == METRIC_ENERGY_ESTIMATE ||
+     meter_report_capture_count == METER_REPORT_CAPTURE_SIZE) {
+    return;
+  }
+  report_backlog_entry_t* pEntry = &meter_report_capture[meter_report_capture_count++];
+  pEntry->metric = metric;
+  pEntry->rate = rate;
+  pEntry->scale = scale;
+  pEntry->precision = precision;
+  pEntry->value = value;
+  pEntry->timestamp_s = CC_Meter_uptime_s();
+}
+
+// Meter Report of 'metric' which includes the previously reported value, so
+// the receiver can work out the rate of change without polling. Unsolicited
+// reports have been recorded by the reporting policy already, so their
+// history is the report before; a Get is answered relative to the last one.
+uint8_t set_meter_report_metric(ZW_APPLICATION_TX_BUFFER *pTxBuf, report_metric_t metric, bool unsolicited, uint8_t rate, uint8_t scale, uint8_t precision, int32_t value)
+{
+  int32_t previous;
+  uint32_t delta_ms;
+  bool has_history;
+
+  if(unsolicited) {
+    CC_Meter_capture_report(metric, rate, scale, precision, value);
+    has_history = report_policy_previous_report(metric, &previous, &delta_ms);
+  } else {
+    has_history = report_policy_last_report(metric, xTaskGetTickCount() * portTICK_PERIOD_MS, &previous, &delta_ms);
+  }
+
+  if(!has_history) {
+    return set_meter_report_value(pTxBuf, rate, scale, precision, value, 0, 0);
+  }
+  return set_meter_report_value(pTxBuf, rate, scale, precision, value, previous, meter_delta_time(delta_ms));
+}
+
+// The supported report never changes, so it lives in flash as-is
+static const uint8_t meter_supported_report[] = {
+  COMMAND_CLASS_METER_V5,
+  METER_SUPPORTED_REPORT_V5,
+  0x01 /* electricity meter type */ |
+  (0x3 << 5) /* supports import and export reporting */ |
+  (1 << 7) /* supports reset command */,
+  0x80 /* more scale types */ | (1 << SCALE_KWH) | (1 << SCALE_KVAH) | (1 << SCALE_W) |
+  (1 << SCALE_V) | (1 << SCALE_A) | (1 << SCALE_PF) /* in place of VA */,
+  1, // scale supported bytes to follow
+  (1 << 0) /* kVar */ | (1 << 1) /* kVarh */,
+};
+
+// The phase endpoints only measure voltage and current, and can't be reset
+static const uint8_t meter_supported_report_phase[] = {
+  COMMAND_CLASS_METER_V5,
+  METER_SUPPORTED_REPORT_V5,
+  0x01 /* electricity meter type */ |
+  (0x1 << 5) /* only supports import energy reporting */,
+  (1 << SCALE_V) | (1 << SCALE_A),
+};
+
+// The estimate endpoint only has the estimated import energy
+static const uint8_t meter_supported_report_estimate[] = {
+  COMMAND_CLASS_METER_V5,
+  METER_SUPPORTED_REPORT_V5,
+  0x01 /* electricity meter type */ |
+  (0x1 << 5) /* only supports import energy reporting */,
+  (1 << SCALE_KWH),
+};
+
+// Power flowing into the site, negative while it produces more than it uses
+int32_t CC_Meter_net_power(void)
+{
+  return (int32_t)active_power_watt - (int32_t)active_power_export_watt;
+}
 
-  // Encode meter type
-  pTxBuf->ZW_MeterReport4byteV5Frame.properties1 = 0x01; //electric meter
-  pTxBuf->ZW_MeterReport4byteV5Frame.properties1 |= (rate << 5) & 0x60;
-  pTxBuf->ZW_MeterReport4byteV5Frame.properties1 |= (scale << 5) & 0x80;
-  pTxBuf->ZW_MeterReport4byteV5Frame.properties2 = (scale & 0x3) << 3;
-  pTxBuf->ZW_MeterReport4byteV5Frame.properties2 |= 0x4; //uint32
-  pTxBuf->ZW_MeterReport4byteV5Frame.properties2 |= (precision & 0x7) << 5;
-  pTxBuf->ZW_MeterReport4byteV5Frame.meterValue1 = (value >> 24) & 0xFF;
-  pTxBuf->ZW_MeterReport4byteV5Frame.meterValue2 = (value >> 16) & 0xFF;
-  pTxBuf->ZW_MeterReport4byteV5Frame.meterValue3 = (value >>  8) & 0xFF;
-  pTxBuf->ZW_MeterReport4byteV5Frame.meterValue4 = value & 0xFF;
-  pTxBuf->ZW_MeterReport4byteV5Frame.deltaTime1 = 0;
-  pTxBuf->ZW_MeterReport4byteV5Frame.deltaTime2 = 0;
+// Same for reactive power, negative while the site is capacitive
+int32_t CC_Meter_net_reactive_power(void)
+{
+  return (int32_t)reactive_power_import_var - (int32_t)reactive_power_export_var;
+}
 
-  if(scale > 0x7) {
-      pTxBuf->ZW_MeterReport4byteV5Frame.scale2 = scale - 0x7;
-      return 11; // 4-byte value, no historical data, extended scale
+// What the reporting policy and the unsolicited reports go by. Falls back to
+// the plain reading until the filter has seen one, e.g. after a warm start.
+int32_t CC_Meter_filtered_power(void)
+{
+  int32_t value;
+  if(!signal_filter_output(SIGNAL_FILTER_POWER, &value)) {
+    value = CC_Meter_net_power();
   }
-  return 10; // 4-byte value, no historical data, no extended scale
+  return value;
 }
 
-uint8_t set_meter_supported_report_uint32(ZW_APPLICATION_TX_BUFFER *pTxBuf)
+int32_t CC_Meter_filtered_current(uint8_t phase)
 {
-  pTxBuf->ZW_MeterSupportedReport1byteV5Frame.cmdClass = COMMAND_CLASS_METER_V5;
-  pTxBuf->ZW_MeterSupportedReport1byteV5Frame.cmd = METER_SUPPORTED_REPORT_V5;
+  int32_t value;
+  if(phase < 1 || phase > 3 ||
+     !signal_filter_output(SIGNAL_FILTER_CURRENT_L1 + phase - 1, &value)) {
+    value = CC_Meter_phase_current(phase);
+  }
+  return value;
+}
 
-  // Encode supported meter values
-  pTxBuf->ZW_MeterSupportedReport1byteV5Frame.properties1 = 0x01; // electricity meter type
-  pTxBuf->ZW_MeterSupportedReport1byteV5Frame.properties1 |= (0x1 << 5); // only supports import energy reporting
-  pTxBuf->ZW_MeterSupportedReport1byteV5Frame.properties1 |= (1 << 7); // supports reset command
+// Readings of one phase, 1-3
+int32_t CC_Meter_phase_voltage(uint8_t phase)
+{
+  switch(phase) {
+    case 2:  return voltage_l2;
+    case 3:  return voltage_l3;
+    default: return voltage_l1;
+  }
+}
 
-  pTxBuf->ZW_MeterSupportedReport1byteV5Frame.properties2 = (1 << SCALE_KWH); // support reading KWH
-  pTxBuf->ZW_MeterSupportedReport1byteV5Frame.properties2 |= (1 << SCALE_W); // support reading W
-  pTxBuf->ZW_MeterSupportedReport1byteV5Frame.properties2 |= (1 << SCALE_V); // support reading V
-  pTxBuf->ZW_MeterSupportedReport1byteV5Frame.properties2 |= (1 << SCALE_A); // support reading A
+int32_t CC_Meter_phase_current(uint8_t phase)
+{
+  switch(phase) {
+    case 2:  return current_l2;
+    case 3:  return current_l3;
+    default: return current_l1;
+  }
+}
 
-  return 4; // not using extended scales
+// Encode the answer to each supported Get, see meter_report_cache.h
+void CC_Meter_refresh_report_cache(void)
+{
+  meter_report_cache[METER_CACHE_KWH].length = set_meter_report_metric(
+      (ZW_APPLICATION_TX_BUFFER*)meter_report_cache[METER_CACHE_KWH].frame,
+      METRIC_ENERGY, false, RT_IMPORT, SCALE_KWH, 3, total_meter_reading - meter_offset);
+  meter_report_cache[METER_CACHE_W].length = set_meter_report_metric(
+      (ZW_APPLICATION_TX_BUFFER*)meter_report_cache[METER_CACHE_W].frame,
+      METRIC_POWER, false, RT_IMPORT, SCALE_W, 0, CC_Meter_net_power());
+  meter_report_cache[METER_CACHE_KWH_EXPORT].length = set_meter_report_metric(
+      (ZW_APPLICATION_TX_BUFFER*)meter_report_cache[METER_CACHE_KWH_EXPORT].frame,
+      METRIC_ENERGY_EXPORT, false, RT_EXPORT, SCALE_KWH, 3, total_export_reading - export_offset);
+  // Export power is only ever reported as part of the net power, so there's
+  // no history to go with it
+  meter_report_cache[METER_CACHE_W_EXPORT].length = set_meter_report_value(
+      (ZW_APPLICATION_TX_BUFFER*)meter_report_cache[METER_CACHE_W_EXPORT].frame,
+      RT_EXPORT, SCALE_W, 0, active_power_export_watt, 0, 0);
+  meter_report_cache[METER_CACHE_KVAH].length = set_meter_report_metric(
+      (ZW_APPLICATION_TX_BUFFER*)meter_report_cache[METER_CACHE_KVAH].frame,
+      METRIC_APPARENT_ENERGY, false, RT_IMPORT, SCALE_KVAH, 3, apparent_energy_total());
+  // Meter V5 has no scale for apparent power, the power factor stands in for
+  // it. Without reactive power there's nothing to work it out from.
+  meter_report_cache[METER_CACHE_PF].length = 0;
+  if(list2_recv) {
+    meter_report_cache[METER_CACHE_PF].length = set_meter_report_value(
+        (ZW_APPLICATION_TX_BUFFER*)meter_report_cache[METER_CACHE_PF].frame,
+        RT_IMPORT, SCALE_PF, 2, apparent_power_factor(CC_Meter_net_power(), CC_Meter_net_reactive_power()), 0, 0);
+  }
+  meter_report_cache[METER_CACHE_KVAR].length = set_meter_report_metric(
+      (ZW_APPLICATION_TX_BUFFER*)meter_report_cache[METER_CACHE_KVAR].frame,
+      METRIC_REACTIVE_POWER, false, RT_IMPORT, SCALE_KVAR, 3, CC_Meter_net_reactive_power());
+  meter_report_cache[METER_CACHE_KVARH].length = set_meter_report_metric(
+      (ZW_APPLICATION_TX_BUFFER*)meter_report_cache[METER_CACHE_KVARH].frame,
+      METRIC_REACTIVE_ENERGY, false, RT_IMPORT, SCALE_KVARH, 3, total_reactive_import_reading);
+  meter_report_cache[METER_CACHE_KVAR_EXPORT].length = set_meter_report_value(
+      (ZW_APPLICATION_TX_BUFFER*)meter_report_cache[METER_CACHE_KVAR_EXPORT].frame,
+      RT_EXPORT, SCALE_KVAR, 3, reactive_power_export_var, 0, 0);
+  meter_report_cache[METER_CACHE_KVARH_EXPORT].length = set_meter_report_value(
+      (ZW_APPLICATION_TX_BUFFER*)meter_report_cache[METER_CACHE_KVARH_EXPORT].frame,
+      RT_EXPORT, SCALE_KVARH, 3, total_reactive_export_reading, 0, 0);
+  for(uint8_t phase = 1; phase <= 3; phase++) {
+    meter_report_cache_entry_t* pVoltage = &meter_report_cache[METER_CACHE_V_L1 + phase - 1];
+    meter_report_cache_entry_t* pCurrent = &meter_report_cache[METER_CACHE_A_L1 + phase - 1];
+    pVoltage->length = set_meter_report_metric(
+        (ZW_APPLICATION_TX_BUFFER*)pVoltage->frame,
+        METRIC_VOLTAGE_L1 + phase - 1, false, RT_IMPORT, SCALE_V, 0, CC_Meter_phase_voltage(phase));
+    pCurrent->length = set_meter_report_metric(
+        (ZW_APPLICATION_TX_BUFFER*)pCurrent->frame,
+        METRIC_CURRENT_L1 + phase - 1, false, RT_IMPORT, SCALE_A, 3, CC_Meter_phase_current(phase));
+  }
+  meter_report_cache[METER_CACHE_KWH_ESTIMATE].length = set_meter_report_metric(
+      (ZW_APPLICATION_TX_BUFFER*)meter_report_cache[METER_CACHE_KWH_ESTIMATE].frame,
+      METRIC_ENERGY_ESTIMATE, false, RT_IMPORT, SCALE_KWH, 3, CC_Meter_energy_estimate());
 }
 
 received_frame_status_t
@@ -1837,60 +2935,30 @@ handleCommandClassMeter(
     case METER_GET_V5:
       if(false == Check_not_legal_response_job(rxOpt))
       {
-        ZAF_TRANSPORT_TX_BUFFER  TxBuf;
-        ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
-        memset((uint8_t*)pTxBuf, 0, sizeof(ZW_APPLICATION_TX_BUFFER) );
-
-        TRANSMIT_OPTIONS_TYPE_SINGLE_EX *pTxOptionsEx;
-        RxToTxOptions(rxOpt, &pTxOptionsEx);
-
         // Grab the options from the meter get command
         uint8_t requested_scale = (pCmd->ZW_MeterGetV5Frame.properties1 & 0x38) >> 3;
         if(requested_scale == 0x07) {
-            requested_scale = pCmd->ZW_MeterGetV5Frame.scale2;
-            return RECEIVED_FRAME_STATUS_NO_SUPPORT;
+            // Scales from 7 on are numbered on in the scale 2 field
+            requested_scale = SCALE_KVAR + pCmd->ZW_MeterGetV5Frame.scale2;
         }
 
+        // A request for the default rate type gets answered with import
         uint8_t rate_type = pCmd->ZW_MeterGetV5Frame.properties1 >> 6;
-        uint8_t response_size;
-
-        // Get requested value
-        switch(requested_scale) {
-          case SCALE_KWH:
-            if((rate_type == RT_DEFAULT || rate_type == RT_IMPORT)) {
-              response_size = set_meter_report_uint32(pTxBuf, rate_type, requested_scale, 3, total_meter_reading - meter_offset);
-            } else {
-              return RECEIVED_FRAME_STATUS_NO_SUPPORT;
-            }
-            break;
-          case SCALE_W:
-            if(rate_type == RT_DEFAULT || rate_type == RT_IMPORT) {
-              response_size = set_meter_report_uint32(pTxBuf, rate_type, requested_scale, 0, active_power_watt);
-            } else {
-              return RECEIVED_FRAME_STATUS_NO_SUPPORT;
-            }
-            break;
-          case SCALE_A:
-            if(rate_type == RT_DEFAULT || rate_type == RT_IMPORT) {
-              response_size = set_meter_report_uint32(pTxBuf, rate_type, requested_scale, 3, current_l1);
-            } else {
-              return RECEIVED_FRAME_STATUS_NO_SUPPORT;
-            }
-            break;
-          case SCALE_V:
-            if(rate_type == RT_DEFAULT || rate_type == RT_IMPORT) {
-              response_size = set_meter_report_uint32(pTxBuf, rate_type, requested_scale, 0, voltage_l1);
-            } else {
-              return RECEIVED_FRAME_STATUS_NO_SUPPORT;
-            }
-            break;
-          default:
-            return RECEIVED_FRAME_STATUS_NO_SUPPORT;
+        if(rate_type != RT_DEFAULT && rate_type != RT_IMPORT && rate_type != RT_EXPORT) {
+          return RECEIVED_FRAME_STATUS_NO_SUPPORT;
         }
 
+        const meter_report_cache_entry_t* pReport = meter_report_cache_lookup(rxOpt->destNode.endpoint, rate_type, requested_scale);
+        if(pReport == NULL) {
+          return RECEIVED_FRAME_STATUS_NO_SUPPORT;
+        }
+
+        TRANSMIT_OPTIONS_TYPE_SINGLE_EX *pTxOptionsEx;
+        RxToTxOptions(rxOpt, &pTxOptionsEx);
+
         if(EQUEUENOTIFYING_STATUS_SUCCESS != Transport_SendResponseEP(
-            (uint8_t *)pTxBuf,
-            response_size,
+            (uint8_t *)pReport->frame,
+            pReport->length,
             pTxOptionsEx,
             NULL))
         {
@@ -1904,18 +2972,21 @@ handleCommandClassMeter(
 
     case METER_SUPPORTED_GET_V5:
       if(false == Check_not_legal_response_job(rxOpt)) {
-        ZAF_TRANSPORT_TX_BUFFER  TxBuf;
-        ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
-        memset((uint8_t*)pTxBuf, 0, sizeof(ZW_APPLICATION_TX_BUFFER) );
-
         TRANSMIT_OPTIONS_TYPE_SINGLE_EX *pTxOptionsEx;
         RxToTxOptions(rxOpt, &pTxOptionsEx);
 
-        uint8_t response_size = set_meter_supported_report_uint32(pTxBuf);
-
+        const uint8_t* pReport = meter_supported_report;
+        uint8_t report_size = sizeof(meter_supported_report);
+        if(rxOpt->destNode.endpoint == ENDPOINT_ENERGY_ESTIMATE) {
+          pReport = meter_supported_report_estimate;
+          report_size = sizeof(meter_supported_report_estimate);
+        } else if(rxOpt->destNode.endpoint != ENDPOINT_ROOT) {
+          pReport = meter_supported_report_phase;
+          report_size = sizeof(meter_supported_report_phase);
+        }
         if(EQUEUENOTIFYING_STATUS_SUCCESS != Transport_SendResponseEP(
-            (uint8_t *)pTxBuf,
-            response_size,
+            (uint8_t *)pReport,
+            report_size,
             pTxOptionsEx,
             NULL))
         {
@@ -1927,9 +2998,14 @@ handleCommandClassMeter(
       return RECEIVED_FRAME_STATUS_FAIL;
       break;
     case METER_RESET_V5:
+      if(rxOpt->destNode.endpoint != ENDPOINT_ROOT) {
+        return RECEIVED_FRAME_STATUS_NO_SUPPORT;
+      }
       if(false == Check_not_legal_response_job(rxOpt)) {
         meter_offset = total_meter_reading;
-        HAN_storeToNVM(false, true);
+        export_offset = total_export_reading;
+        HAN_scheduleStoreToNVM(false, true);
+        CC_Meter_refresh_report_cache();
         return RECEIVED_FRAME_STATUS_SUCCESS;
       }
       return RECEIVED_FRAME_STATUS_FAIL;
@@ -1940,132 +3016,1180 @@ handleCommandClassMeter(
 
 REGISTER_CC(COMMAND_CLASS_METER, METER_VERSION_V5, handleCommandClassMeter);
 
-void CC_Meter_report_power(
-    TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
-    s_CC_meter_data_t* pData)
+// Every unsolicited meter report is built by one of these, so the same frame
+// can go out either through the TSE or as one multicast to the lifeline. The
+// value comes from the report queue, and a builder returns 0 when there is
+// nothing (fresh) left to send.
+typedef uint8_t (*meter_report_builder_t)(ZW_APPLICATION_TX_BUFFER* pTxBuf, uint8_t endpoint);
+
+// Set by a builder when what it has to send doesn't fit one frame, and another
+// one follows once this one got through
+static bool meter_report_more = false;
+
+static void CC_Meter_snapshot_part_done(uint8_t status);
+
+// Reports in the frame the TSE, or the multicast engine, is sending right now
+typedef struct {
+  report_backlog_entry_t entries[METER_REPORT_CAPTURE_SIZE];
+  uint8_t count;
+} meter_report_batch_t;
+
+static meter_report_batch_t backlog_tse_in_flight;
+static meter_report_batch_t backlog_multicast_in_flight;
+
+static bool CC_Meter_send_report(
+    const char* caller,
+    TRANSMIT_OPTIONS_TYPE_SINGLE_EX* pTxOptions,
+    meter_report_builder_t builder)
 {
   DPRINTF("* %s() *\n"
       "\ttxOpt.src = %d\n"
       "\ttxOpt.options %#02x\n"
       "\ttxOpt.secOptions %#02x\n",
-      __func__, txOptions.sourceEndpoint, txOptions.txOptions, txOptions.txSecOptions);
+      caller, pTxOptions->sourceEndpoint, pTxOptions->txOptions, pTxOptions->txSecOptions);
 
   /* Prepare payload for report */
   ZAF_TRANSPORT_TX_BUFFER  TxBuf;
   ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
   memset((uint8_t*)pTxBuf, 0, sizeof(ZW_APPLICATION_TX_BUFFER) );
 
-  uint8_t response_size = set_meter_report_uint32(pTxBuf, RT_IMPORT, SCALE_W, 0, active_power_watt);
+  meter_report_capture_count = 0;
+  meter_report_more = false;
+  backlog_tse_in_flight.count = 0;
+  uint8_t response_size = builder(pTxBuf, pTxOptions->sourceEndpoint);
+  if (0 == response_size)
+  {
+    // The report went stale while waiting. Let the TSE move on as if it had
+    // been sent.
+    DPRINTF("%s(): report expired, skipped\n", caller);
+    ZAF_TSE_TXCallback(NULL);
+    return true;
+  }
+
+  memcpy(backlog_tse_in_flight.entries, meter_report_capture,
+         meter_report_capture_count * sizeof(report_backlog_entry_t));
+  backlog_tse_in_flight.count = meter_report_capture_count;
 
+  // The TSE hears back after the last frame, the ones before it go through
+  // the snapshot callback
+  tx_feedback_sent(pTxOptions->pDestNode->node.nodeId);
   if (EQUEUENOTIFYING_STATUS_SUCCESS != Transport_SendRequestEP((uint8_t *)pTxBuf,
                                                                 response_size,
-                                                                &txOptions,
-                                                                ZAF_TSE_TXCallback))
+                                                                pTxOptions,
+                                                                meter_report_more ?
+                                                                    (void *)CC_Meter_snapshot_part_done :
+                                                                    (void *)ZAF_TSE_TXCallback))
   {
     //sending request failed
-    DPRINTF("%s(): Transport_SendRequestEP() failed. \n", __func__);
+    DPRINTF("%s(): Transport_SendRequestEP() failed. \n", caller);
+    tx_feedback_result(false, 0);
+    CC_Meter_backlog_result(false);
+    return false;
+  }
+  return true;
+}
+
+static uint8_t CC_Meter_build_power(ZW_APPLICATION_TX_BUFFER* pTxBuf, uint8_t endpoint)
+{
+  int32_t value;
+  if(!report_queue_take(METRIC_POWER, xTaskGetTickCount() * portTICK_PERIOD_MS, &value)) {
+    return 0;
+  }
+  return set_meter_report_metric(pTxBuf, METRIC_POWER, true, RT_IMPORT, SCALE_W, 0, value);
+}
+
+void CC_Meter_report_power(
+    TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
+    s_CC_meter_data_t* pData)
+{
+  CC_Meter_send_report(__func__, &txOptions, CC_Meter_build_power);
+}
+
+static uint8_t CC_Meter_build_energy(ZW_APPLICATION_TX_BUFFER* pTxBuf, uint8_t endpoint)
+{
+  int32_t value;
+  if(!report_queue_take(METRIC_ENERGY, xTaskGetTickCount() * portTICK_PERIOD_MS, &value)) {
+    return 0;
   }
+  return set_meter_report_metric(pTxBuf, METRIC_ENERGY, true, RT_IMPORT, SCALE_KWH, 3, value);
 }
 
 void CC_Meter_report_energy(
     TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
     s_CC_meter_data_t* pData)
 {
-  DPRINTF("* %s() *\n"
-      "\ttxOpt.src = %d\n"
-      "\ttxOpt.options %#02x\n"
-      "\ttxOpt.secOptions %#02x\n",
-      __func__, txOptions.sourceEndpoint, txOptions.txOptions, txOptions.txSecOptions);
+  CC_Meter_send_report(__func__, &txOptions, CC_Meter_build_energy);
+}
 
-  /* Prepare payload for report */
-  ZAF_TRANSPORT_TX_BUFFER  TxBuf;
-  ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
-  memset((uint8_t*)pTxBuf, 0, sizeof(ZW_APPLICATION_TX_BUFFER) );
+static uint8_t CC_Meter_build_energy_export(ZW_APPLICATION_TX_BUFFER* pTxBuf, uint8_t endpoint)
+{
+  int32_t value;
+  if(!report_queue_take(METRIC_ENERGY_EXPORT, xTaskGetTickCount() * portTICK_PERIOD_MS, &value)) {
+    return 0;
+  }
+  return set_meter_report_metric(pTxBuf, METRIC_ENERGY_EXPORT, true, RT_EXPORT, SCALE_KWH, 3, value);
+}
 
-  uint8_t response_size = set_meter_report_uint32(pTxBuf, RT_IMPORT, SCALE_KWH, 3, total_meter_reading - meter_offset);
+void CC_Meter_report_energy_export(
+    TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
+    s_CC_meter_data_t* pData)
+{
+  CC_Meter_send_report(__func__, &txOptions, CC_Meter_build_energy_export);
+}
 
-  if (EQUEUENOTIFYING_STATUS_SUCCESS != Transport_SendRequestEP((uint8_t *)pTxBuf,
-                                                                response_size,
-                                                                &txOptions,
-                                                                ZAF_TSE_TXCallback))
-  {
-    //sending request failed
-    DPRINTF("%s(): Transport_SendRequestEP() failed. \n", __func__);
+static uint8_t CC_Meter_build_reactive_power(ZW_APPLICATION_TX_BUFFER* pTxBuf, uint8_t endpoint)
+{
+  int32_t value;
+  if(!report_queue_take(METRIC_REACTIVE_POWER, xTaskGetTickCount() * portTICK_PERIOD_MS, &value)) {
+    return 0;
   }
+  return set_meter_report_metric(pTxBuf, METRIC_REACTIVE_POWER, true, RT_IMPORT, SCALE_KVAR, 3, value);
 }
 
-void CC_Meter_report_unhandled_as_voltage(
+void CC_Meter_report_reactive_power(
     TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
-    void* pData)
+    s_CC_meter_data_t* pData)
 {
-  DPRINTF("* %s() *\n"
-      "\ttxOpt.src = %d\n"
-      "\ttxOpt.options %#02x\n"
-      "\ttxOpt.secOptions %#02x\n",
-      __func__, txOptions.sourceEndpoint, txOptions.txOptions, txOptions.txSecOptions);
+  CC_Meter_send_report(__func__, &txOptions, CC_Meter_build_reactive_power);
+}
 
-  /* Prepare payload for report */
-  ZAF_TRANSPORT_TX_BUFFER  TxBuf;
-  ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
-  memset((uint8_t*)pTxBuf, 0, sizeof(ZW_APPLICATION_TX_BUFFER) );
+static uint8_t CC_Meter_build_reactive_energy(ZW_APPLICATION_TX_BUFFER* pTxBuf, uint8_t endpoint)
+{
+  int32_t value;
+  if(!report_queue_take(METRIC_REACTIVE_ENERGY, xTaskGetTickCount() * portTICK_PERIOD_MS, &value)) {
+    return 0;
+  }
+  return set_meter_report_metric(pTxBuf, METRIC_REACTIVE_ENERGY, true, RT_IMPORT, SCALE_KVARH, 3, value);
+}
 
-  uint8_t response_size = set_meter_report_uint32(pTxBuf, RT_IMPORT, SCALE_V, 0, unhandledCommandStatus);
+void CC_Meter_report_reactive_energy(
+    TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
+    s_CC_meter_data_t* pData)
+{
+  CC_Meter_send_report(__func__, &txOptions, CC_Meter_build_reactive_energy);
+}
 
-  if (EQUEUENOTIFYING_STATUS_SUCCESS != Transport_SendRequestEP((uint8_t *)pTxBuf,
-                                                                response_size,
-                                                                &txOptions,
-                                                                ZAF_TSE_TXCallback))
-  {
-    //sending request failed
-    DPRINTF("%s(): Transport_SendRequestEP() failed. \n", __func__);
+static uint8_t CC_Meter_build_apparent_energy(ZW_APPLICATION_TX_BUFFER* pTxBuf, uint8_t endpoint)
+{
+  int32_t value;
+  if(!report_queue_take(METRIC_APPARENT_ENERGY, xTaskGetTickCount() * portTICK_PERIOD_MS, &value)) {
+    return 0;
   }
+  return set_meter_report_metric(pTxBuf, METRIC_APPARENT_ENERGY, true, RT_IMPORT, SCALE_KVAH, 3, value);
 }
 
-void CC_Meter_report_unhandled_as_current(
+void CC_Meter_report_apparent_energy(
     TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
-    void* pData)
+    s_CC_meter_data_t* pData)
 {
-  DPRINTF("* %s() *\n"
-      "\ttxOpt.src = %d\n"
-      "\ttxOpt.options %#02x\n"
-      "\ttxOpt.secOptions %#02x\n",
-      __func__, txOptions.sourceEndpoint, txOptions.txOptions, txOptions.txSecOptions);
+  CC_Meter_send_report(__func__, &txOptions, CC_Meter_build_apparent_energy);
+}
 
-  /* Prepare payload for report */
-  ZAF_TRANSPORT_TX_BUFFER  TxBuf;
-  ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
-  memset((uint8_t*)pTxBuf, 0, sizeof(ZW_APPLICATION_TX_BUFFER) );
+// Voltage and current go out from the endpoint of their phase
+static uint8_t CC_Meter_build_voltage(ZW_APPLICATION_TX_BUFFER* pTxBuf, uint8_t endpoint)
+{
+  report_metric_t metric = METRIC_VOLTAGE_L1 + endpoint - ENDPOINT_1;
+  int32_t value;
+  if(!report_queue_take(metric, xTaskGetTickCount() * portTICK_PERIOD_MS, &value)) {
+    return 0;
+  }
+  return set_meter_report_metric(pTxBuf, metric, true, RT_IMPORT, SCALE_V, 0, value);
+}
 
-  uint8_t response_size = set_meter_report_uint32(pTxBuf, RT_IMPORT, SCALE_A, 0, unhandledPacket);
+void CC_Meter_report_voltage(
+    TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
+    s_CC_meter_data_t* pData)
+{
+  CC_Meter_send_report(__func__, &txOptions, CC_Meter_build_voltage);
+}
 
-  if (EQUEUENOTIFYING_STATUS_SUCCESS != Transport_SendRequestEP((uint8_t *)pTxBuf,
-                                                                response_size,
-                                                                &txOptions,
-                                                                ZAF_TSE_TXCallback))
-  {
-    //sending request failed
-    DPRINTF("%s(): Transport_SendRequestEP() failed. \n", __func__);
+static uint8_t CC_Meter_build_current(ZW_APPLICATION_TX_BUFFER* pTxBuf, uint8_t endpoint)
+{
+  report_metric_t metric = METRIC_CURRENT_L1 + endpoint - ENDPOINT_1;
+  int32_t value;
+  if(!report_queue_take(metric, xTaskGetTickCount() * portTICK_PERIOD_MS, &value)) {
+    return 0;
   }
+  return set_meter_report_metric(pTxBuf, metric, true, RT_IMPORT, SCALE_A, 3, value);
 }
 
-void CC_Meter_update_power(void)
+void CC_Meter_report_current(
+    TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
+    s_CC_meter_data_t* pData)
 {
-  /* Update the lifeline destinations when the Binary Switch state has changed */
-  void * pData = CC_Meter_prepare_zaf_tse_data(&zaf_tse_local_actuation);
-  ZAF_TSE_Trigger((void *)CC_Meter_report_power, pData, true);
-  last_reported_power_watt = active_power_watt;
+  CC_Meter_send_report(__func__, &txOptions, CC_Meter_build_current);
 }
 
-void CC_Meter_update_energy(void)
+// Estimated accumulated energy, relative to the last meter reset
+uint32_t CC_Meter_energy_estimate(void)
 {
-  /* Update the lifeline destinations when the Binary Switch state has changed */
-  void * pData = CC_Meter_prepare_zaf_tse_data(&zaf_tse_local_actuation);
-  ZAF_TSE_Trigger((void *)CC_Meter_report_energy, pData, true);
+  uint32_t estimate = energy_estimator_estimate();
+  return estimate > meter_offset ? estimate - meter_offset : 0;
+}
+
+// The estimate goes out from its own endpoint, as plain import energy. On the
+// root device it would be taken for the meter reading, which it isn't: once
+// the hourly reading comes in, that may well be lower than the estimate was.
+static uint8_t CC_Meter_build_energy_estimate(ZW_APPLICATION_TX_BUFFER* pTxBuf, uint8_t endpoint)
+{
+  int32_t value;
+  if(!report_queue_take(METRIC_ENERGY_ESTIMATE, xTaskGetTickCount() * portTICK_PERIOD_MS, &value)) {
+    return 0;
+  }
+  return set_meter_report_metric(pTxBuf, METRIC_ENERGY_ESTIMATE, true, RT_IMPORT, SCALE_KWH, 3, value);
+}
+
+void CC_Meter_report_energy_estimate(
+    TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
+    s_CC_meter_data_t* pData)
+{
+  CC_Meter_send_report(__func__, &txOptions, CC_Meter_build_energy_estimate);
+}
+
+/*******************************************************************************
+ * Multi Command bundling. A snapshot of the root device (W, kWh, kvar, and
+ * exported kWh) costs one frame, and one S2 encapsulation, instead of one of
+ * each per value. Multi Channel has to wrap Multi Command rather than the
+ * other way around, so the phase values stay out of it and each phase
+ * endpoint reports on its own. A bundle never gets bigger than what fits a
+ * frame without Transport Service, so a snapshot too big for that goes out as
+ * more than one bundle.
+ ******************************************************************************/
+static multi_cmd_stats_t multi_cmd_stats;
+
+// The commands of a snapshot, in the order they go out
+typedef enum {
+  SNAPSHOT_POWER = 0,
+  SNAPSHOT_ENERGY,
+  SNAPSHOT_REACTIVE_POWER,
+  SNAPSHOT_ENERGY_EXPORT,
+  SNAPSHOT_COMMANDS
+} snapshot_command_t;
+
+// Returns 0 when there's nothing to report for the command
+static uint8_t CC_Meter_build_snapshot_command(uint8_t command, ZW_APPLICATION_TX_BUFFER* pReport)
+{
+  switch(command) {
+    case SNAPSHOT_POWER:
+      if(!list1_recv) {
+        return 0;
+      }
+      return set_meter_report_metric(pReport, METRIC_POWER, true, RT_IMPORT, SCALE_W, 0, CC_Meter_filtered_power());
+    case SNAPSHOT_ENERGY:
+      if(!list3_recv) {
+        return 0;
+      }
+      return set_meter_report_metric(pReport, METRIC_ENERGY, true, RT_IMPORT, SCALE_KWH, 3, total_meter_reading - meter_offset);
+    case SNAPSHOT_REACTIVE_POWER:
+      if(!list2_recv) {
+        return 0;
+      }
+      return set_meter_report_metric(pReport, METRIC_REACTIVE_POWER, true, RT_IMPORT, SCALE_KVAR, 3, CC_Meter_net_reactive_power());
+    case SNAPSHOT_ENERGY_EXPORT:
+      if(!list3_recv || total_export_reading == 0) {
+        return 0;
+      }
+      return set_meter_report_metric(pReport, METRIC_ENERGY_EXPORT, true, RT_EXPORT, SCALE_KWH, 3, total_export_reading - export_offset);
+    default:
+      return 0;
+  }
+}
+
+// Bundle as many of the snapshot commands from *pNext on as fit one frame, and
+// move *pNext past them
+static uint8_t CC_Meter_build_snapshot(uint8_t* pBuf, uint8_t* pNext)
+{
+  multi_cmd_bundle_t bundle;
+  multi_cmd_begin(&bundle, pBuf, MULTI_CMD_MAX_PAYLOAD);
+
+  ZW_APPLICATION_TX_BUFFER report;
+
+  for(; *pNext < SNAPSHOT_COMMANDS; (*pNext)++) {
+    uint8_t captured = meter_report_capture_count;
+    uint8_t report_size = CC_Meter_build_snapshot_command(*pNext, &report);
+    if(report_size == 0) {
+      continue;
+    }
+    if(!multi_cmd_append(&bundle, (uint8_t*)&report, report_size)) {
+      // Goes in the next bundle, and is noted for the backlog with that one
+      meter_report_capture_count = captured;
+      break;
+    }
+  }
+
+  return multi_cmd_finish(&bundle, &multi_cmd_stats);
+}
+
+/*******************************************************************************
+ * Callback logic for sending a snapshot one bundle at a time. The TSE serves
+ * one destination at a time, and only hears back once the last bundle to that
+ * destination is through.
+ ******************************************************************************/
+typedef struct {
+  bool in_progress;                             // are more bundles on their way?
+  TRANSMIT_OPTIONS_TYPE_SINGLE_EX pkg_options;  // transmit options for sending the next bundle
+  uint8_t next;                                 // first command of the next bundle
+} snapshot_in_progress_t;
+
+static snapshot_in_progress_t snapshot_in_progress = {
+  .in_progress = false,
+};
+
+static uint8_t CC_Meter_build_snapshot_part(ZW_APPLICATION_TX_BUFFER* pTxBuf, uint8_t endpoint)
+{
+  uint8_t length = CC_Meter_build_snapshot((uint8_t*)pTxBuf, &snapshot_in_progress.next);
+  meter_report_more = snapshot_in_progress.next < SNAPSHOT_COMMANDS;
+  return length;
+}
+
+static uint8_t CC_Meter_build_snapshot_report(ZW_APPLICATION_TX_BUFFER* pTxBuf, uint8_t endpoint)
+{
+  int32_t unused;
+  if(!report_queue_take(REPORT_QUEUE_SNAPSHOT, xTaskGetTickCount() * portTICK_PERIOD_MS, &unused)) {
+    return 0;
+  }
+
+  snapshot_in_progress.next = 0;
+  return CC_Meter_build_snapshot_part(pTxBuf, endpoint);
+}
+
+static void CC_Meter_snapshot_part_done(uint8_t status)
+{
+  // Same bookkeeping as for a frame the TSE sent
+  tx_feedback_result(TRANSMIT_COMPLETE_OK == status, 0);
+  CC_Meter_backlog_result(TRANSMIT_COMPLETE_OK == status);
+
+  if(TRANSMIT_COMPLETE_OK == status) {
+    snapshot_in_progress.in_progress =
+        CC_Meter_send_report(__func__, &snapshot_in_progress.pkg_options, CC_Meter_build_snapshot_part) &&
+        meter_report_more;
+    return;
+  }
+
+  // The rest wouldn't get through either. Keep it for the backlog, and let the
+  // TSE move on to the next destination.
+  ZW_APPLICATION_TX_BUFFER report;
+  meter_report_capture_count = 0;
+  for(; snapshot_in_progress.next < SNAPSHOT_COMMANDS; snapshot_in_progress.next++) {
+    CC_Meter_build_snapshot_command(snapshot_in_progress.next, &report);
+  }
+  memcpy(backlog_tse_in_flight.entries, meter_report_capture,
+         meter_report_capture_count * sizeof(report_backlog_entry_t));
+  backlog_tse_in_flight.count = meter_report_capture_count;
+  CC_Meter_backlog_result(false);
+
+  snapshot_in_progress.in_progress = false;
+  ZAF_TSE_TXCallback(NULL);
+}
+
+void CC_Meter_report_snapshot(
+    TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
+    s_CC_meter_data_t* pData)
+{
+  snapshot_in_progress.pkg_options = txOptions;
+  snapshot_in_progress.in_progress =
+      CC_Meter_send_report(__func__, &snapshot_in_progress.pkg_options, CC_Meter_build_snapshot_report) &&
+      meter_report_more;
+}
+
+// Incoming Multi Command: hand each encapsulated command to the regular
+// command handler, as if it had been received on its own.
+received_frame_status_t
+handleCommandClassMultiCmd(
+  RECEIVE_OPTIONS_TYPE_EX *rxOpt,
+  ZW_APPLICATION_TX_BUFFER *pCmd,
+  uint8_t cmdLength)
+{
+  if(pCmd->ZW_Common.cmd != MULTI_CMD_ENCAP || cmdLength < 3) {
+    return RECEIVED_FRAME_STATUS_NO_SUPPORT;
+  }
+
+  uint8_t* pFrame = (uint8_t*)pCmd;
+  uint8_t num_commands = pFrame[2];
+  size_t offset = 3;
+
+  for(uint8_t i = 0; i < num_commands; i++) {
+    if(offset >= cmdLength) {
+      return RECEIVED_FRAME_STATUS_FAIL;
+    }
+
+    uint8_t length = pFrame[offset];
+    if(length < 2 || offset + 1 + length > cmdLength ||
+       pFrame[offset + 1] == COMMAND_CLASS_MULTI_CMD) {
+      // Malformed, or trying to nest Multi Command
+      return RECEIVED_FRAME_STATUS_FAIL;
+    }
+
+    Transport_ApplicationCommandHandlerEx(rxOpt,
+                                          (ZW_APPLICATION_TX_BUFFER*)&pFrame[offset + 1],
+                                          length);
+    offset += 1 + length;
+  }
+  return RECEIVED_FRAME_STATUS_SUCCESS;
+}
+
+REGISTER_CC(COMMAND_CLASS_MULTI_CMD, MULTI_CMD_VERSION, handleCommandClassMultiCmd);
+
+/*******************************************************************************
+ * Lifeline multicast. With more than one node in the lifeline, a periodic
+ * report is built once and handed to the multicast engine, which sends one
+ * multicast frame instead of the TSE sending a singlecast to every destination.
+ * Under S2 the multicast engine also sends every destination a singlecast
+ * follow-up, which makes the multicast cost more than it saves for any number
+ * of destinations: it only ever goes out on a network without security.
+ ******************************************************************************/
+
+static struct {
+  uint32_t multicasts_sent;
+  uint32_t destinations_covered;
+  uint32_t fallbacks;
+  uint32_t singlecast_cheaper;
+  uint32_t failures;
+  uint32_t bytes_saved;
+} lifeline_multicast_stats;
+
+static void CC_Meter_backlog_batch_result(const meter_report_batch_t* pBatch, bool success);
+
+static void CC_Meter_multicast_done(TRANSMISSION_RESULT * pTransmissionResult)
+{
+  tx_feedback_node_result(pTransmissionResult->nodeId,
+                          TRANSMITTED_OK == pTransmissionResult->status, 0);
+  if (TRANSMITTED_OK != pTransmissionResult->status)
+  {
+    lifeline_multicast_stats.failures++;
+    DPRINTF("Lifeline multicast to node %u failed\n", pTransmissionResult->nodeId);
+  }
+  CC_Meter_backlog_batch_result(&backlog_multicast_in_flight,
+                                TRANSMITTED_OK == pTransmissionResult->status);
+}
+
+static uint8_t CC_Meter_lifeline_destinations(void)
+{
+  destination_info_t * pList = NULL;
+  uint8_t length = 0;
+  if (NODE_LIST_STATUS_SUCCESS != handleAssociationGetnodeList(1, ENDPOINT_ROOT, &pList, &length))
+  {
+    return 0;
+  }
+  return length;
+}
+
+// Send a report to the lifeline: multicast when it has several destinations
+// and that saves airtime, through the TSE otherwise or if the multicast engine
+// can't take it now.
+static void CC_Meter_update_lifeline(uint8_t endpoint, uint8_t slot, int32_t value,
+                                     void* tseCallback, meter_report_builder_t builder)
+{
+  if(!report_queue_post(slot, value, xTaskGetTickCount() * portTICK_PERIOD_MS)) {
+    // An earlier report is still waiting, and now carries this value instead
+    return;
+  }
+
+  uint8_t destinations = CC_Meter_lifeline_destinations();
+
+  // A snapshot still going out in bundles owns the snapshot state, the next one
+  // waits for it in the TSE
+  if(destinations > 1 && !(slot == REPORT_QUEUE_SNAPSHOT && snapshot_in_progress.in_progress)) {
+    AGI_PROFILE lifelineProfile = {
+        ASSOCIATION_GROUP_INFO_REPORT_PROFILE_GENERAL,
+        ASSOCIATION_GROUP_INFO_REPORT_PROFILE_GENERAL_LIFELINE
+    };
+    ZW_APPLICATION_TX_BUFFER report;
+    memset((uint8_t*)&report, 0, sizeof(report));
+    meter_report_capture_count = 0;
+    meter_report_more = false;
+    uint8_t report_size = builder(&report, endpoint);
+    if(0 == report_size) {
+      return;
+    }
+    CMD_CLASS_GRP cmdGrp = {report.ZW_Common.cmdClass, report.ZW_Common.cmd};
+    memcpy(backlog_multicast_in_flight.entries, meter_report_capture,
+           meter_report_capture_count * sizeof(report_backlog_entry_t));
+    backlog_multicast_in_flight.count = meter_report_capture_count;
+
+    // The multicast engine can't chain frames, so a report that takes more
+    // than one is left in its slot for the TSE. So is one that's cheaper to
+    // send as singlecasts.
+    int32_t saving = frame_cost_multicast_saving(destinations, report_size,
+        SECURITY_KEY_NONE != GetHighestSecureLevel(ZAF_GetSecurityKeys()));
+    if(!meter_report_more && saving > 0 &&
+       JOB_STATUS_SUCCESS == cc_engine_multicast_request(&lifelineProfile,
+                                                         endpoint,
+                                                         &cmdGrp,
+                                                         ((uint8_t*)&report) + 2,
+                                                         report_size - 2,
+                                                         false,
+                                                         CC_Meter_multicast_done))
+    {
+      lifeline_multicast_stats.multicasts_sent++;
+      lifeline_multicast_stats.destinations_covered += destinations;
+      lifeline_multicast_stats.bytes_saved += saving;
+      return;
+    }
+    if(saving > 0) {
+      lifeline_multicast_stats.fallbacks++;
+    } else {
+      lifeline_multicast_stats.singlecast_cheaper++;
+    }
+  }
+
+  RECEIVE_OPTIONS_TYPE_EX rxOptions = zaf_tse_local_actuation;
+  rxOptions.destNode.endpoint = endpoint;
+  void * pData = CC_Meter_prepare_zaf_tse_data(&rxOptions);
+  if(!ZAF_TSE_Trigger(tseCallback, pData, true)) {
+    report_queue_cancel(slot);
+  }
+}
+
+/*******************************************************************************
+ * Store-and-forward. Root reports which didn't reach the lifeline are kept in
+ * the report backlog, and replayed once a report gets through again. A replay
+ * carries the current value, with the kept value as the previous value and its
+ * age as the delta time, which lets the controller fill in the gap. The whole
+ * lifeline gets the replay, as the backlog doesn't track who missed what.
+ ******************************************************************************/
+// Give the controller a moment after it has come back
+#define BACKLOG_REPLAY_DELAY_MS 2000
+// Between batches, while there's more to replay
+#define BACKLOG_REPLAY_NEXT_MS 200
+// Oldest report the delta time field can place
+#define BACKLOG_MAX_AGE_S 0xFFFF
+
+static struct {
+  SSwTimer timer;
+  bool     timer_registered;
+  bool     active;
+  uint8_t  batch;      // reports in the frame being replayed
+  uint8_t  in_flight;  // destinations still to hear back from
+  bool     delivered;  // at least one destination got the frame
+} backlog_replay = {
+  .timer_registered = false,
+  .active = false,
+};
+
+static void CC_Meter_backlog_replay(SSwTimer* pTimer);
+
+static int32_t CC_Meter_metric_value(report_metric_t metric)
+{
+  switch(metric) {
+    case METRIC_POWER:
+      return CC_Meter_filtered_power();
+    case METRIC_ENERGY:
+      return total_meter_reading - meter_offset;
+    case METRIC_ENERGY_EXPORT:
+      return total_export_reading - export_offset;
+    case METRIC_REACTIVE_POWER:
+      return CC_Meter_net_reactive_power();
+    case METRIC_REACTIVE_ENERGY:
+      return total_reactive_import_reading;
+    case METRIC_APPARENT_ENERGY:
+      return apparent_energy_total();
+    default:
+      return 0;
+  }
+}
+
+static uint8_t CC_Meter_build_backlog_report(ZW_APPLICATION_TX_BUFFER* pTxBuf,
+                                             const report_backlog_entry_t* pEntry,
+                                             uint32_t now_s)
+{
+  uint32_t age_s = now_s - pEntry->timestamp_s;
+  return set_meter_report_value(pTxBuf, pEntry->rate, pEntry->scale, pEntry->precision,
+                                CC_Meter_metric_value(pEntry->metric), pEntry->value,
+                                age_s == 0 ? 1 : (uint16_t)age_s);
+}
+
+// As many of the oldest reports as fit in one Multi Command frame when
+// bundling is on, one report per frame otherwise
+static uint8_t CC_Meter_build_backlog_batch(ZW_APPLICATION_TX_BUFFER* pTxBuf, uint8_t* pBatch)
+{
+  uint32_t now_s = CC_Meter_uptime_s();
+  uint8_t count = report_backlog_count();
+
+  if(CC_ConfigurationData.bundle_reports != 1 || count == 1) {
+    *pBatch = 1;
+    return CC_Meter_build_backlog_report(pTxBuf, report_backlog_peek(0), now_s);
+  }
+
+  multi_cmd_bundle_t bundle;
+  multi_cmd_begin(&bundle, (uint8_t*)pTxBuf, MULTI_CMD_MAX_PAYLOAD);
+
+  ZW_APPLICATION_TX_BUFFER report;
+  uint8_t i;
+  for(i = 0; i < count; i++) {
+    uint8_t report_size = CC_Meter_build_backlog_report(&report, report_backlog_peek(i), now_s);
+    if(!multi_cmd_append(&bundle, (uint8_t*)&report, report_size)) {
+      break;
+    }
+  }
+  *pBatch = i;
+  return multi_cmd_finish(&bundle, NULL);
+}
+
+static void CC_Meter_backlog_start_replay(void)
+{
+  if(backlog_replay.active || report_backlog_count() == 0) {
+    return;
+  }
+
+  if(!backlog_replay.timer_registered) {
+    AppTimerRegister(&backlog_replay.timer, false, CC_Meter_backlog_replay);
+    backlog_replay.timer_registered = true;
+  }
+  backlog_replay.active = true;
+  TimerStart(&backlog_replay.timer, BACKLOG_REPLAY_DELAY_MS);
+}
+
+static void CC_Meter_backlog_replay_done(uint8_t status)
+{
+  if(TRANSMIT_COMPLETE_OK == status) {
+    backlog_replay.delivered = true;
+  }
+  if(backlog_replay.in_flight > 0 && --backlog_replay.in_flight > 0) {
+    return;
+  }
+
+  if(!backlog_replay.delivered) {
+    // Gone again, wait for the next report to get through
+    backlog_replay.active = false;
+    return;
+  }
+
+  report_backlog_drop(backlog_replay.batch);
+  if(report_backlog_count() > 0) {
+    TimerStart(&backlog_replay.timer, BACKLOG_REPLAY_NEXT_MS);
+    return;
+  }
+
+  backlog_replay.active = false;
+}
+
+static void CC_Meter_backlog_replay(SSwTimer* pTimer)
+{
+  (void)pTimer;
+
+  report_backlog_expire(CC_Meter_uptime_s(), BACKLOG_MAX_AGE_S);
+
+  destination_info_t * pList = NULL;
+  uint8_t destinations = 0;
+  if (report_backlog_count() == 0 ||
+      NODE_LIST_STATUS_SUCCESS != handleAssociationGetnodeList(1, ENDPOINT_ROOT, &pList, &destinations) ||
+      0 == destinations)
+  {
+    backlog_replay.active = false;
+    return;
+  }
+
+  /* Prepare payload for report */
+  ZAF_TRANSPORT_TX_BUFFER  TxBuf;
+  ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
+  memset((uint8_t*)pTxBuf, 0, sizeof(ZW_APPLICATION_TX_BUFFER) );
+
+  uint8_t response_size = CC_Meter_build_backlog_batch(pTxBuf, &backlog_replay.batch);
+
+  backlog_replay.delivered = false;
+  backlog_replay.in_flight = 0;
+  for (uint8_t i = 0; i < destinations; i++)
+  {
+    TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions;
+    memset((uint8_t*)&txOptions, 0, sizeof(txOptions));
+    txOptions.sourceEndpoint = ENDPOINT_ROOT;
+    txOptions.pDestNode = &pList[i];
+    txOptions.txOptions = ZWAVE_PLUS_TX_OPTIONS;
+
+    if (EQUEUENOTIFYING_STATUS_SUCCESS == Transport_SendRequestEP((uint8_t *)pTxBuf,
+                                                                  response_size,
+                                                                  &txOptions,
+                                                                  CC_Meter_backlog_replay_done))
+    {
+      backlog_replay.in_flight++;
+    }
+  }
+
+  if (0 == backlog_replay.in_flight)
+  {
+    // The queue is full, have another go on the next report that gets through
+    backlog_replay.active = false;
+  }
+}
+
+// A report frame got through, or didn't. Either replay what's waiting now that
+// the lifeline is back, or keep the reports in the frame for later.
+static void CC_Meter_backlog_batch_result(const meter_report_batch_t* pBatch, bool success)
+{
+  if(success) {
+    CC_Meter_backlog_start_replay();
+    return;
+  }
+
+  for(uint8_t i = 0; i < pBatch->count; i++) {
+    report_backlog_push(&pBatch->entries[i]);
+  }
+}
+
+void CC_Meter_backlog_result(bool success)
+{
+  CC_Meter_backlog_batch_result(&backlog_tse_in_flight, success);
+  backlog_tse_in_flight.count = 0;
+}
+
+void CC_Meter_report_unhandled_as_voltage(
+    TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
+    void* pData)
+{
+  DPRINTF("* %s() *\n"
+      "\ttxOpt.src = %d\n"
+      "\ttxOpt.options %#02x\n"
+      "\ttxOpt.secOptions %#02x\n",
+      __func__, txOptions.sourceEndpoint, txOptions.txOptions, txOptions.txSecOptions);
+
+  /* Prepare payload for report */
+  ZAF_TRANSPORT_TX_BUFFER  TxBuf;
+  ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
+  memset((uint8_t*)pTxBuf, 0, sizeof(ZW_APPLICATION_TX_BUFFER) );
+
+  uint8_t response_size = set_meter_report_uint32(pTxBuf, RT_IMPORT, SCALE_V, 0, unhandledCommandStatus);
+
+  if (EQUEUENOTIFYING_STATUS_SUCCESS != Transport_SendRequestEP((uint8_t *)pTxBuf,
+                                                                response_size,
+                                                                &txOptions,
+                                                                ZAF_TSE_TXCallback))
+  {
+    //sending request failed
+    DPRINTF("%s(): Transport_SendRequestEP() failed. \n", __func__);
+  }
+}
+
+void CC_Meter_report_unhandled_as_current(
+    TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions,
+    void* pData)
+{
+  DPRINTF("* %s() *\n"
+      "\ttxOpt.src = %d\n"
+      "\ttxOpt.options %#02x\n"
+      "\ttxOpt.secOptions %#02x\n",
+      __func__, txOptions.sourceEndpoint, txOptions.txOptions, txOptions.txSecOptions);
+
+  /* Prepare payload for report */
+  ZAF_TRANSPORT_TX_BUFFER  TxBuf;
+  ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
+  memset((uint8_t*)pTxBuf, 0, sizeof(ZW_APPLICATION_TX_BUFFER) );
+
+  uint8_t response_size = set_meter_report_uint32(pTxBuf, RT_IMPORT, SCALE_A, 0, unhandledPacket);
+
+  if (EQUEUENOTIFYING_STATUS_SUCCESS != Transport_SendRequestEP((uint8_t *)pTxBuf,
+                                                                response_size,
+                                                                &txOptions,
+                                                                ZAF_TSE_TXCallback))
+  {
+    //sending request failed
+    DPRINTF("%s(): Transport_SendRequestEP() failed. \n", __func__);
+  }
 }
 
 /*******************************************************************************
- * TODO: add support for querying meter GSIN over Z-Wave. This would require
- * support for the much more complicated 'meter table' CC, though. And since it
- * is a much more recent CC, OpenZWave doesn't support it yet, so I can't really
- * be bothered to implement it here either.
+ * Power stream. Every power reading goes to association group 2 as it comes
+ * in, regardless of the reporting policy, as a bare Meter Report: no history
+ * and no TSE bookkeeping. Samples are only useful while fresh, so a new one is
+ * dropped rather than queued behind one still in the air.
  ******************************************************************************/
+#define STREAM_GROUP 2
+
+static struct {
+  uint32_t samples;
+  uint32_t delivered;
+  uint32_t dropped_busy;
+  uint32_t dropped_failed;
+} stream_stats;
+
+static uint8_t stream_in_flight = 0;
+
+static void CC_Meter_stream_done(uint8_t status)
+{
+  if (stream_in_flight > 0)
+  {
+    stream_in_flight--;
+  }
+
+  if (TRANSMIT_COMPLETE_OK == status)
+  {
+    stream_stats.delivered++;
+  }
+  else
+  {
+    stream_stats.dropped_failed++;
+  }
+}
+
+void CC_Meter_stream_power(void)
+{
+  destination_info_t * pList = NULL;
+  uint8_t destinations = 0;
+  if (NODE_LIST_STATUS_SUCCESS != handleAssociationGetnodeList(STREAM_GROUP, ENDPOINT_ROOT, &pList, &destinations) ||
+      0 == destinations)
+  {
+    return;
+  }
+
+  stream_stats.samples++;
+
+  if (stream_in_flight > 0)
+  {
+    stream_stats.dropped_busy += destinations;
+  }
+  else
+  {
+    /* Prepare payload for report */
+    ZAF_TRANSPORT_TX_BUFFER  TxBuf;
+    ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
+    memset((uint8_t*)pTxBuf, 0, sizeof(ZW_APPLICATION_TX_BUFFER) );
+
+    uint8_t response_size = set_meter_report_value(pTxBuf, RT_IMPORT, SCALE_W, 0, CC_Meter_net_power(), 0, 0);
+
+    for (uint8_t i = 0; i < destinations; i++)
+    {
+      TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions;
+      memset((uint8_t*)&txOptions, 0, sizeof(txOptions));
+      txOptions.sourceEndpoint = ENDPOINT_ROOT;
+      txOptions.pDestNode = &pList[i];
+      // Optionally skip routing: a late sample is worth less than the next one
+      txOptions.txOptions = (CC_ConfigurationData.stream_no_route == 1) ?
+                            (TRANSMIT_OPTION_ACK | TRANSMIT_OPTION_NO_ROUTE) :
+                            ZWAVE_PLUS_TX_OPTIONS;
+
+      if (EQUEUENOTIFYING_STATUS_SUCCESS == Transport_SendRequestEP((uint8_t *)pTxBuf,
+                                                                    response_size,
+                                                                    &txOptions,
+                                                                    CC_Meter_stream_done))
+      {
+        stream_in_flight++;
+      }
+      else
+      {
+        stream_stats.dropped_busy++;
+      }
+    }
+  }
+}
+
+/*******************************************************************************
+ * Raw HAN frame tunnel. Complete HDLC frames with a valid FCS go to association
+ * group 3 as segmented Manufacturer Proprietary commands, so a hub can decode
+ * meters and lists the parser doesn't know about.
+ ******************************************************************************/
+#define TUNNEL_GROUP 3
+
+#if HAN_TUNNEL_SEGMENT_DATA != MFG_PROPRIETARY_SEGMENT_DATA
+#error "han_tunnel.h is out of step with the Manufacturer Proprietary segments"
+#endif
+
+static struct {
+  uint32_t forwarded;
+  uint32_t failed;
+  uint32_t busy;
+  uint32_t rate_limited;
+  uint32_t duplicates;
+  uint32_t segments;
+} tunnel_stats;
+
+static uint8_t tunnel_sequence = 0;
+static bool tunnel_has_last = false;
+static uint32_t tunnel_last_ms;
+static size_t tunnel_last_length;
+static uint16_t tunnel_last_fcs;
+
+static void HAN_tunnelDone(bool success, uint16_t segments, uint32_t bytes)
+{
+  (void)bytes;
+  han_tunnel_release();
+
+  if(success) {
+    tunnel_stats.forwarded++;
+  } else {
+    tunnel_stats.failed++;
+  }
+  tunnel_stats.segments += segments;
+}
+
+void HAN_tunnelFrame(void)
+{
+  size_t length;
+  const uint8_t* pFrame = han_tunnel_frame(&length);
+  if(pFrame == NULL) {
+    return;
+  }
+
+  destination_info_t * pList = NULL;
+  uint8_t destinations = 0;
+  if (NODE_LIST_STATUS_SUCCESS != handleAssociationGetnodeList(TUNNEL_GROUP, ENDPOINT_ROOT, &pList, &destinations) ||
+      0 == destinations)
+  {
+    han_tunnel_release();
+    return;
+  }
+
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  uint16_t fcs = pFrame[length - 2] | (pFrame[length - 1] << 8);
+
+  if(tunnel_has_last && CC_ConfigurationData.han_tunnel_interval != 0 &&
+     now_ms - tunnel_last_ms < CC_ConfigurationData.han_tunnel_interval * 1000UL) {
+    tunnel_stats.rate_limited++;
+    han_tunnel_release();
+    return;
+  }
+
+  if(tunnel_has_last && CC_ConfigurationData.han_tunnel_dedupe == 1 &&
+     length == tunnel_last_length && fcs == tunnel_last_fcs) {
+    tunnel_stats.duplicates++;
+    han_tunnel_release();
+    return;
+  }
+
+  if(!CC_ManufacturerProprietary_send(MFG_PROPRIETARY_TYPE_HAN_FRAME, tunnel_sequence,
+                                      pFrame, length, pList, destinations,
+                                      HAN_tunnelDone)) {
+    tunnel_stats.busy++;
+    han_tunnel_release();
+    return;
+  }
+
+  tunnel_sequence++;
+  tunnel_has_last = true;
+  tunnel_last_ms = now_ms;
+  tunnel_last_length = length;
+  tunnel_last_fcs = fcs;
+}
+
+/*******************************************************************************
+ * History transfer. A History Get asks for the blocks of one tier of the power
+ * history which overlap a range of ages, and gets them back compressed as they
+ * are stored, a few blocks per segmented transfer. A request which didn't get
+ * through can be resumed from the sequence number of the last block received.
+ ******************************************************************************/
+#define HISTORY_BLOCKS_PER_TRANSFER 4
+#define HISTORY_GET_TIER_MASK 0x03
+#define HISTORY_GET_RESUME 0x80
+
+static uint8_t history_buffer[HISTORY_WIRE_TRANSFER_HEADER_SIZE +
+                              HISTORY_BLOCKS_PER_TRANSFER * HISTORY_WIRE_BLOCK_MAX_SIZE];
+
+static struct {
+  bool active;
+  bool more;                // another transfer follows the one in the air
+  destination_info_t requester;
+  timeseries_tier_t tier;
+  uint32_t from_age;        // oldest end of the range, in tier units
+  uint32_t to_age;          // newest end of the range, in tier units
+  bool resume;
+  uint16_t next_sequence;   // first block not sent yet, when resuming
+  uint8_t sequence;         // of the segmented transfer
+  uint32_t segments;         // what the request has cost so far
+} history_transfer;
+
+static uint32_t HAN_historyGetU32(const uint8_t* pBuf)
+{
+  return ((uint32_t)pBuf[0] << 24) | ((uint32_t)pBuf[1] << 16) |
+         ((uint32_t)pBuf[2] << 8) | pBuf[3];
+}
+
+static bool HAN_historyWanted(const timeseries_block_t* pBlock, uint32_t now)
+{
+  if(history_transfer.resume &&
+     (int16_t)(pBlock->sequence - history_transfer.next_sequence) < 0) {
+    return false;
+  }
+  uint32_t start_age = now - pBlock->start;
+  uint32_t end_age = now - (pBlock->start + pBlock->span);
+  return start_age >= history_transfer.to_age && end_age <= history_transfer.from_age;
+}
+
+static bool HAN_historySendNext(void);
+
+static void HAN_historyDone(bool success, uint16_t segments, uint32_t bytes)
+{
+  history_transfer.segments += segments;
+
+  if(!success) {
+    history_transfer.active = false;
+    DPRINTF("History transfer failed after %u frames\n", history_transfer.segments);
+    return;
+  }
+
+  if(history_transfer.more && HAN_historySendNext()) {
+    return;
+  }
+  history_transfer.active = false;
+}
+
+// Pack the next few wanted blocks and send them off
+static bool HAN_historySendNext(void)
+{
+  timeseries_tier_t tier = history_transfer.tier;
+  uint32_t now = timeseries_now(tier);
+  size_t length = HISTORY_WIRE_TRANSFER_HEADER_SIZE;
+  uint8_t blocks = 0;
+
+  history_transfer.more = false;
+  for(uint8_t i = 0; i < timeseries_block_count(tier); i++) {
+    const timeseries_block_t* pBlock = timeseries_block(tier, i);
+    if(!HAN_historyWanted(pBlock, now)) {
+      continue;
+    }
+    if(blocks == HISTORY_BLOCKS_PER_TRANSFER) {
+      history_transfer.more = true;
+      break;
+    }
+
+    length += history_wire_put_block(&history_buffer[length], pBlock, now);
+    blocks++;
+
+    history_transfer.resume = true;
+    history_transfer.next_sequence = pBlock->sequence + 1;
+  }
+
+  history_wire_put_header(history_buffer, tier, history_transfer.more, blocks);
+
+  if(!CC_ManufacturerProprietary_send(MFG_PROPRIETARY_TYPE_HISTORY, history_transfer.sequence++,
+                                      history_buffer, length, &history_transfer.requester, 1,
+                                      HAN_historyDone)) {
+    DPRINT("History transfer could not be started\n");
+    return false;
+  }
+  return true;
+}
+
+received_frame_status_t CC_ManufacturerProprietary_request_handler(
+  RECEIVE_OPTIONS_TYPE_EX *rxOpt,
+  uint8_t type,
+  const uint8_t* pParams,
+  uint8_t length)
+{
+  if(type != MFG_PROPRIETARY_TYPE_HISTORY_GET) {
+    return RECEIVED_FRAME_STATUS_NO_SUPPORT;
+  }
+
+  // Tier and flags, oldest and newest age in seconds, and the block to resume from
+  bool resume = length >= 1 && (pParams[0] & HISTORY_GET_RESUME);
+  if(length < (resume ? 11 : 9) ||
+     (pParams[0] & HISTORY_GET_TIER_MASK) >= TIMESERIES_TIER_COUNT) {
+    return RECEIVED_FRAME_STATUS_FAIL;
+  }
+
+  // One request at a time, the segmented transfers share a single slot
+  if(history_transfer.active || CC_ManufacturerProprietary_busy()) {
+    return RECEIVED_FRAME_STATUS_FAIL;
+  }
+
+  timeseries_tier_t tier = pParams[0] & HISTORY_GET_TIER_MASK;
+  uint32_t unit_ds = timeseries_unit_ds(tier);
+  uint64_t from_age = (uint64_t)HAN_historyGetU32(&pParams[1]) * 10 / unit_ds;
+  uint64_t to_age = (uint64_t)HAN_historyGetU32(&pParams[5]) * 10 / unit_ds;
+
+  memset(&history_transfer.requester, 0, sizeof(history_transfer.requester));
+  history_transfer.requester.node.nodeId = rxOpt->sourceNode.nodeId;
+  history_transfer.requester.node.endpoint = rxOpt->sourceNode.endpoint;
+  history_transfer.requester.nodeInfo.BitMultiChannelEncap = (rxOpt->sourceNode.endpoint != 0);
+  history_transfer.requester.nodeInfo.security = rxOpt->securityKey;
+
+  history_transfer.tier = tier;
+  history_transfer.from_age = from_age > UINT32_MAX ? UINT32_MAX : (uint32_t)from_age;
+  history_transfer.to_age = to_age > UINT32_MAX ? UINT32_MAX : (uint32_t)to_age;
+  history_transfer.resume = resume;
+  history_transfer.next_sequence = resume ? (pParams[9] << 8) | pParams[10] : 0;
+  history_transfer.segments = 0;
+
+  if(!HAN_historySendNext()) {
+    return RECEIVED_FRAME_STATUS_FAIL;
+  }
+  history_transfer.active = true;
+  return RECEIVED_FRAME_STATUS_SUCCESS;
+}
+
+void CC_Meter_update_power(void)
+{
+  if(CC_ConfigurationData.bundle_reports == 1) {
+    CC_Meter_update_lifeline(ENDPOINT_ROOT, REPORT_QUEUE_SNAPSHOT, 0, (void *)CC_Meter_report_snapshot, CC_Meter_build_snapshot_report);
+  } else {
+    CC_Meter_update_lifeline(ENDPOINT_ROOT, METRIC_POWER, CC_Meter_filtered_power(), (void *)CC_Meter_report_power, CC_Meter_build_power);
+  }
+  last_reported_power_watt = active_power_watt;
+  readings_retain(HAN_retainTimestamp(), xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
+
+void CC_Meter_update_energy(void)
+{
+  CC_Meter_update_lifeline(ENDPOINT_ROOT, METRIC_ENERGY, total_meter_reading - meter_offset, (void *)CC_Meter_report_energy, CC_Meter_build_energy);
+}
+
+void CC_Meter_update_energy_export(void)
+{
+  CC_Meter_update_lifeline(ENDPOINT_ROOT, METRIC_ENERGY_EXPORT, total_export_reading - export_offset, (void *)CC_Meter_report_energy_export, CC_Meter_build_energy_export);
+}
+
+void CC_Meter_update_voltage(uint8_t phase)
+{
+  CC_Meter_update_lifeline(ENDPOINT_1 + phase - 1, METRIC_VOLTAGE_L1 + phase - 1, CC_Meter_phase_voltage(phase),
+                           (void *)CC_Meter_report_voltage, CC_Meter_build_voltage);
+}
+
+void CC_Meter_update_current(uint8_t phase)
+{
+  CC_Meter_update_lifeline(ENDPOINT_1 + phase - 1, METRIC_CURRENT_L1 + phase - 1, CC_Meter_filtered_current(phase),
+                           (void *)CC_Meter_report_current, CC_Meter_build_current);
+}
+
+void CC_Meter_update_reactive_power(void)
+{
+  CC_Meter_update_lifeline(ENDPOINT_ROOT, METRIC_REACTIVE_POWER, CC_Meter_net_reactive_power(), (void *)CC_Meter_report_reactive_power, CC_Meter_build_reactive_power);
+}
+
+void CC_Meter_update_reactive_energy(void)
+{
+  CC_Meter_update_lifeline(ENDPOINT_ROOT, METRIC_REACTIVE_ENERGY, total_reactive_import_reading, (void *)CC_Meter_report_reactive_energy, CC_Meter_build_reactive_energy);
+}
+
+void CC_Meter_update_apparent_energy(void)
+{
+  CC_Meter_update_lifeline(ENDPOINT_ROOT, METRIC_APPARENT_ENERGY, apparent_energy_total(), (void *)CC_Meter_report_apparent_energy, CC_Meter_build_apparent_energy);
+}
+
+void CC_Meter_update_energy_estimate(void)
+{
+  CC_Meter_update_lifeline(ENDPOINT_ENERGY_ESTIMATE, METRIC_ENERGY_ESTIMATE, CC_Meter_energy_estimate(), (void *)CC_Meter_report_energy_estimate, CC_Meter_build_energy_estimate);
+}
+
+// Send everything we know to the lifeline, bundled when enabled
+void CC_Meter_update_snapshot(void)
+{
+  if(CC_ConfigurationData.bundle_reports == 1) {
+    // Everything in the bundle counts as reported, so the next bundle carries
+    // the right history for each of its values
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if(list1_recv) {
+      report_policy_reported(METRIC_POWER, CC_Meter_filtered_power(), now_ms);
+    }
+    if(list3_recv) {
+      report_policy_reported(METRIC_ENERGY, total_meter_reading - meter_offset, now_ms);
+    }
+    if(list3_recv && total_export_reading != 0) {
+      report_policy_reported(METRIC_ENERGY_EXPORT, total_export_reading - export_offset, now_ms);
+    }
+    if(list2_recv) {
+      report_policy_reported(METRIC_REACTIVE_POWER, CC_Meter_net_reactive_power(), now_ms);
+    }
+
+    CC_Meter_update_lifeline(ENDPOINT_ROOT, REPORT_QUEUE_SNAPSHOT, 0, (void *)CC_Meter_report_snapshot, CC_Meter_build_snapshot_report);
+    last_reported_power_watt = active_power_watt;
+    return;
+  }
+
+  if(list1_recv) {
+    CC_Meter_update_power();
+  }
+  if(list3_recv) {
+    CC_Meter_update_energy();
+  }
+  if(list3_recv && total_export_reading != 0) {
+    CC_Meter_update_energy_export();
+  }
+}
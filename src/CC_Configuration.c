@@ -33,7 +33,13 @@
  * * Proper support of signed values
  ******************************************************************************/
 #include "CC_Configuration.h"
+#include "statistics.h"
+#include "tx_feedback.h"
 #include "ZW_TransportEndpoint.h"
+#include <AppTimer.h>
+#include <SwTimer.h>
+#include <FreeRTOS.h>
+#include <task.h>
 #define DEBUGPRINT
 #include "DebugPrint.h"
 #include <stdbool.h>
@@ -94,6 +100,9 @@ typedef struct {
 // Runtime object
 SConfigurationData CC_ConfigurationData;
 
+// NVM writes saved by coalescing configuration changes, see commit_schedule
+static uint32_t writes_avoided = 0;
+
 /**************************** CUSTOMISE HERE **********************************/
 static const param_desc_t parameter_table[] = {
     {
@@ -135,6 +144,539 @@ static const param_desc_t parameter_table[] = {
         .read_only = false,
         .is_advanced = false,
     },
+    {
+        .param_nbr = 4,
+        .param_size = sizeof(CC_ConfigurationData.bundle_reports),
+        .param = &CC_ConfigurationData.bundle_reports,
+        .name = PARAM_DESC_STR("Bundle meter reports using Multi Command"),
+        .info = PARAM_DESC_STR("Whether to send power, energy and reactive power of the root device to the lifeline group together in as few Multi Command encapsulated frames as they fit in. Voltage and current are reported by the phase endpoints on their own. Only enable when the receiving controller supports Multi Command. 0 = disabled, 1 = enabled."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(1),
+        .format = ENUMERATED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 5,
+        .param_size = sizeof(CC_ConfigurationData.power_min_interval),
+        .param = &CC_ConfigurationData.power_min_interval,
+        .name = PARAM_DESC_STR("Power report minimum interval"),
+        .info = PARAM_DESC_STR("Minimum time between two power reports to the lifeline group, in seconds. 0 = no minimum."),
+        .param_default = PARAM_VALUE_U16(0),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(3600),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 6,
+        .param_size = sizeof(CC_ConfigurationData.power_deadband_pct),
+        .param = &CC_ConfigurationData.power_deadband_pct,
+        .name = PARAM_DESC_STR("Power report change in percent"),
+        .info = PARAM_DESC_STR("Report power when it changed by more than this percentage since the last report. 0 = disabled."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(100),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 7,
+        .param_size = sizeof(CC_ConfigurationData.power_bucket_size),
+        .param = &CC_ConfigurationData.power_bucket_size,
+        .name = PARAM_DESC_STR("Power report burst size"),
+        .info = PARAM_DESC_STR("Amount of change-triggered power reports allowed in a burst before rate limiting kicks in. 0 = no rate limit."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(255),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 8,
+        .param_size = sizeof(CC_ConfigurationData.power_refill_interval),
+        .param = &CC_ConfigurationData.power_refill_interval,
+        .name = PARAM_DESC_STR("Power report rate limit interval"),
+        .info = PARAM_DESC_STR("Time it takes to earn back one power report after a burst, in seconds."),
+        .param_default = PARAM_VALUE_U16(60),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(3600),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 9,
+        .param_size = sizeof(CC_ConfigurationData.energy_min_interval),
+        .param = &CC_ConfigurationData.energy_min_interval,
+        .name = PARAM_DESC_STR("Energy report minimum interval"),
+        .info = PARAM_DESC_STR("Minimum time between two energy reports to the lifeline group, in seconds. 0 = no minimum."),
+        .param_default = PARAM_VALUE_U16(0),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(65535),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 10,
+        .param_size = sizeof(CC_ConfigurationData.energy_deadband_abs),
+        .param = &CC_ConfigurationData.energy_deadband_abs,
+        .name = PARAM_DESC_STR("Energy report change"),
+        .info = PARAM_DESC_STR("Report energy when it changed by more than this amount (Wh) since the last report. 0 = disabled."),
+        .param_default = PARAM_VALUE_U16(0),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(65535),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 11,
+        .param_size = sizeof(CC_ConfigurationData.energy_deadband_pct),
+        .param = &CC_ConfigurationData.energy_deadband_pct,
+        .name = PARAM_DESC_STR("Energy report change in percent"),
+        .info = PARAM_DESC_STR("Report energy when it changed by more than this percentage since the last report. 0 = disabled."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(100),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 12,
+        .param_size = sizeof(CC_ConfigurationData.energy_bucket_size),
+        .param = &CC_ConfigurationData.energy_bucket_size,
+        .name = PARAM_DESC_STR("Energy report burst size"),
+        .info = PARAM_DESC_STR("Amount of change-triggered energy reports allowed in a burst before rate limiting kicks in. 0 = no rate limit."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(255),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 13,
+        .param_size = sizeof(CC_ConfigurationData.energy_refill_interval),
+        .param = &CC_ConfigurationData.energy_refill_interval,
+        .name = PARAM_DESC_STR("Energy report rate limit interval"),
+        .info = PARAM_DESC_STR("Time it takes to earn back one energy report after a burst, in seconds."),
+        .param_default = PARAM_VALUE_U16(3600),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(65535),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 14,
+        .param_size = sizeof(CC_ConfigurationData.energy_heartbeat),
+        .param = &CC_ConfigurationData.energy_heartbeat,
+        .name = PARAM_DESC_STR("Energy report heartbeat"),
+        .info = PARAM_DESC_STR("Report energy at least this often, even when it did not change, in seconds. 0 = disabled. Parameter 3 also reports energy on every hourly reading."),
+        .param_default = PARAM_VALUE_U16(0),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(65535),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 15,
+        .param_size = sizeof(CC_ConfigurationData.voltage_min_interval),
+        .param = &CC_ConfigurationData.voltage_min_interval,
+        .name = PARAM_DESC_STR("Voltage report minimum interval"),
+        .info = PARAM_DESC_STR("Minimum time between two voltage reports to the lifeline group, in seconds. 0 = no minimum."),
+        .param_default = PARAM_VALUE_U16(0),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(65535),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 16,
+        .param_size = sizeof(CC_ConfigurationData.voltage_deadband_abs),
+        .param = &CC_ConfigurationData.voltage_deadband_abs,
+        .name = PARAM_DESC_STR("Voltage report change"),
+        .info = PARAM_DESC_STR("Report voltage when it changed by more than this amount (V) since the last report. 0 = disabled."),
+        .param_default = PARAM_VALUE_U16(0),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(65535),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 17,
+        .param_size = sizeof(CC_ConfigurationData.voltage_deadband_pct),
+        .param = &CC_ConfigurationData.voltage_deadband_pct,
+        .name = PARAM_DESC_STR("Voltage report change in percent"),
+        .info = PARAM_DESC_STR("Report voltage when it changed by more than this percentage since the last report. 0 = disabled."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(100),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 18,
+        .param_size = sizeof(CC_ConfigurationData.voltage_bucket_size),
+        .param = &CC_ConfigurationData.voltage_bucket_size,
+        .name = PARAM_DESC_STR("Voltage report burst size"),
+        .info = PARAM_DESC_STR("Amount of change-triggered voltage reports allowed in a burst before rate limiting kicks in. 0 = no rate limit."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(255),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 19,
+        .param_size = sizeof(CC_ConfigurationData.voltage_refill_interval),
+        .param = &CC_ConfigurationData.voltage_refill_interval,
+        .name = PARAM_DESC_STR("Voltage report rate limit interval"),
+        .info = PARAM_DESC_STR("Time it takes to earn back one voltage report after a burst, in seconds."),
+        .param_default = PARAM_VALUE_U16(60),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(65535),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 20,
+        .param_size = sizeof(CC_ConfigurationData.voltage_heartbeat),
+        .param = &CC_ConfigurationData.voltage_heartbeat,
+        .name = PARAM_DESC_STR("Voltage report heartbeat"),
+        .info = PARAM_DESC_STR("Report voltage at least this often, even when it did not change, in seconds. 0 = disabled."),
+        .param_default = PARAM_VALUE_U16(0),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(65535),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 21,
+        .param_size = sizeof(CC_ConfigurationData.current_min_interval),
+        .param = &CC_ConfigurationData.current_min_interval,
+        .name = PARAM_DESC_STR("Current report minimum interval"),
+        .info = PARAM_DESC_STR("Minimum time between two current reports to the lifeline group, in seconds. 0 = no minimum."),
+        .param_default = PARAM_VALUE_U16(0),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(65535),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 22,
+        .param_size = sizeof(CC_ConfigurationData.current_deadband_abs),
+        .param = &CC_ConfigurationData.current_deadband_abs,
+        .name = PARAM_DESC_STR("Current report change"),
+        .info = PARAM_DESC_STR("Report current when it changed by more than this amount (mA) since the last report. 0 = disabled."),
+        .param_default = PARAM_VALUE_U16(0),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(65535),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 23,
+        .param_size = sizeof(CC_ConfigurationData.current_deadband_pct),
+        .param = &CC_ConfigurationData.current_deadband_pct,
+        .name = PARAM_DESC_STR("Current report change in percent"),
+        .info = PARAM_DESC_STR("Report current when it changed by more than this percentage since the last report. 0 = disabled."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(100),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 24,
+        .param_size = sizeof(CC_ConfigurationData.current_bucket_size),
+        .param = &CC_ConfigurationData.current_bucket_size,
+        .name = PARAM_DESC_STR("Current report burst size"),
+        .info = PARAM_DESC_STR("Amount of change-triggered current reports allowed in a burst before rate limiting kicks in. 0 = no rate limit."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(255),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 25,
+        .param_size = sizeof(CC_ConfigurationData.current_refill_interval),
+        .param = &CC_ConfigurationData.current_refill_interval,
+        .name = PARAM_DESC_STR("Current report rate limit interval"),
+        .info = PARAM_DESC_STR("Time it takes to earn back one current report after a burst, in seconds."),
+        .param_default = PARAM_VALUE_U16(60),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(65535),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 26,
+        .param_size = sizeof(CC_ConfigurationData.current_heartbeat),
+        .param = &CC_ConfigurationData.current_heartbeat,
+        .name = PARAM_DESC_STR("Current report heartbeat"),
+        .info = PARAM_DESC_STR("Report current at least this often, even when it did not change, in seconds. 0 = disabled."),
+        .param_default = PARAM_VALUE_U16(0),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(65535),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 27,
+        .param_size = sizeof(CC_ConfigurationData.energy_estimate_interval),
+        .param = &CC_ConfigurationData.energy_estimate_interval,
+        .name = PARAM_DESC_STR("Estimated energy report interval"),
+        .info = PARAM_DESC_STR("How often to report the estimated accumulated energy in between the hourly meter readings, in seconds. The estimate is reported in kWh by endpoint 4, and can be lower than the estimate before it once the meter reading comes in. 0 = disabled."),
+        .param_default = PARAM_VALUE_U16(0),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(3600),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = false,
+    },
+    {
+        .param_nbr = 28,
+        .param_size = sizeof(CC_ConfigurationData.statistics_window),
+        .param = &CC_ConfigurationData.statistics_window,
+        .name = PARAM_DESC_STR("Statistics window"),
+        .info = PARAM_DESC_STR("Time window the statistics in parameters 30-34 cover. They describe the last completed window. 0 = 1 minute, 1 = 15 minutes, 2 = 1 hour."),
+        .param_default = PARAM_VALUE_U8(1),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(2),
+        .format = ENUMERATED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 29,
+        .param_size = sizeof(CC_ConfigurationData.statistics_metric),
+        .param = &CC_ConfigurationData.statistics_metric,
+        .name = PARAM_DESC_STR("Statistics reading"),
+        .info = PARAM_DESC_STR("Reading the statistics in parameters 30-34 cover. 0 = power (W), 1-3 = voltage phase 1-3 (V), 4-6 = current phase 1-3 (mA)."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(6),
+        .format = ENUMERATED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 30,
+        .param_size = sizeof(statistics_report.count),
+        .param = &statistics_report.count,
+        .name = PARAM_DESC_STR("Statistics: amount of readings"),
+        .info = PARAM_DESC_STR("Amount of readings in the last completed statistics window."),
+        .param_default = PARAM_VALUE_U32(0),
+        .param_min = PARAM_VALUE_U32(0),
+        .param_max = PARAM_VALUE_U32(UINT32_MAX),
+        .format = UNSIGNED,
+        .read_only = true,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 31,
+        .param_size = sizeof(statistics_report.min),
+        .param = &statistics_report.min,
+        .name = PARAM_DESC_STR("Statistics: minimum"),
+        .info = PARAM_DESC_STR("Lowest reading in the last completed statistics window."),
+        .param_default = PARAM_VALUE_I32(0),
+        .param_min = PARAM_VALUE_I32(INT32_MIN),
+        .param_max = PARAM_VALUE_I32(INT32_MAX),
+        .format = SIGNED,
+        .read_only = true,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 32,
+        .param_size = sizeof(statistics_report.mean),
+        .param = &statistics_report.mean,
+        .name = PARAM_DESC_STR("Statistics: mean"),
+        .info = PARAM_DESC_STR("Average of the readings in the last completed statistics window."),
+        .param_default = PARAM_VALUE_I32(0),
+        .param_min = PARAM_VALUE_I32(INT32_MIN),
+        .param_max = PARAM_VALUE_I32(INT32_MAX),
+        .format = SIGNED,
+        .read_only = true,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 33,
+        .param_size = sizeof(statistics_report.max),
+        .param = &statistics_report.max,
+        .name = PARAM_DESC_STR("Statistics: maximum"),
+        .info = PARAM_DESC_STR("Highest reading in the last completed statistics window."),
+        .param_default = PARAM_VALUE_I32(0),
+        .param_min = PARAM_VALUE_I32(INT32_MIN),
+        .param_max = PARAM_VALUE_I32(INT32_MAX),
+        .format = SIGNED,
+        .read_only = true,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 34,
+        .param_size = sizeof(statistics_report.p95),
+        .param = &statistics_report.p95,
+        .name = PARAM_DESC_STR("Statistics: 95th percentile"),
+        .info = PARAM_DESC_STR("Estimated 95th percentile of the readings in the last completed statistics window."),
+        .param_default = PARAM_VALUE_I32(0),
+        .param_min = PARAM_VALUE_I32(INT32_MIN),
+        .param_max = PARAM_VALUE_I32(INT32_MAX),
+        .format = SIGNED,
+        .read_only = true,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 35,
+        .param_size = sizeof(tx_feedback_backoff_level),
+        .param = &tx_feedback_backoff_level,
+        .name = PARAM_DESC_STR("Reporting backoff level"),
+        .info = PARAM_DESC_STR("How far unsolicited reporting is slowed down because reports fail to get through. 0 = full rate, each level doubles the reporting intervals."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(TX_FEEDBACK_MAX_LEVEL),
+        .format = UNSIGNED,
+        .read_only = true,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 36,
+        .param_size = sizeof(CC_ConfigurationData.stream_no_route),
+        .param = &CC_ConfigurationData.stream_no_route,
+        .name = PARAM_DESC_STR("Power stream without routing"),
+        .info = PARAM_DESC_STR("Send the power readings to association group 2 on direct range only, skipping routing retries. 0 = off, 1 = on."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(1),
+        .format = ENUMERATED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 37,
+        .param_size = sizeof(CC_ConfigurationData.han_tunnel),
+        .param = &CC_ConfigurationData.han_tunnel,
+        .name = PARAM_DESC_STR("Forward raw HAN frames"),
+        .info = PARAM_DESC_STR("Forward every HDLC frame from the meter as-is to association group 3, for decoding by the controller. 0 = off, 1 = on."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(1),
+        .format = ENUMERATED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 38,
+        .param_size = sizeof(CC_ConfigurationData.han_tunnel_interval),
+        .param = &CC_ConfigurationData.han_tunnel_interval,
+        .name = PARAM_DESC_STR("Raw HAN frame interval"),
+        .info = PARAM_DESC_STR("Minimum time in seconds between forwarded HAN frames. Frames arriving sooner are dropped. 0 = forward all frames."),
+        .param_default = PARAM_VALUE_U16(10),
+        .param_min = PARAM_VALUE_U16(0),
+        .param_max = PARAM_VALUE_U16(3600),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 39,
+        .param_size = sizeof(CC_ConfigurationData.han_tunnel_dedupe),
+        .param = &CC_ConfigurationData.han_tunnel_dedupe,
+        .name = PARAM_DESC_STR("Raw HAN frame duplicate suppression"),
+        .info = PARAM_DESC_STR("Don't forward a HAN frame identical to the one forwarded before it. 0 = off, 1 = on."),
+        .param_default = PARAM_VALUE_U8(1),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(1),
+        .format = ENUMERATED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 40,
+        .param_size = sizeof(CC_ConfigurationData.filter_median_size),
+        .param = &CC_ConfigurationData.filter_median_size,
+        .name = PARAM_DESC_STR("Median filter length"),
+        .info = PARAM_DESC_STR("Power and current reports are decided on the median of this many readings, which drops short spikes. Even values are rounded up. 1 = off."),
+        .param_default = PARAM_VALUE_U8(1),
+        .param_min = PARAM_VALUE_U8(1),
+        .param_max = PARAM_VALUE_U8(7),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 41,
+        .param_size = sizeof(CC_ConfigurationData.filter_ewma_shift),
+        .param = &CC_ConfigurationData.filter_ewma_shift,
+        .name = PARAM_DESC_STR("Smoothing filter strength"),
+        .info = PARAM_DESC_STR("Power and current reports are decided on a moving average where each new reading weighs 1/2^n. 0 = off."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(6),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 42,
+        .param_size = sizeof(CC_ConfigurationData.filter_hysteresis_pct),
+        .param = &CC_ConfigurationData.filter_hysteresis_pct,
+        .name = PARAM_DESC_STR("Filter hysteresis"),
+        .info = PARAM_DESC_STR("The filtered power and current only move once the reading is more than this percentage away from them. 0 = off."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(50),
+        .format = UNSIGNED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 43,
+        .param_size = sizeof(CC_ConfigurationData.backlog_nvm_spill),
+        .param = &CC_ConfigurationData.backlog_nvm_spill,
+        .name = PARAM_DESC_STR("Keep undelivered reports on power loss"),
+        .info = PARAM_DESC_STR("Write reports which are waiting to be replayed to flash when power is lost, at the cost of a longer emergency save. 0 = off, 1 = on."),
+        .param_default = PARAM_VALUE_U8(0),
+        .param_min = PARAM_VALUE_U8(0),
+        .param_max = PARAM_VALUE_U8(1),
+        .format = ENUMERATED,
+        .read_only = false,
+        .is_advanced = true,
+    },
+    {
+        .param_nbr = 44,
+        .param_size = sizeof(writes_avoided),
+        .param = &writes_avoided,
+        .name = PARAM_DESC_STR("Configuration writes avoided"),
+        .info = PARAM_DESC_STR("How many flash writes were saved since startup by writing configuration changes made in quick succession out together."),
+        .param_default = PARAM_VALUE_U32(0),
+        .param_min = PARAM_VALUE_U32(0),
+        .param_max = PARAM_VALUE_U32(UINT32_MAX),
+        .format = UNSIGNED,
+        .read_only = true,
+        .is_advanced = true,
+    },
 };
 /*************************** END CUSTOMISATION ********************************/
 
@@ -539,6 +1081,65 @@ void CC_Configuration_saveToNVM( nvm3_Handle_t* pFileSystemApplication )
   ASSERT(ECODE_NVM3_OK == errCode);
 }
 
+/*******************************************************************************
+ * Coalesced commit of configuration changes.
+ *
+ * Controllers tend to push the full parameter set right after inclusion, one
+ * Set at a time. Instead of writing the whole configuration object for each of
+ * them, changes are kept in RAM and committed once no new change has come in
+ * for CONFIGURATION_COMMIT_WINDOW_MS. To bound the time a change can sit in
+ * RAM, a commit is forced after CONFIGURATION_COMMIT_MAX_DELAY_MS regardless.
+ ******************************************************************************/
+#define CONFIGURATION_COMMIT_WINDOW_MS    2000
+#define CONFIGURATION_COMMIT_MAX_DELAY_MS 10000
+
+static SSwTimer commit_timer;
+static bool commit_timer_registered = false;
+static bool commit_pending = false;
+static TickType_t commit_pending_since;
+
+static void commit_timer_cb( SSwTimer* pTimer )
+{
+  (void)pTimer;
+  CC_Configuration_flush();
+}
+
+static void commit_schedule( void )
+{
+  if( !commit_timer_registered ) {
+    AppTimerRegister(&commit_timer, false, commit_timer_cb);
+    commit_timer_registered = true;
+  }
+
+  TickType_t now = xTaskGetTickCount();
+
+  if( commit_pending ) {
+    // This change gets folded into the write that was already pending
+    writes_avoided++;
+
+    if( (now - commit_pending_since) >= pdMS_TO_TICKS(CONFIGURATION_COMMIT_MAX_DELAY_MS) ) {
+      CC_Configuration_flush();
+      return;
+    }
+  } else {
+    commit_pending = true;
+    commit_pending_since = now;
+  }
+
+  TimerStart(&commit_timer, CONFIGURATION_COMMIT_WINDOW_MS);
+}
+
+// Write out pending configuration changes immediately
+void CC_Configuration_flush( void )
+{
+  if( !commit_pending )
+    return;
+
+  TimerStop(&commit_timer);
+  commit_pending = false;
+  CC_Configuration_saveToNVM(NULL);
+}
+
 // Reset all configuration parameters to their default values
 void CC_Configuration_resetToDefault( nvm3_Handle_t* pFileSystemApplication )
 {
@@ -547,6 +1148,12 @@ void CC_Configuration_resetToDefault( nvm3_Handle_t* pFileSystemApplication )
   else
     pFileSystemApplication = lastLoadedFilesystem;
 
+  // The defaults get written out below, any pending change is moot
+  if( commit_pending ) {
+    TimerStop(&commit_timer);
+    commit_pending = false;
+  }
+
   // Scroll through parameter table to load default values into struct
   for( size_t i = 0;
        i < sizeof(parameter_table) / sizeof(parameter_table[0]);
@@ -715,8 +1322,8 @@ received_frame_status_t handleCommandClassConfiguration(
             return RECEIVED_FRAME_STATUS_FAIL;
         }
 
-        // Write out application data
-        CC_Configuration_saveToNVM(NULL);
+        // Write out application data once the controller is done setting
+        commit_schedule();
 
         return RECEIVED_FRAME_STATUS_SUCCESS;
       }
@@ -1107,8 +1714,8 @@ received_frame_status_t handleCommandClassConfiguration(
           }
         }
 
-        // Save updated parameters
-        CC_Configuration_saveToNVM( NULL );
+        // Save updated parameters once the controller is done setting
+        commit_schedule();
 
         // Only send a report when handshake is set
         if( handshake ) {
@@ -42,6 +42,42 @@ typedef struct {
   uint8_t amount_of_10s_reports_for_meter_report;
   uint8_t power_change_for_meter_report;
   uint8_t enable_hourly_report;
+  uint8_t bundle_reports;
+  // Reporting policy per metric class, see report_policy.h
+  uint16_t power_min_interval;
+  uint8_t power_deadband_pct;
+  uint8_t power_bucket_size;
+  uint16_t power_refill_interval;
+  uint16_t energy_min_interval;
+  uint16_t energy_deadband_abs;
+  uint8_t energy_deadband_pct;
+  uint8_t energy_bucket_size;
+  uint16_t energy_refill_interval;
+  uint16_t energy_heartbeat;
+  uint16_t voltage_min_interval;
+  uint16_t voltage_deadband_abs;
+  uint8_t voltage_deadband_pct;
+  uint8_t voltage_bucket_size;
+  uint16_t voltage_refill_interval;
+  uint16_t voltage_heartbeat;
+  uint16_t current_min_interval;
+  uint16_t current_deadband_abs;
+  uint8_t current_deadband_pct;
+  uint8_t current_bucket_size;
+  uint16_t current_refill_interval;
+  uint16_t current_heartbeat;
+  uint16_t energy_estimate_interval;
+  uint8_t statistics_window;
+  uint8_t statistics_metric;
+  uint8_t stream_no_route;
+  uint8_t han_tunnel;
+  uint16_t han_tunnel_interval;
+  uint8_t han_tunnel_dedupe;
+  // Filters ahead of the report decisions, see signal_filter.h
+  uint8_t filter_median_size;
+  uint8_t filter_ewma_shift;
+  uint8_t filter_hysteresis_pct;
+  uint8_t backlog_nvm_spill;
 } SConfigurationData;
 
 // To declare your configuration parameter properties, edit CC_Configuration.c
@@ -58,6 +94,10 @@ void CC_Configuration_loadFromNVM( nvm3_Handle_t* pFileSystemApplication );
 // Save all configuration parameters to storage
 void CC_Configuration_saveToNVM( nvm3_Handle_t* pFileSystemApplication );
 
+// Write out configuration changes which are still waiting in RAM for their
+// commit window to close. Call this before resetting or losing power.
+void CC_Configuration_flush( void );
+
 // Reset all configuration parameters to their default values
 void CC_Configuration_resetToDefault( nvm3_Handle_t* pFileSystemApplication );
 
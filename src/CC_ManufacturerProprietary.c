@@ -0,0 +1,229 @@
+/***************************************************************************//**
+ * @file CC_ManufacturerProprietary.c
+ * @brief This file contains segmented transfers over Manufacturer
+ *        Proprietary CC.
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#include "CC_ManufacturerProprietary.h"
+#include "config_app.h"
+#include "ZW_TransportEndpoint.h"
+#include <ZW_classcmd.h>
+#define DEBUGPRINT
+#include "DebugPrint.h"
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*******************************************************************************
+ * Callback logic for only queueing one segment of a transfer at a time, like
+ * the string and bulk reports in CC_Configuration.c
+ ******************************************************************************/
+typedef struct {
+  bool in_progress;
+  bool success;
+  uint8_t type;
+  uint8_t sequence;
+  uint8_t segment;
+  const uint8_t* pData;
+  size_t length;
+  size_t offset;
+  destination_info_t destinations[MAX_ASSOCIATION_IN_GROUP];
+  uint8_t num_destinations;
+  uint8_t destination;
+  uint16_t segments_sent;
+  uint32_t bytes_sent;
+  mfg_proprietary_done_t done;
+} segmented_transfer_t;
+
+static segmented_transfer_t transfer = {
+  .in_progress = false,
+};
+
+static void segment_progress_cb( uint8_t status );
+
+static void transfer_finish( void )
+{
+  transfer.in_progress = false;
+  if( transfer.done != NULL ) {
+    transfer.done(transfer.success, transfer.segments_sent, transfer.bytes_sent);
+  }
+}
+
+// Build and queue the next segment of the transfer in progress
+static bool segment_send_next( void )
+{
+  ZAF_TRANSPORT_TX_BUFFER  TxBuf;
+  ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
+  memset((uint8_t*)pTxBuf, 0, sizeof(ZW_APPLICATION_TX_BUFFER) );
+  uint8_t* pFrame = (uint8_t*)pTxBuf;
+  uint8_t length = 0;
+
+  size_t remaining = transfer.length - transfer.offset;
+  size_t chunk = remaining > MFG_PROPRIETARY_SEGMENT_DATA ? MFG_PROPRIETARY_SEGMENT_DATA : remaining;
+  bool last = (chunk == remaining);
+
+  pFrame[length++] = COMMAND_CLASS_MANUFACTURER_PROPRIETARY;
+  pFrame[length++] = (APP_MANUFACTURER_ID >> 8) & 0xFF;
+  pFrame[length++] = APP_MANUFACTURER_ID & 0xFF;
+  pFrame[length++] = transfer.type;
+  pFrame[length++] = transfer.sequence;
+  pFrame[length++] = transfer.segment | (last ? MFG_PROPRIETARY_LAST_SEGMENT : 0);
+  memcpy(&pFrame[length], &transfer.pData[transfer.offset], chunk);
+  length += chunk;
+
+  TRANSMIT_OPTIONS_TYPE_SINGLE_EX txOptions;
+  memset((uint8_t*)&txOptions, 0, sizeof(txOptions));
+  txOptions.txOptions = ZWAVE_PLUS_TX_OPTIONS;
+  txOptions.sourceEndpoint = 0;
+  txOptions.pDestNode = &transfer.destinations[transfer.destination];
+
+  if( EQUEUENOTIFYING_STATUS_SUCCESS != Transport_SendRequestEP(
+        pFrame,
+        length,
+        &txOptions,
+        segment_progress_cb) )
+  {
+    // Failed to queue the packet somehow, meaning we won't get a
+    // new callback. Give up on this transmission.
+    DPRINTF("Failed Tx of segment %d\n", transfer.segment);
+    return false;
+  }
+
+  transfer.segments_sent++;
+  transfer.bytes_sent += length;
+  transfer.offset += chunk;
+  transfer.segment++;
+  return true;
+}
+
+// Start over from the first segment for the next destination. Returns false
+// when there are no destinations left.
+static bool next_destination( void )
+{
+  transfer.destination++;
+  transfer.offset = 0;
+  transfer.segment = 0;
+  return transfer.destination < transfer.num_destinations;
+}
+
+static void segment_progress_cb( uint8_t status )
+{
+  if( !transfer.in_progress ) {
+    return;
+  }
+
+  // A lost segment spoils the transfer to this destination, skip to the next
+  bool destination_done = (transfer.offset >= transfer.length);
+  if( TRANSMIT_COMPLETE_OK != status ) {
+    transfer.success = false;
+    destination_done = true;
+  }
+
+  if( destination_done && !next_destination() ) {
+    transfer_finish();
+    return;
+  }
+
+  while( !segment_send_next() ) {
+    transfer.success = false;
+    if( !next_destination() ) {
+      transfer_finish();
+      return;
+    }
+  }
+}
+
+bool CC_ManufacturerProprietary_send( uint8_t type,
+                                      uint8_t sequence,
+                                      const uint8_t* pData,
+                                      size_t length,
+                                      const destination_info_t* pDestinations,
+                                      uint8_t num_destinations,
+                                      mfg_proprietary_done_t done )
+{
+  if( transfer.in_progress || num_destinations == 0 || length == 0 ||
+      length > (size_t)MFG_PROPRIETARY_MAX_SEGMENTS * MFG_PROPRIETARY_SEGMENT_DATA ) {
+    return false;
+  }
+
+  if( num_destinations > MAX_ASSOCIATION_IN_GROUP ) {
+    num_destinations = MAX_ASSOCIATION_IN_GROUP;
+  }
+
+  transfer.success = true;
+  transfer.type = type;
+  transfer.sequence = sequence;
+  transfer.segment = 0;
+  transfer.pData = pData;
+  transfer.length = length;
+  transfer.offset = 0;
+  memcpy(transfer.destinations, pDestinations, num_destinations * sizeof(destination_info_t));
+  transfer.num_destinations = num_destinations;
+  transfer.destination = 0;
+  transfer.segments_sent = 0;
+  transfer.bytes_sent = 0;
+  transfer.done = done;
+
+  if( !segment_send_next() ) {
+    return false;
+  }
+  transfer.in_progress = true;
+  return true;
+}
+
+bool CC_ManufacturerProprietary_busy( void )
+{
+  return transfer.in_progress;
+}
+
+received_frame_status_t handleCommandClassManufacturerProprietary(
+  RECEIVE_OPTIONS_TYPE_EX *rxOpt,
+  ZW_APPLICATION_TX_BUFFER *pCmd,
+  uint8_t cmdLength )
+{
+  const uint8_t* pFrame = (const uint8_t*)pCmd;
+
+  // Someone else's proprietary commands are none of our business
+  if( cmdLength < 4 ||
+      pFrame[1] != ((APP_MANUFACTURER_ID >> 8) & 0xFF) ||
+      pFrame[2] != (APP_MANUFACTURER_ID & 0xFF) ) {
+    return RECEIVED_FRAME_STATUS_NO_SUPPORT;
+  }
+
+  if( true == Check_not_legal_response_job(rxOpt) ) {
+    return RECEIVED_FRAME_STATUS_FAIL;
+  }
+
+  return CC_ManufacturerProprietary_request_handler(rxOpt, pFrame[3], &pFrame[4], cmdLength - 4);
+}
+
+REGISTER_CC(COMMAND_CLASS_MANUFACTURER_PROPRIETARY, 1, handleCommandClassManufacturerProprietary);
+
+#ifdef __cplusplus
+}
+#endif
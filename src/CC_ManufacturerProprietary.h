@@ -0,0 +1,101 @@
+/***************************************************************************//**
+ * @file CC_ManufacturerProprietary.h
+ * @brief This file describes the segmented Manufacturer Proprietary transfer interface
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+#ifndef CC_MANUFACTURERPROPRIETARY_H_
+#define CC_MANUFACTURERPROPRIETARY_H_
+
+#include "ZAF_types.h"
+#include <association_plus.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Anything too large for a single frame goes out as a series of Manufacturer
+ * Proprietary commands, each carrying:
+ *   - Manufacturer ID (2 bytes)
+ *   - Payload type
+ *   - Transfer sequence number, the same for all segments of one transfer
+ *   - Segment index (bits 0-6), with bit 7 set on the last segment
+ *   - Up to MFG_PROPRIETARY_SEGMENT_DATA bytes of the payload
+ */
+#define MFG_PROPRIETARY_TYPE_HAN_FRAME 0x01
+#define MFG_PROPRIETARY_TYPE_HISTORY    0x03
+
+/*
+ * Requests come in as a single Manufacturer Proprietary command:
+ *   - Manufacturer ID (2 bytes)
+ *   - Request type
+ *   - Request parameters
+ */
+#define MFG_PROPRIETARY_TYPE_HISTORY_GET 0x02
+
+#define MFG_PROPRIETARY_LAST_SEGMENT 0x80
+#define MFG_PROPRIETARY_HEADER_SIZE 6
+#define MFG_PROPRIETARY_SEGMENT_DATA (39 - MFG_PROPRIETARY_HEADER_SIZE)
+#define MFG_PROPRIETARY_MAX_SEGMENTS 0x80
+
+// Called when a transfer is over. 'success' is true when every destination
+// acknowledged every segment; 'segments' and 'bytes' count what went out.
+typedef void (*mfg_proprietary_done_t)( bool success, uint16_t segments, uint32_t bytes );
+
+// Start sending 'length' bytes from 'pData' to each of the destinations in
+// turn. The data has to stay put until 'done' is called. Returns false if
+// another transfer is in progress, or the first segment could not be queued.
+bool CC_ManufacturerProprietary_send( uint8_t type,
+                                      uint8_t sequence,
+                                      const uint8_t* pData,
+                                      size_t length,
+                                      const destination_info_t* pDestinations,
+                                      uint8_t num_destinations,
+                                      mfg_proprietary_done_t done );
+
+bool CC_ManufacturerProprietary_busy( void );
+
+// Handle a request of 'type' carrying 'length' bytes of parameters. Implemented
+// by the application.
+received_frame_status_t CC_ManufacturerProprietary_request_handler(
+  RECEIVE_OPTIONS_TYPE_EX *rxOpt,
+  uint8_t type,
+  const uint8_t* pParams,
+  uint8_t length );
+
+// Command handler to attach in \ref Transport_ApplicationCommandHandlerEx
+received_frame_status_t handleCommandClassManufacturerProprietary(
+  RECEIVE_OPTIONS_TYPE_EX *rxOpt,
+  ZW_APPLICATION_TX_BUFFER *pCmd,
+  uint8_t cmdLength );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CC_MANUFACTURERPROPRIETARY_H_ */
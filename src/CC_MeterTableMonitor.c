@@ -0,0 +1,543 @@
+/***************************************************************************//**
+ * @file CC_MeterTableMonitor.c
+ * @brief This file contains the hourly meter reading history and
+ *        Meter Table Monitor CC implementation.
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include "CC_MeterTableMonitor.h"
+#include "readings.h"
+#include "ZW_TransportEndpoint.h"
+#include <ZW_classcmd.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#define DEBUGPRINT
+#include "DebugPrint.h"
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Datasets of an electric meter table which we can serve
+#define DATASET_ACCUMULATED_KWH (1UL << 0)
+#define DATASET_INSTANT_W       (1UL << 1)
+#define DATASET_VOLTAGE         (1UL << 2)
+#define DATASET_CURRENT         (1UL << 3)
+
+#define DATASET_SUPPORTED (DATASET_ACCUMULATED_KWH | DATASET_INSTANT_W | \
+                           DATASET_VOLTAGE | DATASET_CURRENT)
+#define DATASET_HISTORY_SUPPORTED (DATASET_ACCUMULATED_KWH)
+
+#define METER_TYPE_ELECTRIC 0x01
+#define RATE_TYPE_IMPORT 0x01
+#define PAY_METER_CREDITMETER 0x01
+
+// Same as for the configuration parameter strings and bulk reports
+static const size_t max_bytes_per_report = 39;
+
+// Data reports: command class, command, reports to follow, properties,
+// dataset (3), year (2), month, day, hour, minute, second
+#define DATA_REPORT_HEADER_SIZE 14
+// Per value: precision/scale, 4-byte value
+#define DATA_REPORT_VALUE_SIZE 5
+
+/*******************************************************************************
+ * Wall clock and hourly history
+ ******************************************************************************/
+static bool clock_valid = false;
+static uint64_t clock_meter_time;
+static uint32_t clock_set_ms;
+
+typedef struct {
+  uint32_t time;        // seconds since 1970, 0 when the clock wasn't known
+  uint32_t reading_wh;
+} history_entry_t;
+
+static history_entry_t history[METER_TABLE_HISTORY_DEPTH];
+static uint8_t history_head = 0;   // slot the next entry goes into
+static uint8_t history_count = 0;
+
+void CC_MeterTableMonitor_setTime( uint64_t meter_time, uint32_t now_ms )
+{
+  clock_meter_time = meter_time;
+  clock_set_ms = now_ms;
+  clock_valid = true;
+}
+
+static uint32_t wall_clock( uint32_t now_ms )
+{
+  if( !clock_valid ) {
+    return 0;
+  }
+  return (uint32_t)(clock_meter_time + (now_ms - clock_set_ms) / 1000);
+}
+
+void CC_MeterTableMonitor_addHistory( uint32_t reading_wh, uint32_t now_ms )
+{
+  history[history_head].time = wall_clock(now_ms);
+  history[history_head].reading_wh = reading_wh;
+  history_head = (history_head + 1) % METER_TABLE_HISTORY_DEPTH;
+  if( history_count < METER_TABLE_HISTORY_DEPTH ) {
+    history_count++;
+  }
+}
+
+void CC_MeterTableMonitor_resetHistory( void )
+{
+  history_head = 0;
+  history_count = 0;
+}
+
+// Oldest entry is index 0
+static const history_entry_t* history_at( uint8_t index )
+{
+  uint8_t oldest = (history_head + METER_TABLE_HISTORY_DEPTH - history_count) % METER_TABLE_HISTORY_DEPTH;
+  return &history[(oldest + index) % METER_TABLE_HISTORY_DEPTH];
+}
+
+/* Conversion between seconds since 1970 and a calendar date, after Howard
+ * Hinnant's days_from_civil / civil_from_days. */
+static int32_t days_from_civil( int32_t y, uint32_t m, uint32_t d )
+{
+  y -= m <= 2;
+  int32_t era = (y >= 0 ? y : y - 399) / 400;
+  uint32_t yoe = (uint32_t)(y - era * 400);
+  uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+static void encode_time( uint8_t* pBuf, uint32_t time )
+{
+  if( time == 0 ) {
+    // Unknown, leave all zero
+    memset(pBuf, 0, 7);
+    return;
+  }
+
+  int32_t z = (int32_t)(time / 86400) + 719468;
+  uint32_t seconds_of_day = time % 86400;
+  int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+  uint32_t doe = (uint32_t)(z - era * 146097);
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  uint32_t day = doy - (153 * mp + 2) / 5 + 1;
+  uint32_t month = mp < 10 ? mp + 3 : mp - 9;
+  uint32_t year = (uint32_t)((int32_t)yoe + era * 400) + (month <= 2);
+
+  pBuf[0] = (year >> 8) & 0xFF;
+  pBuf[1] = year & 0xFF;
+  pBuf[2] = month;
+  pBuf[3] = day;
+  pBuf[4] = seconds_of_day / 3600;
+  pBuf[5] = (seconds_of_day / 60) % 60;
+  pBuf[6] = seconds_of_day % 60;
+}
+
+static uint32_t decode_time( const uint8_t* pBuf )
+{
+  uint32_t year = ((uint32_t)pBuf[0] << 8) | pBuf[1];
+  if( year < 1970 || pBuf[2] < 1 || pBuf[2] > 12 || pBuf[3] < 1 || pBuf[3] > 31 ) {
+    return 0;
+  }
+  int32_t days = days_from_civil(year, pBuf[2], pBuf[3]);
+  return (uint32_t)days * 86400 + pBuf[4] * 3600UL + pBuf[5] * 60UL + pBuf[6];
+}
+
+/*******************************************************************************
+ * Data reports
+ ******************************************************************************/
+static uint32_t decode_dataset( const uint8_t* pBuf )
+{
+  return ((uint32_t)pBuf[0] << 16) | ((uint32_t)pBuf[1] << 8) | pBuf[2];
+}
+
+static void encode_dataset( uint8_t* pBuf, uint32_t dataset )
+{
+  pBuf[0] = (dataset >> 16) & 0xFF;
+  pBuf[1] = (dataset >> 8) & 0xFF;
+  pBuf[2] = dataset & 0xFF;
+}
+
+static uint8_t encode_value( uint8_t* pBuf, uint8_t precision, uint32_t value )
+{
+  pBuf[0] = (precision & 0x7) << 5; // scale 0, the unit follows from the dataset
+  pBuf[1] = (value >> 24) & 0xFF;
+  pBuf[2] = (value >> 16) & 0xFF;
+  pBuf[3] = (value >>  8) & 0xFF;
+  pBuf[4] = value & 0xFF;
+  return DATA_REPORT_VALUE_SIZE;
+}
+
+static uint8_t build_data_report( uint8_t* pBuf, uint8_t command, uint8_t reports_to_follow,
+                                  uint32_t dataset, uint32_t time )
+{
+  pBuf[0] = COMMAND_CLASS_METER_TBL_MONITOR_V2;
+  pBuf[1] = command;
+  pBuf[2] = reports_to_follow;
+  pBuf[3] = RATE_TYPE_IMPORT;
+  encode_dataset(&pBuf[4], dataset);
+  encode_time(&pBuf[7], time);
+  return DATA_REPORT_HEADER_SIZE;
+}
+
+static uint8_t count_bits( uint32_t value )
+{
+  uint8_t count = 0;
+  while( value ) {
+    value &= value - 1;
+    count++;
+  }
+  return count;
+}
+
+// Take as many datasets from 'pending' as fit in one report, lowest bit first
+static uint32_t take_datasets( uint32_t* pPending )
+{
+  static const size_t values_per_report =
+    (max_bytes_per_report - DATA_REPORT_HEADER_SIZE) / DATA_REPORT_VALUE_SIZE;
+  uint32_t taken = 0;
+  for( size_t i = 0; i < values_per_report && *pPending; i++ ) {
+    uint32_t lowest = *pPending & (~*pPending + 1);
+    taken |= lowest;
+    *pPending &= ~lowest;
+  }
+  return taken;
+}
+
+static uint8_t build_current_data_report( uint8_t* pBuf, uint8_t reports_to_follow,
+                                          uint32_t dataset, uint32_t now_ms )
+{
+  uint8_t length = build_data_report(pBuf, METER_TBL_CURRENT_DATA_REPORT_V2,
+                                     reports_to_follow, dataset, wall_clock(now_ms));
+
+  // Values go in the order of their dataset bits
+  if( dataset & DATASET_ACCUMULATED_KWH ) {
+    length += encode_value(&pBuf[length], 3, total_meter_reading - meter_offset);
+  }
+  if( dataset & DATASET_INSTANT_W ) {
+    length += encode_value(&pBuf[length], 0, active_power_watt);
+  }
+  if( dataset & DATASET_VOLTAGE ) {
+    length += encode_value(&pBuf[length], 0, voltage_l1);
+  }
+  if( dataset & DATASET_CURRENT ) {
+    length += encode_value(&pBuf[length], 3, (uint32_t)current_l1);
+  }
+  return length;
+}
+
+/*******************************************************************************
+ * Callback logic for only queueing one report of a multi-report response at a
+ * time.
+ ******************************************************************************/
+typedef struct {
+  bool in_progress;                             // is the content of this struct valid?
+  TRANSMIT_OPTIONS_TYPE_SINGLE_EX pkg_options;  // transmit options for sending the next packet
+  uint8_t command;                              // current or historical data report
+  uint32_t pending_datasets;                    // current data: datasets still to send
+  uint8_t history_index;                        // historical data: next entry to look at
+  uint32_t start_time;                          // historical data: requested range
+  uint32_t stop_time;
+  uint8_t num_packets_remaining;                // remaining number of packets to send
+} data_report_in_progress_t;
+
+static data_report_in_progress_t data_report_in_progress = {
+  .in_progress = false,
+};
+
+static bool history_in_range( const history_entry_t* entry )
+{
+  return entry->time >= data_report_in_progress.start_time &&
+         entry->time <= data_report_in_progress.stop_time;
+}
+
+static void data_report_progress_cb( uint8_t status );
+
+// Build and queue the next report of the response in progress
+static bool data_report_send_next( void )
+{
+  ZAF_TRANSPORT_TX_BUFFER  TxBuf;
+  ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
+  memset((uint8_t*)pTxBuf, 0, sizeof(ZW_APPLICATION_TX_BUFFER) );
+  uint8_t* pFrame = (uint8_t*)pTxBuf;
+  uint8_t length;
+
+  data_report_in_progress.num_packets_remaining--;
+  uint8_t reports_to_follow = data_report_in_progress.num_packets_remaining;
+
+  if( data_report_in_progress.command == METER_TBL_CURRENT_DATA_REPORT_V2 ) {
+    uint32_t dataset = take_datasets(&data_report_in_progress.pending_datasets);
+    length = build_current_data_report(pFrame, reports_to_follow, dataset,
+                                       xTaskGetTickCount() * portTICK_PERIOD_MS);
+  } else {
+    // One report per timestamp, that's how the historical data report works
+    while( data_report_in_progress.history_index < history_count &&
+           !history_in_range(history_at(data_report_in_progress.history_index)) ) {
+      data_report_in_progress.history_index++;
+    }
+    if( data_report_in_progress.history_index >= history_count ) {
+      // The history changed under the response, e.g. on a meter switch, and
+      // has less in range than announced. End the response here.
+      DPRINTF("Meter table history ran out with %d reports to go\n", reports_to_follow + 1);
+      data_report_in_progress.in_progress = false;
+      return false;
+    }
+    const history_entry_t* entry = history_at(data_report_in_progress.history_index++);
+    length = build_data_report(pFrame, METER_TBL_HISTORICAL_DATA_REPORT_V2,
+                               reports_to_follow, DATASET_ACCUMULATED_KWH, entry->time);
+    uint32_t reading = entry->reading_wh > meter_offset ? entry->reading_wh - meter_offset : 0;
+    length += encode_value(&pFrame[length], 3, reading);
+  }
+
+  if( reports_to_follow == 0 ) {
+    data_report_in_progress.in_progress = false;
+  }
+
+  if( EQUEUENOTIFYING_STATUS_SUCCESS != Transport_SendResponseEP(
+        pFrame,
+        length,
+        &data_report_in_progress.pkg_options,
+        reports_to_follow > 0 ? data_report_progress_cb : NULL) )
+  {
+    // Failed to queue the packet somehow, meaning we won't get a
+    // new callback. Give up on this transmission.
+    DPRINTF("Failed Tx of meter table report %d\n", reports_to_follow);
+    data_report_in_progress.in_progress = false;
+    return false;
+  }
+  return true;
+}
+
+static void data_report_progress_cb( uint8_t status )
+{
+  if( data_report_in_progress.in_progress ) {
+    data_report_send_next();
+  }
+}
+
+/*******************************************************************************
+ * Command handler
+ ******************************************************************************/
+static received_frame_status_t send_string_report( RECEIVE_OPTIONS_TYPE_EX *rxOpt,
+                                                   uint8_t command,
+                                                   const char* string,
+                                                   size_t max_length )
+{
+  ZAF_TRANSPORT_TX_BUFFER  TxBuf;
+  ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
+  memset((uint8_t*)pTxBuf, 0, sizeof(ZW_APPLICATION_TX_BUFFER) );
+  uint8_t* pFrame = (uint8_t*)pTxBuf;
+
+  TRANSMIT_OPTIONS_TYPE_SINGLE_EX *pTxOptionsEx;
+  RxToTxOptions(rxOpt, &pTxOptionsEx);
+
+  size_t length = strnlen(string, max_length);
+  if( length > 0x1F ) {
+    length = 0x1F;
+  }
+
+  pFrame[0] = COMMAND_CLASS_METER_TBL_MONITOR_V2;
+  pFrame[1] = command;
+  pFrame[2] = length;
+  memcpy(&pFrame[3], string, length);
+
+  if( EQUEUENOTIFYING_STATUS_SUCCESS != Transport_SendResponseEP(
+        pFrame, 3 + length, pTxOptionsEx, NULL) ) {
+    return RECEIVED_FRAME_STATUS_FAIL;
+  }
+  return RECEIVED_FRAME_STATUS_SUCCESS;
+}
+
+static received_frame_status_t send_frame( RECEIVE_OPTIONS_TYPE_EX *rxOpt,
+                                           const uint8_t* pFrame, uint8_t length )
+{
+  ZAF_TRANSPORT_TX_BUFFER  TxBuf;
+  ZW_APPLICATION_TX_BUFFER *pTxBuf = &(TxBuf.appTxBuf);
+  memcpy((uint8_t*)pTxBuf, pFrame, length);
+
+  TRANSMIT_OPTIONS_TYPE_SINGLE_EX *pTxOptionsEx;
+  RxToTxOptions(rxOpt, &pTxOptionsEx);
+
+  if( EQUEUENOTIFYING_STATUS_SUCCESS != Transport_SendResponseEP(
+        (uint8_t *)pTxBuf, length, pTxOptionsEx, NULL) ) {
+    return RECEIVED_FRAME_STATUS_FAIL;
+  }
+  return RECEIVED_FRAME_STATUS_SUCCESS;
+}
+
+static received_frame_status_t start_data_report( RECEIVE_OPTIONS_TYPE_EX *rxOpt,
+                                                  uint8_t command,
+                                                  uint8_t num_packets )
+{
+  if( data_report_in_progress.in_progress ) {
+    return RECEIVED_FRAME_STATUS_FAIL;
+  }
+
+  TRANSMIT_OPTIONS_TYPE_SINGLE_EX *pTxOptionsEx;
+  RxToTxOptions(rxOpt, &pTxOptionsEx);
+
+  data_report_in_progress.in_progress = true;
+  memcpy(&data_report_in_progress.pkg_options,
+         pTxOptionsEx,
+         sizeof(TRANSMIT_OPTIONS_TYPE_SINGLE_EX));
+  data_report_in_progress.command = command;
+  data_report_in_progress.num_packets_remaining = num_packets;
+
+  return data_report_send_next() ? RECEIVED_FRAME_STATUS_SUCCESS : RECEIVED_FRAME_STATUS_FAIL;
+}
+
+received_frame_status_t handleCommandClassMeterTableMonitor(
+  RECEIVE_OPTIONS_TYPE_EX *rxOpt,
+  ZW_APPLICATION_TX_BUFFER *pCmd,
+  uint8_t cmdLength )
+{
+  const uint8_t* pFrame = (const uint8_t*)pCmd;
+
+  if( true == Check_not_legal_response_job(rxOpt) ) {
+    return RECEIVED_FRAME_STATUS_FAIL;
+  }
+
+  switch( pCmd->ZW_Common.cmd ) {
+    case METER_TBL_TABLE_POINT_ADM_NO_GET_V2:
+      // The meter model is what identifies the kind of metering point
+      return send_string_report(rxOpt, METER_TBL_TABLE_POINT_ADM_NO_REPORT_V2,
+                                meter_model, sizeof(meter_model));
+
+    case METER_TBL_TABLE_ID_GET_V2:
+      return send_string_report(rxOpt, METER_TBL_TABLE_ID_REPORT_V2,
+                                meter_id, sizeof(meter_id));
+
+    case METER_TBL_TABLE_CAPABILITY_GET_V2:
+    {
+      uint8_t report[13] = {
+        COMMAND_CLASS_METER_TBL_MONITOR_V2,
+        METER_TBL_REPORT_V2,
+        (RATE_TYPE_IMPORT << 6) | METER_TYPE_ELECTRIC,
+        PAY_METER_CREDITMETER,
+      };
+      encode_dataset(&report[4], DATASET_SUPPORTED);
+      encode_dataset(&report[7], DATASET_HISTORY_SUPPORTED);
+      encode_dataset(&report[10], DATASET_HISTORY_SUPPORTED);
+      return send_frame(rxOpt, report, sizeof(report));
+    }
+
+    case METER_TBL_STATUS_SUPPORTED_GET_V2:
+    {
+      // No operating status events, and thus no event log either
+      const uint8_t report[6] = {
+        COMMAND_CLASS_METER_TBL_MONITOR_V2,
+        METER_TBL_STATUS_SUPPORTED_REPORT_V2,
+        0, 0, 0,
+        0,
+      };
+      return send_frame(rxOpt, report, sizeof(report));
+    }
+
+    case METER_TBL_STATUS_DEPTH_GET_V2:
+    case METER_TBL_STATUS_DATE_GET_V2:
+    {
+      const uint8_t report[6] = {
+        COMMAND_CLASS_METER_TBL_MONITOR_V2,
+        METER_TBL_STATUS_REPORT_V2,
+        0,
+        0, 0, 0,
+      };
+      return send_frame(rxOpt, report, sizeof(report));
+    }
+
+    case METER_TBL_CURRENT_DATA_GET_V2:
+    {
+      if( cmdLength < 5 ) {
+        return RECEIVED_FRAME_STATUS_FAIL;
+      }
+      uint32_t dataset = decode_dataset(&pFrame[2]) & DATASET_SUPPORTED;
+      if( dataset == 0 ) {
+        return RECEIVED_FRAME_STATUS_NO_SUPPORT;
+      }
+
+      size_t values_per_report =
+        (max_bytes_per_report - DATA_REPORT_HEADER_SIZE) / DATA_REPORT_VALUE_SIZE;
+      uint8_t num_packets = (count_bits(dataset) + values_per_report - 1) / values_per_report;
+
+      data_report_in_progress.pending_datasets = dataset;
+      return start_data_report(rxOpt, METER_TBL_CURRENT_DATA_REPORT_V2, num_packets);
+    }
+
+    case METER_TBL_HISTORICAL_DATA_GET_V2:
+    {
+      if( cmdLength < 20 ) {
+        return RECEIVED_FRAME_STATUS_FAIL;
+      }
+      uint8_t max_reports = pFrame[2];
+      uint32_t dataset = decode_dataset(&pFrame[3]) & DATASET_HISTORY_SUPPORTED;
+      if( dataset == 0 ) {
+        return RECEIVED_FRAME_STATUS_NO_SUPPORT;
+      }
+
+      data_report_in_progress.start_time = decode_time(&pFrame[6]);
+      data_report_in_progress.stop_time = decode_time(&pFrame[13]);
+      if( data_report_in_progress.stop_time == 0 ) {
+        data_report_in_progress.stop_time = UINT32_MAX;
+      }
+
+      uint8_t num_packets = 0;
+      bool first_found = false;
+      for( uint8_t i = 0; i < history_count; i++ ) {
+        if( history_in_range(history_at(i)) ) {
+          if( !first_found ) {
+            first_found = true;
+            data_report_in_progress.history_index = i;
+          }
+          num_packets++;
+        }
+      }
+
+      if( max_reports > 0 && num_packets > max_reports ) {
+        num_packets = max_reports;
+      }
+      if( num_packets == 0 ) {
+        // Nothing recorded in that range, say so with an empty report
+        uint8_t report[DATA_REPORT_HEADER_SIZE];
+        build_data_report(report, METER_TBL_HISTORICAL_DATA_REPORT_V2, 0, 0, 0);
+        return send_frame(rxOpt, report, sizeof(report));
+      }
+      return start_data_report(rxOpt, METER_TBL_HISTORICAL_DATA_REPORT_V2, num_packets);
+    }
+
+    default:
+      break;
+  }
+  return RECEIVED_FRAME_STATUS_NO_SUPPORT;
+}
+
+REGISTER_CC(COMMAND_CLASS_METER_TBL_MONITOR, METER_TBL_MONITOR_VERSION_V2, handleCommandClassMeterTableMonitor);
+
+#ifdef __cplusplus
+}
+#endif
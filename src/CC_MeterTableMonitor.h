@@ -0,0 +1,62 @@
+/***************************************************************************//**
+ * @file CC_MeterTableMonitor.h
+ * @brief This file describes the Meter Table Monitor CC interface
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+#ifndef CC_METERTABLEMONITOR_H_
+#define CC_METERTABLEMONITOR_H_
+
+#include "ZAF_types.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Amount of hourly readings kept for Historical Data Get
+#define METER_TABLE_HISTORY_DEPTH 48
+
+// Set the wall clock, in seconds since 1970-01-01 00:00 in the meter's own
+// time zone, as read from the meter at 'now_ms'
+void CC_MeterTableMonitor_setTime( uint64_t meter_time, uint32_t now_ms );
+
+// Add an hourly accumulated meter reading (in Wh) to the history, stamped
+// with the current wall clock
+void CC_MeterTableMonitor_addHistory( uint32_t reading_wh, uint32_t now_ms );
+
+// Drop the history, e.g. when we got attached to another meter
+void CC_MeterTableMonitor_resetHistory( void );
+
+// Command handler to attach in \ref Transport_ApplicationCommandHandlerEx
+received_frame_status_t handleCommandClassMeterTableMonitor(
+  RECEIVE_OPTIONS_TYPE_EX *rxOpt,
+  ZW_APPLICATION_TX_BUFFER *pCmd,
+  uint8_t cmdLength );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CC_METERTABLEMONITOR_H_ */
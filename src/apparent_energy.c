@@ -0,0 +1,120 @@
+/***************************************************************************//**
+ * @file apparent_energy.c
+ * @brief Apparent power and energy derived from the active and reactive readings
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#include "apparent_energy.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+static apparent_energy_state_t apparent;
+
+// Bit by bit, no division and a fixed 32 iterations
+uint32_t apparent_isqrt(uint64_t value)
+{
+  uint64_t root = 0;
+  uint64_t bit = 1ULL << 62;
+
+  while(bit > value) {
+    bit >>= 2;
+  }
+
+  while(bit != 0) {
+    if(value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)root;
+}
+
+uint32_t apparent_power_va(int32_t active_w, int32_t reactive_var)
+{
+  int64_t p = active_w;
+  int64_t q = reactive_var;
+  return apparent_isqrt((uint64_t)(p * p) + (uint64_t)(q * q));
+}
+
+uint8_t apparent_power_factor(int32_t active_w, int32_t reactive_var)
+{
+  uint32_t va = apparent_power_va(active_w, reactive_var);
+  if(va == 0) {
+    return 100;
+  }
+  uint32_t w = active_w < 0 ? -(uint32_t)active_w : (uint32_t)active_w;
+  // Rounded to the nearest 1/100
+  return (uint8_t)(((uint64_t)w * 100 + va / 2) / va);
+}
+
+void apparent_energy_reset(void)
+{
+  apparent.total_vah = 0;
+  apparent.last_active_wh = 0;
+  apparent.last_reactive_varh = 0;
+  apparent.anchored = 0;
+}
+
+void apparent_energy_update(uint32_t active_wh, uint32_t reactive_varh)
+{
+  if(apparent.anchored &&
+     active_wh >= apparent.last_active_wh &&
+     reactive_varh >= apparent.last_reactive_varh) {
+    uint32_t delta_wh = active_wh - apparent.last_active_wh;
+    uint32_t delta_varh = reactive_varh - apparent.last_reactive_varh;
+    apparent.total_vah += apparent_isqrt((uint64_t)delta_wh * delta_wh +
+                                         (uint64_t)delta_varh * delta_varh);
+  }
+  // The first reading, and a register going backwards (meter replaced or
+  // reset), only move the anchor
+
+  apparent.last_active_wh = active_wh;
+  apparent.last_reactive_varh = reactive_varh;
+  apparent.anchored = 1;
+}
+
+uint32_t apparent_energy_total(void)
+{
+  return apparent.total_vah;
+}
+
+void apparent_energy_get_state(apparent_energy_state_t* pState)
+{
+  *pState = apparent;
+}
+
+void apparent_energy_set_state(const apparent_energy_state_t* pState)
+{
+  apparent = *pState;
+}
+
+#ifdef __cplusplus
+}
+#endif
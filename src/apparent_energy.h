@@ -0,0 +1,81 @@
+/***************************************************************************//**
+ * @file apparent_energy.h
+ * @brief Apparent power and energy derived from the active and reactive readings
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_APPARENT_ENERGY_H_
+#define AMS_APPARENT_ENERGY_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The HAN lists carry active and reactive energy, but not apparent energy. It
+// is built up from the hourly readings instead: every hour adds the length of
+// the (active, reactive) vector both registers moved along. That is exact when
+// the power factor holds steady within the hour, and on the low side when it
+// doesn't. The first reading only anchors the registers: the total starts
+// from 0, or from where a saved state left it, since the lifetime registers
+// don't tell what the power factor was along the way.
+
+// Everything needed to carry on after a restart
+typedef struct {
+  uint32_t total_vah;
+  uint32_t last_active_wh;
+  uint32_t last_reactive_varh;
+  uint32_t anchored;            // the last_ readings are valid
+} apparent_energy_state_t;
+
+// Integer square root, rounded down
+uint32_t apparent_isqrt(uint64_t value);
+
+// Apparent power in VA from active and reactive power
+uint32_t apparent_power_va(int32_t active_w, int32_t reactive_var);
+
+// Power factor in 1/100, from active and reactive power. 100 without load.
+uint8_t apparent_power_factor(int32_t active_w, int32_t reactive_var);
+
+// Forget everything, e.g. when the readings belong to another meter
+void apparent_energy_reset(void);
+
+// Feed the hourly accumulated readings, active in Wh and reactive in varh.
+// Both include import and export, since either direction loads the line.
+void apparent_energy_update(uint32_t active_wh, uint32_t reactive_varh);
+
+// Accumulated apparent energy, in VAh
+uint32_t apparent_energy_total(void);
+
+void apparent_energy_get_state(apparent_energy_state_t* pState);
+void apparent_energy_set_state(const apparent_energy_state_t* pState);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_APPARENT_ENERGY_H_ */
@@ -78,6 +78,16 @@
 #define APP_NODE_TYPE ZWAVEPLUS_INFO_REPORT_NODE_TYPE_ZWAVEPLUS_NODE
 #define APP_ICON_TYPE ICON_TYPE_GENERIC_WHOLE_HOME_METER_SIMPLE
 #define APP_USER_ICON_TYPE ICON_TYPE_GENERIC_WHOLE_HOME_METER_SIMPLE
+
+/**
+ * Icons of the phase endpoints and the energy estimate endpoint,
+ * {installer icon, user icon}
+ */
+#define ENDPOINT_ICONS \
+ {ICON_TYPE_GENERIC_SUB_ENERGY_METER, ICON_TYPE_GENERIC_SUB_ENERGY_METER},\
+ {ICON_TYPE_GENERIC_SUB_ENERGY_METER, ICON_TYPE_GENERIC_SUB_ENERGY_METER},\
+ {ICON_TYPE_GENERIC_SUB_ENERGY_METER, ICON_TYPE_GENERIC_SUB_ENERGY_METER},\
+ {ICON_TYPE_GENERIC_SUB_ENERGY_METER, ICON_TYPE_GENERIC_SUB_ENERGY_METER}
 //@ [APP_TYPE_ID]
 
 /****************************************************************************
@@ -101,8 +111,11 @@
  * Command Class.
  *
  ****************************************************************************/
-#define NUMBER_OF_ENDPOINTS         0
-#define MAX_ASSOCIATION_GROUPS      1
+// One endpoint per phase, and one for the energy estimate
+#define NUMBER_OF_INDIVIDUAL_ENDPOINTS  4
+#define NUMBER_OF_AGGREGATED_ENDPOINTS  0
+#define NUMBER_OF_ENDPOINTS         (NUMBER_OF_INDIVIDUAL_ENDPOINTS + NUMBER_OF_AGGREGATED_ENDPOINTS)
+#define MAX_ASSOCIATION_GROUPS      3
 #define MAX_ASSOCIATION_IN_GROUP    5
 
 /*
@@ -117,8 +130,14 @@
  {COMMAND_CLASS_METER_V5, METER_REPORT_V5},\
  {COMMAND_CLASS_INDICATOR, INDICATOR_REPORT_V3}
 
+#define AGITABLE_LIFELINE_GROUP_EP1_4 \
+ {COMMAND_CLASS_METER_V5, METER_REPORT_V5}
 
-#define  AGITABLE_ROOTDEVICE_GROUPS NULL
+// Group 2 receives every power reading, for real-time load balancing
+// Group 3 receives the raw HDLC frames from the meter, when enabled
+#define  AGITABLE_ROOTDEVICE_GROUPS \
+ {{ASSOCIATION_GROUP_INFO_REPORT_PROFILE_METER, 0x01 /* electric meter */}, {COMMAND_CLASS_METER_V5, METER_REPORT_V5}, {"Power stream"}}, \
+ {{ASSOCIATION_GROUP_INFO_REPORT_PROFILE_GENERAL, ASSOCIATION_GROUP_INFO_REPORT_PROFILE_GENERAL_NA}, {COMMAND_CLASS_MANUFACTURER_PROPRIETARY, 0x00}, {"HAN frames"}}
 //@ [AGI_TABLE_ID]
 
 /**
@@ -0,0 +1,146 @@
+/***************************************************************************//**
+ * @file energy_estimator.c
+ * @brief Sub-hour energy estimate integrated from the active power readings
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+#include "energy_estimator.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Some meters report the power over the last second only, once every 10s. A
+// short spike can thus stand in for a whole interval. Shave a bit off the
+// integrated energy to keep the estimate below the real reading.
+#define ENERGY_ESTIMATOR_MARGIN_PCT 3
+
+// When readings go missing for longer than this, don't guess what happened in
+// between. list1 comes in every 2.5s, so this allows for a few lost frames.
+#define ENERGY_ESTIMATOR_MAX_GAP_MS 15000
+
+#define MS_PER_HOUR 3600000ULL
+
+static struct {
+  bool anchored;
+  uint32_t anchor_wh;         // last hourly reading
+  uint64_t integrated_wms;    // energy since the anchor, in W*ms
+  bool has_sample;
+  uint32_t last_watt;
+  uint32_t last_sample_ms;
+  uint32_t published_wh;      // highest estimate handed out so far
+} estimator;
+
+static energy_estimator_stats_t estimator_stats;
+
+void energy_estimator_reset(void)
+{
+  estimator.anchored = false;
+  estimator.anchor_wh = 0;
+  estimator.integrated_wms = 0;
+  estimator.has_sample = false;
+  estimator.published_wh = 0;
+}
+
+void energy_estimator_add_power(uint32_t watt, uint32_t now_ms)
+{
+  if(estimator.has_sample) {
+    uint32_t elapsed = now_ms - estimator.last_sample_ms;
+    if(elapsed <= ENERGY_ESTIMATOR_MAX_GAP_MS) {
+      // Trapezoid between the two readings, the margin takes care of the rest
+      estimator.integrated_wms += ((uint64_t)watt + estimator.last_watt) * elapsed / 2;
+    }
+  }
+
+  estimator.has_sample = true;
+  estimator.last_watt = watt;
+  estimator.last_sample_ms = now_ms;
+}
+
+static uint32_t energy_estimator_raw(void)
+{
+  uint64_t integrated_wh = estimator.integrated_wms * (100 - ENERGY_ESTIMATOR_MARGIN_PCT)
+                           / 100 / MS_PER_HOUR;
+  return estimator.anchor_wh + (uint32_t)integrated_wh;
+}
+
+void energy_estimator_reconcile(uint32_t reading_wh)
+{
+  if(estimator.anchored) {
+    uint32_t estimate = energy_estimator_estimate();
+    uint32_t error = estimate > reading_wh ? estimate - reading_wh : reading_wh - estimate;
+
+    estimator_stats.reconciliations++;
+    estimator_stats.last_error_wh = error;
+    estimator_stats.total_error_wh += error;
+    if(error > estimator_stats.max_error_wh) {
+      estimator_stats.max_error_wh = error;
+    }
+    if(estimate > reading_wh) {
+      estimator_stats.overshoots++;
+    }
+  }
+
+  // Start over from the real reading. If it's lower than what we published,
+  // energy_estimator_estimate keeps reporting the published value until the
+  // integration overtakes it. The power reading which came along with it
+  // is already in as the starting point for the next hour.
+  estimator.anchored = true;
+  estimator.anchor_wh = reading_wh;
+  estimator.integrated_wms = 0;
+}
+
+bool energy_estimator_valid(void)
+{
+  return estimator.anchored;
+}
+
+uint32_t energy_estimator_estimate(void)
+{
+  if(!estimator.anchored) {
+    return estimator.published_wh;
+  }
+
+  uint32_t estimate = energy_estimator_raw();
+  if(estimate > estimator.published_wh) {
+    estimator.published_wh = estimate;
+  }
+  return estimator.published_wh;
+}
+
+void energy_estimator_restore(uint32_t published_wh)
+{
+  if(published_wh > estimator.published_wh) {
+    estimator.published_wh = published_wh;
+  }
+}
+
+const energy_estimator_stats_t* energy_estimator_stats(void)
+{
+  return &estimator_stats;
+}
+
+#ifdef __cplusplus
+}
+#endif
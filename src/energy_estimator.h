@@ -0,0 +1,79 @@
+/***************************************************************************//**
+ * @file energy_estimator.h
+ * @brief Sub-hour energy estimate integrated from the active power readings
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_ENERGY_ESTIMATOR_H_
+#define AMS_ENERGY_ESTIMATOR_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The meter only sends its accumulated reading once an hour. In between, the
+// estimator integrates the active power readings on top of the last hourly
+// reading. The estimate errs on the low side, and it never goes backwards:
+// when the hourly reading comes in lower than what was already published,
+// the published value holds until the integration catches up with it.
+
+typedef struct {
+  uint32_t reconciliations;   // hourly readings seen while anchored
+  uint32_t overshoots;        // times the published value was above the reading
+  uint32_t last_error_wh;     // |estimate - reading| at the last reconciliation
+  uint32_t max_error_wh;
+  uint64_t total_error_wh;
+} energy_estimator_stats_t;
+
+// Forget everything, e.g. when the readings belong to another meter
+void energy_estimator_reset(void);
+
+// Feed an active power reading taken at 'now_ms'
+void energy_estimator_add_power(uint32_t watt, uint32_t now_ms);
+
+// Feed an hourly accumulated reading (in Wh). Feed the power reading from the
+// same frame first.
+void energy_estimator_reconcile(uint32_t reading_wh);
+
+// Whether there's an estimate, i.e. an hourly reading has been seen
+bool energy_estimator_valid(void);
+
+// Current estimate of the accumulated reading, in Wh
+uint32_t energy_estimator_estimate(void);
+
+// Don't publish anything lower than 'published_wh' from now on, e.g. what
+// was published before a reset
+void energy_estimator_restore(uint32_t published_wh);
+
+const energy_estimator_stats_t* energy_estimator_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_ENERGY_ESTIMATOR_H_ */
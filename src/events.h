@@ -63,7 +63,9 @@ typedef enum EVENT_APP_AMS2ZWAVE
   EVENT_APP_POWER_UPDATE_SLOW, // fires each 10s when a meter is connected
   EVENT_APP_ENERGY_UPDATE,     // fires each 3600s when a meter is connected
   EVENT_APP_UNHANDLED_STATUS,  // fires when a command status is unhandled
-  EVENT_APP_UNHANDLED_PACKET   // fires when an incoming packet is unhandled
+  EVENT_APP_UNHANDLED_PACKET,  // fires when an incoming packet is unhandled
+  EVENT_APP_WARM_START,        // fires once at startup when readings were retained
+  EVENT_APP_HAN_FRAME          // fires when a raw HAN frame is ready to be tunnelled
 }
 EVENT_APP;
 
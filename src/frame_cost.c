@@ -0,0 +1,48 @@
+/***************************************************************************//**
+ * @file frame_cost.c
+ * @brief Over-the-air cost of singlecast and multicast frames
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#include "frame_cost.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int32_t frame_cost_multicast_saving(uint8_t destinations, uint8_t size, bool secure)
+{
+  int32_t singlecast = (int32_t)destinations * (size + FRAME_OVERHEAD_BYTES);
+  int32_t multicast = size + FRAME_OVERHEAD_BYTES + MULTICAST_MASK_BYTES;
+  if(secure) {
+    multicast += (int32_t)destinations *
+                 (size + FRAME_OVERHEAD_BYTES + MULTICAST_FOLLOWUP_EXTENSION_BYTES);
+  }
+  return singlecast - multicast;
+}
+
+#ifdef __cplusplus
+}
+#endif
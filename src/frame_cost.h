@@ -0,0 +1,64 @@
+/***************************************************************************//**
+ * @file frame_cost.h
+ * @brief Over-the-air cost of singlecast and multicast frames
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_FRAME_COST_H_
+#define AMS_FRAME_COST_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Rough byte counts behind the choice between sending something once or once
+// per destination. Kept apart from the transmit code so they can be checked
+// on the host.
+
+// Rough over-the-air cost of a singlecast frame besides its payload: MAC
+// header and checksum, S2 encapsulation header and authentication tag.
+#define FRAME_OVERHEAD_BYTES 23
+// A multicast frame carries a node mask instead of a single destination
+#define MULTICAST_MASK_BYTES 29
+// An S2 follow-up is a singlecast with an extension naming the multicast group
+#define MULTICAST_FOLLOWUP_EXTENSION_BYTES 3
+
+// Estimated over-the-air bytes a multicast of 'size' bytes to 'destinations'
+// nodes saves over a singlecast to each. 0 or less when it saves nothing.
+//
+// With S2 ('secure') every destination also gets a singlecast follow-up, which
+// costs more than the singlecast it replaces, so a multicast never wins then:
+// the saving is -(size + FRAME_OVERHEAD_BYTES + MULTICAST_MASK_BYTES) less
+// MULTICAST_FOLLOWUP_EXTENSION_BYTES per destination, for any count.
+int32_t frame_cost_multicast_saving(uint8_t destinations, uint8_t size, bool secure);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_FRAME_COST_H_ */
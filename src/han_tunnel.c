@@ -0,0 +1,180 @@
+/***************************************************************************//**
+ * @file han_tunnel.c
+ * @brief Framing of raw HDLC frames off the HAN bus, for forwarding as-is
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+#include "han_tunnel.h"
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define HDLC_FLAG 0x7E
+// Frame format type 3, the upper nibble of the frame format field
+#define HDLC_FORMAT_TYPE_3 0xA0
+
+typedef enum {
+  FRAMER_HUNT,    // waiting for an opening flag
+  FRAMER_FORMAT,  // got a flag, waiting for the frame format field
+  FRAMER_FRAME,   // collecting the frame itself
+  FRAMER_CLOSE,   // frame complete, waiting for the closing flag
+} framer_state_t;
+
+// Frames are assembled in one buffer and handed over in the other, so the
+// next frame can come in while the last one is being forwarded
+static uint8_t assembly[HAN_TUNNEL_MAX_FRAME];
+static uint8_t held[HAN_TUNNEL_MAX_FRAME];
+static size_t assembly_length;
+static size_t expected_length;
+static size_t held_length;
+static bool holding;
+static framer_state_t state = FRAMER_HUNT;
+static han_tunnel_counters_t counters;
+
+uint16_t han_tunnel_crc16_x25(const uint8_t* pData, size_t length)
+{
+  uint16_t crc = 0xFFFF;
+  for(size_t i = 0; i < length; i++) {
+    crc ^= pData[i];
+    for(uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+    }
+  }
+  return crc ^ 0xFFFF;
+}
+
+static bool han_tunnel_complete(void)
+{
+  // The FCS goes least significant byte first
+  uint16_t fcs = assembly[assembly_length - 2] | (assembly[assembly_length - 1] << 8);
+  if(han_tunnel_crc16_x25(assembly, assembly_length - 2) != fcs) {
+    counters.crc_errors++;
+    return false;
+  }
+
+  counters.frames++;
+  if(holding) {
+    counters.overruns++;
+    return false;
+  }
+
+  memcpy(held, assembly, assembly_length);
+  held_length = assembly_length;
+  holding = true;
+  return true;
+}
+
+bool han_tunnel_input_byte(uint8_t data)
+{
+  switch(state) {
+    case FRAMER_HUNT:
+      if(data == HDLC_FLAG) {
+        state = FRAMER_FORMAT;
+      }
+      return false;
+
+    case FRAMER_FORMAT:
+      // Back-to-back flags are allowed between frames
+      if(data == HDLC_FLAG) {
+        return false;
+      }
+      if((data & 0xF0) != HDLC_FORMAT_TYPE_3) {
+        state = FRAMER_HUNT;
+        return false;
+      }
+      assembly[0] = data;
+      assembly_length = 1;
+      state = FRAMER_FRAME;
+      return false;
+
+    case FRAMER_FRAME:
+      assembly[assembly_length++] = data;
+      if(assembly_length == 2) {
+        // 11-bit frame length, counting from the format field through the FCS
+        expected_length = ((assembly[0] & 0x07) << 8) | assembly[1];
+        if(expected_length > HAN_TUNNEL_MAX_FRAME) {
+          counters.oversize++;
+          state = FRAMER_HUNT;
+        } else if(expected_length < 4) {
+          state = FRAMER_HUNT;
+        }
+        return false;
+      }
+      if(assembly_length == expected_length) {
+        state = FRAMER_CLOSE;
+      }
+      return false;
+
+    case FRAMER_CLOSE:
+      if(data != HDLC_FLAG) {
+        // Length didn't add up, or we started on a flag inside a frame
+        state = FRAMER_HUNT;
+        return false;
+      }
+      // The closing flag may also open the next frame
+      state = FRAMER_FORMAT;
+      return han_tunnel_complete();
+
+    default:
+      state = FRAMER_HUNT;
+      return false;
+  }
+}
+
+const uint8_t* han_tunnel_frame(size_t* pLength)
+{
+  if(!holding) {
+    return NULL;
+  }
+  *pLength = held_length;
+  return held;
+}
+
+void han_tunnel_release(void)
+{
+  holding = false;
+}
+
+void han_tunnel_reset(void)
+{
+  state = FRAMER_HUNT;
+  assembly_length = 0;
+  holding = false;
+}
+
+uint16_t han_tunnel_segment_count(size_t length)
+{
+  return (uint16_t)((length + HAN_TUNNEL_SEGMENT_DATA - 1) / HAN_TUNNEL_SEGMENT_DATA);
+}
+
+const han_tunnel_counters_t* han_tunnel_counters(void)
+{
+  return &counters;
+}
+
+#ifdef __cplusplus
+}
+#endif
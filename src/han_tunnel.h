@@ -0,0 +1,80 @@
+/***************************************************************************//**
+ * @file han_tunnel.h
+ * @brief Framing of raw HDLC frames off the HAN bus, for forwarding as-is
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_HAN_TUNNEL_H_
+#define AMS_HAN_TUNNEL_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Largest HDLC frame we'll hold on to, between (and excluding) the flags
+#define HAN_TUNNEL_MAX_FRAME 512
+
+// Frame bytes per Manufacturer Proprietary segment, the same as
+// MFG_PROPRIETARY_SEGMENT_DATA
+#define HAN_TUNNEL_SEGMENT_DATA 33
+
+typedef struct {
+  uint32_t frames;      // complete frames with a valid FCS
+  uint32_t crc_errors;
+  uint32_t oversize;
+  uint32_t overruns;    // valid frames lost because the last one wasn't released
+} han_tunnel_counters_t;
+
+// Feed one byte off the HAN bus. Returns true when it completed a frame with
+// a valid frame check sequence, which is then available from
+// han_tunnel_frame() until released.
+bool han_tunnel_input_byte(uint8_t data);
+
+// The frame held for forwarding, if any: format field through FCS
+const uint8_t* han_tunnel_frame(size_t* pLength);
+
+// Done with the held frame, the next one may take its place
+void han_tunnel_release(void);
+
+// Drop any partial or held frame
+void han_tunnel_reset(void);
+
+// Segments a frame of 'length' bytes takes, to each destination
+uint16_t han_tunnel_segment_count(size_t length);
+
+// CRC-16/X-25 as used for the HDLC header and frame check sequences
+uint16_t han_tunnel_crc16_x25(const uint8_t* pData, size_t length);
+
+const han_tunnel_counters_t* han_tunnel_counters(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_HAN_TUNNEL_H_ */
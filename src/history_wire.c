@@ -0,0 +1,72 @@
+/***************************************************************************//**
+ * @file history_wire.c
+ * @brief Wire format of the power history transfers
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#include "history_wire.h"
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+static void history_wire_put_u16(uint8_t* pBuf, uint16_t value)
+{
+  pBuf[0] = (value >> 8) & 0xFF;
+  pBuf[1] = value & 0xFF;
+}
+
+static void history_wire_put_u32(uint8_t* pBuf, uint32_t value)
+{
+  pBuf[0] = (value >> 24) & 0xFF;
+  pBuf[1] = (value >> 16) & 0xFF;
+  pBuf[2] = (value >> 8) & 0xFF;
+  pBuf[3] = value & 0xFF;
+}
+
+uint8_t history_wire_put_header(uint8_t* pBuf, timeseries_tier_t tier, bool more, uint8_t blocks)
+{
+  pBuf[0] = tier;
+  history_wire_put_u16(&pBuf[1], timeseries_unit_ds(tier));
+  pBuf[3] = more ? HISTORY_WIRE_MORE_FOLLOWS : 0;
+  pBuf[4] = blocks;
+  return HISTORY_WIRE_TRANSFER_HEADER_SIZE;
+}
+
+uint8_t history_wire_put_block(uint8_t* pBuf, const timeseries_block_t* pBlock, uint32_t now)
+{
+  history_wire_put_u16(&pBuf[0], pBlock->sequence);
+  history_wire_put_u32(&pBuf[2], now - pBlock->start);
+  history_wire_put_u32(&pBuf[6], (uint32_t)pBlock->first_value);
+  pBuf[10] = pBlock->count;
+  pBuf[11] = pBlock->length;
+  memcpy(&pBuf[HISTORY_WIRE_BLOCK_HEADER_SIZE], pBlock->data, pBlock->length);
+  return HISTORY_WIRE_BLOCK_HEADER_SIZE + pBlock->length;
+}
+
+#ifdef __cplusplus
+}
+#endif
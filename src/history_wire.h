@@ -0,0 +1,66 @@
+/***************************************************************************//**
+ * @file history_wire.h
+ * @brief Wire format of the power history transfers
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_HISTORY_WIRE_H_
+#define AMS_HISTORY_WIRE_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "timeseries.h"
+
+// What a History Get gets back, before it's split up into segments (see
+// README.md for the whole layout, and test/history_decoder.c for a reader):
+//   - tier, time unit in tenths of a second (2 bytes), flags, block count
+//   - per block: sequence number (2 bytes), age of the first sample in time
+//     units (4 bytes), first value (4 bytes), sample count, data length, and
+//     the data as stored in the timeseries block
+// Multi-byte fields are MSB first.
+
+#define HISTORY_WIRE_TRANSFER_HEADER_SIZE 5
+#define HISTORY_WIRE_BLOCK_HEADER_SIZE 12
+#define HISTORY_WIRE_BLOCK_MAX_SIZE (HISTORY_WIRE_BLOCK_HEADER_SIZE + TIMESERIES_BLOCK_DATA)
+
+// Flag: another transfer follows this one
+#define HISTORY_WIRE_MORE_FOLLOWS 0x80
+
+// Write the transfer header. Returns its length.
+uint8_t history_wire_put_header(uint8_t* pBuf, timeseries_tier_t tier, bool more, uint8_t blocks);
+
+// Write 'pBlock' of 'tier', with its age relative to 'now' in tier units.
+// Returns the length, at most HISTORY_WIRE_BLOCK_MAX_SIZE.
+uint8_t history_wire_put_block(uint8_t* pBuf, const timeseries_block_t* pBlock, uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_HISTORY_WIRE_H_ */
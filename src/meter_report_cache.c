@@ -0,0 +1,103 @@
+/***************************************************************************//**
+ * @file meter_report_cache.c
+ * @brief Pre-encoded answers to Meter Get
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#include "meter_report_cache.h"
+#include "meter_value.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// As in the ZAF, which doesn't build without the rest of the SDK
+#ifndef ENDPOINT_ROOT
+#define ENDPOINT_ROOT 0
+#endif
+
+meter_report_cache_entry_t meter_report_cache[METER_CACHE_COUNT];
+
+// The root device answers for phase 1, like it always did. Import power is
+// answered with the net power, the same as it is reported unsolicited.
+static meter_report_cache_entry_t* meter_report_cache_find(uint8_t endpoint, uint8_t rate_type, uint8_t scale)
+{
+  uint8_t phase = endpoint == ENDPOINT_ROOT ? 1 : endpoint;
+
+  if(endpoint == ENDPOINT_ENERGY_ESTIMATE) {
+    return rate_type != RT_EXPORT && scale == SCALE_KWH ? &meter_report_cache[METER_CACHE_KWH_ESTIMATE] : NULL;
+  }
+
+  if(endpoint > ENDPOINT_ENERGY_ESTIMATE) {
+    return NULL;
+  }
+
+  if(rate_type == RT_EXPORT) {
+    if(endpoint != ENDPOINT_ROOT) {
+      return NULL;
+    }
+    switch(scale) {
+      case SCALE_KWH:   return &meter_report_cache[METER_CACHE_KWH_EXPORT];
+      case SCALE_W:     return &meter_report_cache[METER_CACHE_W_EXPORT];
+      case SCALE_KVAR:  return &meter_report_cache[METER_CACHE_KVAR_EXPORT];
+      case SCALE_KVARH: return &meter_report_cache[METER_CACHE_KVARH_EXPORT];
+      default:          return NULL;
+    }
+  }
+
+  switch(scale) {
+    case SCALE_KWH: return endpoint == ENDPOINT_ROOT ? &meter_report_cache[METER_CACHE_KWH] : NULL;
+    case SCALE_W:   return endpoint == ENDPOINT_ROOT ? &meter_report_cache[METER_CACHE_W] : NULL;
+    case SCALE_V:   return &meter_report_cache[METER_CACHE_V_L1 + phase - 1];
+    case SCALE_A:   return &meter_report_cache[METER_CACHE_A_L1 + phase - 1];
+    default:        break;
+  }
+
+  if(endpoint != ENDPOINT_ROOT) {
+    return NULL;
+  }
+
+  switch(scale) {
+    case SCALE_KVAH:  return &meter_report_cache[METER_CACHE_KVAH];
+    case SCALE_PF:    return &meter_report_cache[METER_CACHE_PF];
+    case SCALE_KVAR:  return &meter_report_cache[METER_CACHE_KVAR];
+    case SCALE_KVARH: return &meter_report_cache[METER_CACHE_KVARH];
+    default:          return NULL;
+  }
+}
+
+const meter_report_cache_entry_t* meter_report_cache_lookup(uint8_t endpoint, uint8_t rate_type, uint8_t scale)
+{
+  const meter_report_cache_entry_t* pEntry = meter_report_cache_find(endpoint, rate_type, scale);
+  if(pEntry == NULL || pEntry->length == 0) {
+    return NULL;
+  }
+  return pEntry;
+}
+
+#ifdef __cplusplus
+}
+#endif
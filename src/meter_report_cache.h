@@ -0,0 +1,85 @@
+/***************************************************************************//**
+ * @file meter_report_cache.h
+ * @brief Pre-encoded answers to Meter Get
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_METER_REPORT_CACHE_H_
+#define AMS_METER_REPORT_CACHE_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+// The readings only change when the meter sends a new frame, yet a controller
+// may Get them many times in between. So the answer to each supported Get is
+// encoded once whenever the readings change, and a Get only has to look it up.
+
+// Endpoints 1 to 3 are the phases
+#define ENDPOINT_ENERGY_ESTIMATE 4
+
+#define METER_REPORT_MAX_SIZE 15 // 4-byte values with previous value and scale 2
+
+typedef struct {
+  uint8_t length;
+  uint8_t frame[METER_REPORT_MAX_SIZE];
+} meter_report_cache_entry_t;
+
+typedef enum {
+  METER_CACHE_KWH = 0,
+  METER_CACHE_W,
+  METER_CACHE_KWH_EXPORT,
+  METER_CACHE_W_EXPORT,
+  METER_CACHE_KVAH,
+  METER_CACHE_PF,
+  METER_CACHE_KVAR,
+  METER_CACHE_KVARH,
+  METER_CACHE_KVAR_EXPORT,
+  METER_CACHE_KVARH_EXPORT,
+  METER_CACHE_V_L1,
+  METER_CACHE_V_L2,
+  METER_CACHE_V_L3,
+  METER_CACHE_A_L1,
+  METER_CACHE_A_L2,
+  METER_CACHE_A_L3,
+  METER_CACHE_KWH_ESTIMATE,
+  METER_CACHE_COUNT
+} meter_report_cache_index_t;
+
+// Encoded whenever the readings change, by CC_Meter_refresh_report_cache()
+extern meter_report_cache_entry_t meter_report_cache[METER_CACHE_COUNT];
+
+// The answer to a Get of 'scale' and 'rate_type' on 'endpoint', NULL when the
+// endpoint doesn't support it, or there's no reading for it yet (an entry of
+// length 0). The default rate type is answered with import.
+const meter_report_cache_entry_t* meter_report_cache_lookup(uint8_t endpoint, uint8_t rate_type, uint8_t scale);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_METER_REPORT_CACHE_H_ */
@@ -0,0 +1,129 @@
+/***************************************************************************//**
+ * @file meter_value.c
+ * @brief Compact value fields of Meter Report V5
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#include "meter_value.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Frame bytes not sent thanks to the variable-size encoding
+static uint32_t meter_value_saved = 0;
+
+// Size in bytes of the smallest signed field which holds 'value'
+static uint8_t meter_value_size(int32_t value)
+{
+  if(value >= INT8_MIN && value <= INT8_MAX) {
+    return 1;
+  }
+  if(value >= INT16_MIN && value <= INT16_MAX) {
+    return 2;
+  }
+  return 4;
+}
+
+// Value and previous value share the size field
+static uint8_t meter_values_size(int32_t value, int32_t previous, bool has_previous)
+{
+  uint8_t size = meter_value_size(value);
+  if(has_previous && meter_value_size(previous) > size) {
+    size = meter_value_size(previous);
+  }
+  return size;
+}
+
+static uint8_t meter_put_value(uint8_t* pFrame, uint8_t size, int32_t value)
+{
+  for(uint8_t i = 0; i < size; i++) {
+    pFrame[i] = ((uint32_t)value >> (8 * (size - 1 - i))) & 0xFF;
+  }
+  return size;
+}
+
+// When the smaller field saves a size, trailing decimal zeros are dropped
+// from the precision, which loses nothing: 230.000 V is sent as 230.00 V.
+// Scales from 7 and up are sent as scale 7 with the remainder in Scale 2.
+uint8_t meter_value_encode(uint8_t* pFrame, uint8_t rate, uint8_t scale, uint8_t precision,
+                           int32_t value, int32_t previous, uint16_t delta_time_s)
+{
+  // The fields after the meter value move around depending on what's present,
+  // so build the frame byte by byte rather than through a fixed frame struct.
+  uint8_t length = 0;
+  uint8_t scale_bits = scale >= 0x7 ? 0x7 : scale;
+  bool has_previous = delta_time_s > 0;
+
+  uint8_t size = meter_values_size(value, previous, has_previous);
+
+  // Drop trailing decimal zeros for as long as they're there, and keep the
+  // first result that fits a smaller field
+  int32_t reduced = value;
+  int32_t reduced_previous = previous;
+  uint8_t reduced_precision = precision;
+  while(size > 1 && reduced_precision > 0 && reduced % 10 == 0 && reduced_previous % 10 == 0) {
+    reduced /= 10;
+    reduced_previous /= 10;
+    reduced_precision--;
+
+    uint8_t reduced_size = meter_values_size(reduced, reduced_previous, has_previous);
+    if(reduced_size < size) {
+      value = reduced;
+      previous = reduced_previous;
+      precision = reduced_precision;
+      size = reduced_size;
+    }
+  }
+
+  meter_value_saved += (4 - size) * (has_previous ? 2 : 1);
+
+  // Encode meter type
+  pFrame[length++] = 0x01 /* electric meter */ | ((rate << 5) & 0x60) | ((scale_bits << 5) & 0x80);
+  pFrame[length++] = ((precision & 0x7) << 5) | ((scale_bits & 0x3) << 3) | size;
+
+  length += meter_put_value(&pFrame[length], size, value);
+
+  pFrame[length++] = (delta_time_s >> 8) & 0xFF;
+  pFrame[length++] = delta_time_s & 0xFF;
+
+  if(has_previous) {
+    length += meter_put_value(&pFrame[length], size, previous);
+  }
+
+  if(scale >= 0x7) {
+    pFrame[length++] = scale - 0x7;
+  }
+  return length;
+}
+
+uint32_t meter_value_bytes_saved(void)
+{
+  return meter_value_saved;
+}
+
+#ifdef __cplusplus
+}
+#endif
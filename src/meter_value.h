@@ -0,0 +1,76 @@
+/***************************************************************************//**
+ * @file meter_value.h
+ * @brief Compact value fields of Meter Report V5
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_METER_VALUE_H_
+#define AMS_METER_VALUE_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Encodes what follows the command byte of a Meter Report V5: meter type and
+// rate, precision/scale/size, the value, delta time, the previous value and
+// scale 2. The value and the previous value go out in the smallest signed
+// field which holds both. Kept apart from the command class code so it can be
+// checked on the host.
+
+// Scales of an electric meter
+#define SCALE_KWH 0x0
+#define SCALE_KVAH 0x1
+#define SCALE_W 0x2
+#define SCALE_V 0x4
+#define SCALE_A 0x05
+#define SCALE_PF 0x06
+// Scales from 7 on go out in the scale 2 field
+#define SCALE_KVAR 0x07
+#define SCALE_KVARH 0x08
+
+#define RT_DEFAULT 0x0
+#define RT_IMPORT 0x1
+#define RT_EXPORT 0x2
+
+// Longest encoding: type, precision/scale/size, 4 byte value, delta time,
+// 4 byte previous value, scale 2
+#define METER_VALUE_MAX_LENGTH 13
+
+// Encode into pFrame, which must have room for METER_VALUE_MAX_LENGTH bytes.
+// A delta time of 0 means there's no previous value. Returns the length.
+uint8_t meter_value_encode(uint8_t* pFrame, uint8_t rate, uint8_t scale, uint8_t precision,
+                           int32_t value, int32_t previous, uint16_t delta_time_s);
+
+// Bytes not sent thanks to the variable-size fields, since startup
+uint32_t meter_value_bytes_saved(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_METER_VALUE_H_ */
@@ -0,0 +1,93 @@
+/***************************************************************************//**
+ * @file multi_cmd.c
+ * @brief Multi Command bundles and what they save
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#include "multi_cmd.h"
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// As in ZW_classcmd.h, which doesn't build without the rest of the SDK
+#define MULTI_CMD_COMMAND_CLASS 0x8F
+#define MULTI_CMD_ENCAPSULATED 0x01
+
+void multi_cmd_begin(multi_cmd_bundle_t* pBundle, uint8_t* pBuf, uint8_t capacity)
+{
+  pBundle->pBuf = pBuf;
+  pBundle->length = MULTI_CMD_HEADER_BYTES;
+  pBundle->capacity = capacity;
+  pBundle->individual_bytes = 0;
+  pBuf[0] = MULTI_CMD_COMMAND_CLASS;
+  pBuf[1] = MULTI_CMD_ENCAPSULATED;
+  pBuf[2] = 0;
+}
+
+bool multi_cmd_append(multi_cmd_bundle_t* pBundle, const uint8_t* pCmd, uint8_t cmdLength)
+{
+  if((size_t)pBundle->length + 1 + cmdLength > pBundle->capacity) {
+    return false;
+  }
+  pBundle->pBuf[pBundle->length] = cmdLength;
+  memcpy(&pBundle->pBuf[pBundle->length + 1], pCmd, cmdLength);
+  pBundle->length += 1 + cmdLength;
+  pBundle->pBuf[2]++;
+  pBundle->individual_bytes += cmdLength + FRAME_OVERHEAD_BYTES;
+  return true;
+}
+
+uint8_t multi_cmd_count(const multi_cmd_bundle_t* pBundle)
+{
+  return pBundle->pBuf[2];
+}
+
+uint8_t multi_cmd_finish(multi_cmd_bundle_t* pBundle, multi_cmd_stats_t* pStats)
+{
+  uint8_t count = pBundle->pBuf[2];
+
+  if(count == 0) {
+    return 0;
+  }
+
+  if(count == 1) {
+    uint8_t cmdLength = pBundle->pBuf[MULTI_CMD_HEADER_BYTES];
+    memmove(pBundle->pBuf, &pBundle->pBuf[MULTI_CMD_HEADER_BYTES + 1], cmdLength);
+    return cmdLength;
+  }
+
+  if(pStats != NULL) {
+    pStats->bundles_sent++;
+    pStats->frames_saved += count - 1;
+    pStats->bytes_saved += pBundle->individual_bytes - (pBundle->length + FRAME_OVERHEAD_BYTES);
+  }
+  return pBundle->length;
+}
+
+#ifdef __cplusplus
+}
+#endif
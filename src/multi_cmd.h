@@ -0,0 +1,83 @@
+/***************************************************************************//**
+ * @file multi_cmd.h
+ * @brief Multi Command bundles and what they save
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_MULTI_CMD_H_
+#define AMS_MULTI_CMD_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "frame_cost.h"
+
+// Puts a number of commands in one Multi Command Encapsulated frame, and keeps
+// count of the frames and bytes that saves. Kept apart from the command class
+// code so the accounting can be checked on the host.
+
+// Same as for the configuration parameter strings and bulk reports: what fits
+// a frame without Transport Service
+#define MULTI_CMD_MAX_PAYLOAD 39
+// Command class, command and number of commands
+#define MULTI_CMD_HEADER_BYTES 3
+
+typedef struct {
+  uint8_t* pBuf;
+  uint8_t length;
+  uint8_t capacity;
+  uint16_t individual_bytes; // the same commands as frames of their own
+} multi_cmd_bundle_t;
+
+typedef struct {
+  uint32_t bundles_sent;
+  uint32_t frames_saved;
+  uint32_t bytes_saved;
+} multi_cmd_stats_t;
+
+// Start an empty bundle in pBuf, which never grows beyond 'capacity' bytes
+void multi_cmd_begin(multi_cmd_bundle_t* pBundle, uint8_t* pBuf, uint8_t capacity);
+
+// Append one command. Returns false, and leaves the bundle as it was, if the
+// command doesn't fit.
+bool multi_cmd_append(multi_cmd_bundle_t* pBundle, const uint8_t* pCmd, uint8_t cmdLength);
+
+// Number of commands in the bundle so far
+uint8_t multi_cmd_count(const multi_cmd_bundle_t* pBundle);
+
+// Close the bundle and return the length of the frame, 0 when it's empty. A
+// bundle of one is just overhead, so that leaves the command as it is in pBuf.
+// What a real bundle saved is added to pStats, unless that's NULL.
+uint8_t multi_cmd_finish(multi_cmd_bundle_t* pBundle, multi_cmd_stats_t* pStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_MULTI_CMD_H_ */
@@ -25,6 +25,7 @@
  *
  *******************************************************************************/
 #include "readings.h"
+#include "report_policy.h"
 #include <stddef.h>
 
 #ifdef __cplusplus
@@ -33,6 +34,9 @@ extern "C"
 #endif
 
 uint32_t active_power_watt = 0;
+uint32_t active_power_export_watt = 0;
+uint32_t reactive_power_import_var = 0;
+uint32_t reactive_power_export_var = 0;
 uint32_t last_reported_power_watt = 0;
 
 char meter_type[16] = {0};
@@ -49,6 +53,12 @@ int32_t current_l3 = 0;
 
 uint32_t total_meter_reading = 0;
 uint32_t meter_offset = 0;
+// export (production) register, with an offset of its own
+uint32_t total_export_reading = 0;
+uint32_t export_offset = 0;
+// reactive registers, in varh. These aren't affected by a meter reset.
+uint32_t total_reactive_import_reading = 0;
+uint32_t total_reactive_export_reading = 0;
 uint64_t last_total_reading_timestamp = 0;
 
 // list1 received = active power valid
@@ -59,6 +69,110 @@ bool is_3phase = false;
 // list3 received = total meter reading and time/date valid
 bool list3_recv = false;
 
+/* Snapshot for warm starts
+ *
+ * Lives in a section which the startup code doesn't zero or initialise, so its
+ * contents survive a reset as long as the RAM stays powered. Whether what's in
+ * there is a valid snapshot is determined by the magic and CRC, whether it is
+ * still relevant by its timestamp.
+ */
+#define READINGS_SNAPSHOT_MAGIC 0x414D5333UL // 'AMS3'
+
+typedef struct {
+  uint32_t magic;
+  uint32_t timestamp;
+  uint32_t active_power_watt;
+  uint32_t active_power_export_watt;
+  uint32_t reactive_power_import_var;
+  uint32_t reactive_power_export_var;
+  uint32_t last_reported_power_watt;
+  uint32_t voltage_l1;
+  uint32_t voltage_l2;
+  uint32_t voltage_l3;
+  int32_t current_l1;
+  int32_t current_l2;
+  int32_t current_l3;
+  bool list1_recv;
+  bool list2_recv;
+  bool is_3phase;
+  report_policy_retained_t policy[METRIC_COUNT];
+  uint16_t crc;
+} readings_snapshot_t;
+
+static readings_snapshot_t retained_snapshot __attribute__((section(".noinit")));
+
+// CRC-16/CCITT-FALSE over everything preceding the CRC field
+static uint16_t readings_snapshot_crc(const readings_snapshot_t* snapshot)
+{
+  const uint8_t* data = (const uint8_t*)snapshot;
+  uint16_t crc = 0xFFFF;
+  for(size_t i = 0; i < offsetof(readings_snapshot_t, crc); i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for(size_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+void readings_retain(uint32_t timestamp, uint32_t now_ms)
+{
+  retained_snapshot.magic = READINGS_SNAPSHOT_MAGIC;
+  retained_snapshot.timestamp = timestamp;
+  retained_snapshot.active_power_watt = active_power_watt;
+  retained_snapshot.active_power_export_watt = active_power_export_watt;
+  retained_snapshot.reactive_power_import_var = reactive_power_import_var;
+  retained_snapshot.reactive_power_export_var = reactive_power_export_var;
+  retained_snapshot.last_reported_power_watt = last_reported_power_watt;
+  retained_snapshot.voltage_l1 = voltage_l1;
+  retained_snapshot.voltage_l2 = voltage_l2;
+  retained_snapshot.voltage_l3 = voltage_l3;
+  retained_snapshot.current_l1 = current_l1;
+  retained_snapshot.current_l2 = current_l2;
+  retained_snapshot.current_l3 = current_l3;
+  retained_snapshot.list1_recv = list1_recv;
+  retained_snapshot.list2_recv = list2_recv;
+  retained_snapshot.is_3phase = is_3phase;
+  report_policy_retain(retained_snapshot.policy, now_ms);
+  retained_snapshot.crc = readings_snapshot_crc(&retained_snapshot);
+}
+
+bool readings_restore(uint32_t now, uint32_t max_age, uint32_t ticks_per_s, uint32_t now_ms)
+{
+  bool valid = retained_snapshot.magic == READINGS_SNAPSHOT_MAGIC &&
+               retained_snapshot.crc == readings_snapshot_crc(&retained_snapshot) &&
+               now >= retained_snapshot.timestamp &&
+               (now - retained_snapshot.timestamp) <= max_age;
+
+  // Whatever happens, don't pick this snapshot up again on a later reset
+  retained_snapshot.magic = 0;
+
+  if(!valid) {
+    return false;
+  }
+
+  active_power_watt = retained_snapshot.active_power_watt;
+  active_power_export_watt = retained_snapshot.active_power_export_watt;
+  reactive_power_import_var = retained_snapshot.reactive_power_import_var;
+  reactive_power_export_var = retained_snapshot.reactive_power_export_var;
+  last_reported_power_watt = retained_snapshot.last_reported_power_watt;
+  voltage_l1 = retained_snapshot.voltage_l1;
+  voltage_l2 = retained_snapshot.voltage_l2;
+  voltage_l3 = retained_snapshot.voltage_l3;
+  current_l1 = retained_snapshot.current_l1;
+  current_l2 = retained_snapshot.current_l2;
+  current_l3 = retained_snapshot.current_l3;
+  list1_recv = retained_snapshot.list1_recv;
+  list2_recv = retained_snapshot.list2_recv;
+  is_3phase = retained_snapshot.is_3phase;
+
+  // The policy clock started over, and was stopped for as long as it took to
+  // get here
+  uint32_t elapsed_ms = (uint32_t)((uint64_t)(now - retained_snapshot.timestamp) * 1000 / ticks_per_s);
+  report_policy_restore(retained_snapshot.policy, now_ms - elapsed_ms);
+  return true;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -37,6 +37,9 @@ extern "C"
 #include <stdbool.h>
 
 extern uint32_t active_power_watt;
+extern uint32_t active_power_export_watt;
+extern uint32_t reactive_power_import_var;
+extern uint32_t reactive_power_export_var;
 extern uint32_t last_reported_power_watt;
 
 extern char meter_id[20];
@@ -50,6 +53,10 @@ extern int32_t current_l3;
 
 extern uint32_t total_meter_reading;
 extern uint32_t meter_offset;
+extern uint32_t total_export_reading;
+extern uint32_t export_offset;
+extern uint32_t total_reactive_import_reading;
+extern uint32_t total_reactive_export_reading;
 extern uint64_t last_total_reading_timestamp;
 
 // list1 received = active power valid
@@ -60,6 +67,18 @@ extern bool is_3phase;
 // list3 received = total meter reading and time/date valid
 extern bool list3_recv;
 
+// Save the readings and reporting state into RAM which survives a soft or
+// watchdog reset. 'timestamp' is a free-running counter which keeps counting
+// across such a reset, used to judge the freshness of the snapshot later.
+// 'now_ms' is the clock the reporting policy runs on.
+void readings_retain(uint32_t timestamp, uint32_t now_ms);
+
+// Restore the readings and reporting state saved by readings_retain, if the
+// snapshot is intact and no older than max_age (in units of 'timestamp', which
+// counts 'ticks_per_s' per second). Returns true when the readings were
+// restored (warm start).
+bool readings_restore(uint32_t now, uint32_t max_age, uint32_t ticks_per_s, uint32_t now_ms);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,153 @@
+/***************************************************************************//**
+ * @file report_backlog.c
+ * @brief Store-and-forward of meter reports which didn't get through
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#include "report_backlog.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+static struct {
+  report_backlog_entry_t entries[REPORT_BACKLOG_SIZE];
+  uint8_t first;
+  uint8_t count;
+} backlog;
+
+static report_backlog_counters_t backlog_counters;
+
+static report_backlog_entry_t* report_backlog_at(uint8_t index)
+{
+  return &backlog.entries[(backlog.first + index) % REPORT_BACKLOG_SIZE];
+}
+
+static void report_backlog_remove(uint8_t count)
+{
+  backlog.first = (backlog.first + count) % REPORT_BACKLOG_SIZE;
+  backlog.count -= count;
+}
+
+bool report_backlog_push(const report_backlog_entry_t* pEntry)
+{
+  for(uint8_t i = 0; i < backlog.count; i++) {
+    const report_backlog_entry_t* pOther = report_backlog_at(i);
+    if(pOther->metric == pEntry->metric &&
+       pOther->rate == pEntry->rate &&
+       pOther->timestamp_s == pEntry->timestamp_s &&
+       pOther->value == pEntry->value) {
+      return false;
+    }
+  }
+
+  if(backlog.count == REPORT_BACKLOG_SIZE) {
+    // Make way by dropping the oldest report of the same metric, so a stream
+    // of power reports doesn't push out the hourly energy readings
+    uint8_t victim = 0;
+    for(uint8_t i = 0; i < backlog.count; i++) {
+      if(report_backlog_at(i)->metric == pEntry->metric) {
+        victim = i;
+        break;
+      }
+    }
+    for(uint8_t i = victim; i > 0; i--) {
+      *report_backlog_at(i) = *report_backlog_at(i - 1);
+    }
+    report_backlog_remove(1);
+    backlog_counters.overflowed++;
+  }
+
+  *report_backlog_at(backlog.count) = *pEntry;
+  backlog.count++;
+  backlog_counters.stored++;
+  return true;
+}
+
+uint8_t report_backlog_count(void)
+{
+  return backlog.count;
+}
+
+const report_backlog_entry_t* report_backlog_peek(uint8_t index)
+{
+  if(index >= backlog.count) {
+    return NULL;
+  }
+  return report_backlog_at(index);
+}
+
+void report_backlog_drop(uint8_t count)
+{
+  if(count > backlog.count) {
+    count = backlog.count;
+  }
+  report_backlog_remove(count);
+  backlog_counters.replayed += count;
+}
+
+void report_backlog_expire(uint32_t now_s, uint32_t max_age_s)
+{
+  while(backlog.count > 0 && now_s - report_backlog_at(0)->timestamp_s > max_age_s) {
+    report_backlog_remove(1);
+    backlog_counters.expired++;
+  }
+}
+
+void report_backlog_reset(void)
+{
+  backlog.first = 0;
+  backlog.count = 0;
+}
+
+const report_backlog_counters_t* report_backlog_counters(void)
+{
+  return &backlog_counters;
+}
+
+void report_backlog_save(report_backlog_image_t* pImage, uint32_t now_s)
+{
+  pImage->count = backlog.count;
+  for(uint8_t i = 0; i < backlog.count; i++) {
+    pImage->entries[i] = *report_backlog_at(i);
+    pImage->entries[i].timestamp_s = now_s - pImage->entries[i].timestamp_s;
+  }
+}
+
+// The time spent without power isn't known, so the reports come back as old
+// as they were when they were saved
+void report_backlog_load(const report_backlog_image_t* pImage, uint32_t now_s)
+{
+  for(uint8_t i = 0; i < pImage->count && i < REPORT_BACKLOG_SIZE; i++) {
+    report_backlog_entry_t entry = pImage->entries[i];
+    entry.timestamp_s = now_s - entry.timestamp_s;
+    report_backlog_push(&entry);
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
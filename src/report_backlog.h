@@ -0,0 +1,94 @@
+/***************************************************************************//**
+ * @file report_backlog.h
+ * @brief Store-and-forward of meter reports which didn't get through
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_REPORT_BACKLOG_H_
+#define AMS_REPORT_BACKLOG_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Reports which failed to reach the lifeline are kept here, oldest first,
+// until they can be replayed. When full, the oldest report of the same metric
+// makes way, or the oldest report if there is none.
+#define REPORT_BACKLOG_SIZE 32
+
+typedef struct {
+  uint8_t metric;       // report_metric_t
+  uint8_t rate;
+  uint8_t scale;
+  uint8_t precision;
+  int32_t value;
+  uint32_t timestamp_s; // when the value was reported, free-running seconds
+} report_backlog_entry_t;
+
+typedef struct {
+  uint32_t stored;
+  uint32_t replayed;
+  uint32_t overflowed;  // pushed out by newer reports
+  uint32_t expired;     // too old to replay
+} report_backlog_counters_t;
+
+// Image of the backlog for keeping it in NVM, with ages instead of timestamps
+typedef struct {
+  uint8_t count;
+  report_backlog_entry_t entries[REPORT_BACKLOG_SIZE];
+} report_backlog_image_t;
+
+// Keep a failed report. Returns false when the same report is in there
+// already, e.g. because it failed for more than one destination.
+bool report_backlog_push(const report_backlog_entry_t* pEntry);
+
+// Amount of reports waiting
+uint8_t report_backlog_count(void);
+
+// Report 'index' in line, 0 being the oldest
+const report_backlog_entry_t* report_backlog_peek(uint8_t index);
+
+// Remove the 'count' oldest reports after they have been replayed
+void report_backlog_drop(uint8_t count);
+
+// Remove reports older than 'max_age_s'
+void report_backlog_expire(uint32_t now_s, uint32_t max_age_s);
+
+// Forget all reports, e.g. when they belong to another meter
+void report_backlog_reset(void);
+
+const report_backlog_counters_t* report_backlog_counters(void);
+
+void report_backlog_save(report_backlog_image_t* pImage, uint32_t now_s);
+void report_backlog_load(const report_backlog_image_t* pImage, uint32_t now_s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_REPORT_BACKLOG_H_ */
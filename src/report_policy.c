@@ -0,0 +1,337 @@
+/***************************************************************************//**
+ * @file report_policy.c
+ * @brief Per-metric policy deciding when a reading is worth a report
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+#include "report_policy.h"
+#include "CC_Configuration.h"
+#include "tx_feedback.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Readings arrive on the meter's clock, give or take a bit of jitter. Without
+// some slack, a 30s heartbeat evaluated every 10s would occasionally slip to
+// 40s because the third frame came in a few ms early.
+#define REPORT_POLICY_HEARTBEAT_SLACK_MS 1000
+
+// An equal value reported within this time is considered the same report
+#define REPORT_POLICY_SAME_REPORT_MS 1000
+
+typedef struct {
+  bool has_reported;
+  int32_t last_value;
+  uint32_t last_report_ms;
+  bool has_previous;
+  int32_t previous_value;
+  uint32_t previous_report_ms;
+  uint8_t tokens;
+  uint32_t last_refill_ms;
+  report_policy_counters_t counters;
+} report_policy_state_t;
+
+static report_policy_state_t policy_state[METRIC_COUNT];
+
+void report_policy_config(report_metric_t metric, report_policy_config_t* pConfig)
+{
+  const SConfigurationData* cfg = &CC_ConfigurationData;
+
+  switch(metric) {
+    case METRIC_POWER:
+    case METRIC_REACTIVE_POWER:
+      // Parameters 1 and 2 keep their original meaning
+      pConfig->heartbeat_ms = cfg->amount_of_10s_reports_for_meter_report * 10000UL;
+      pConfig->deadband_abs = cfg->power_change_for_meter_report * 100UL;
+      pConfig->min_interval_ms = cfg->power_min_interval * 1000UL;
+      pConfig->deadband_pct = cfg->power_deadband_pct;
+      pConfig->bucket_size = cfg->power_bucket_size;
+      pConfig->refill_ms = cfg->power_refill_interval * 1000UL;
+      break;
+    case METRIC_ENERGY:
+    case METRIC_ENERGY_EXPORT:
+    case METRIC_REACTIVE_ENERGY:
+    case METRIC_APPARENT_ENERGY:
+      pConfig->min_interval_ms = cfg->energy_min_interval * 1000UL;
+      pConfig->deadband_abs = cfg->energy_deadband_abs;
+      pConfig->deadband_pct = cfg->energy_deadband_pct;
+      pConfig->bucket_size = cfg->energy_bucket_size;
+      pConfig->refill_ms = cfg->energy_refill_interval * 1000UL;
+      pConfig->heartbeat_ms = cfg->energy_heartbeat * 1000UL;
+      // Parameter 3 asks for a report on every hourly reading
+      if(cfg->enable_hourly_report == 1) {
+        pConfig->heartbeat_ms = 1;
+      }
+      break;
+    case METRIC_VOLTAGE_L1:
+    case METRIC_VOLTAGE_L2:
+    case METRIC_VOLTAGE_L3:
+      pConfig->min_interval_ms = cfg->voltage_min_interval * 1000UL;
+      pConfig->deadband_abs = cfg->voltage_deadband_abs;
+      pConfig->deadband_pct = cfg->voltage_deadband_pct;
+      pConfig->bucket_size = cfg->voltage_bucket_size;
+      pConfig->refill_ms = cfg->voltage_refill_interval * 1000UL;
+      pConfig->heartbeat_ms = cfg->voltage_heartbeat * 1000UL;
+      break;
+    case METRIC_CURRENT_L1:
+    case METRIC_CURRENT_L2:
+    case METRIC_CURRENT_L3:
+      pConfig->min_interval_ms = cfg->current_min_interval * 1000UL;
+      pConfig->deadband_abs = cfg->current_deadband_abs;
+      pConfig->deadband_pct = cfg->current_deadband_pct;
+      pConfig->bucket_size = cfg->current_bucket_size;
+      pConfig->refill_ms = cfg->current_refill_interval * 1000UL;
+      pConfig->heartbeat_ms = cfg->current_heartbeat * 1000UL;
+      break;
+    case METRIC_ENERGY_ESTIMATE:
+      // Plain periodic report, the estimate only goes up anyway
+      *pConfig = (report_policy_config_t){0};
+      pConfig->min_interval_ms = cfg->energy_estimate_interval * 1000UL;
+      pConfig->heartbeat_ms = cfg->energy_estimate_interval * 1000UL;
+      break;
+    default:
+      *pConfig = (report_policy_config_t){0};
+      return;
+  }
+
+  // Report less often while the network is failing to deliver what we send
+  if(tx_feedback_backoff_level != 0) {
+    pConfig->min_interval_ms = tx_feedback_scale_interval(pConfig->min_interval_ms);
+    if(pConfig->refill_ms != 0) {
+      pConfig->refill_ms = tx_feedback_scale_interval(pConfig->refill_ms);
+    }
+    if(pConfig->heartbeat_ms != 0) {
+      pConfig->heartbeat_ms = tx_feedback_scale_interval(pConfig->heartbeat_ms);
+    }
+  }
+}
+
+static void report_policy_refill(report_policy_state_t* state,
+                                 const report_policy_config_t* config,
+                                 uint32_t now_ms)
+{
+  if(config->bucket_size == 0 || config->refill_ms == 0) {
+    state->tokens = config->bucket_size;
+    state->last_refill_ms = now_ms;
+    return;
+  }
+
+  uint32_t earned = (now_ms - state->last_refill_ms) / config->refill_ms;
+  if(state->tokens + earned >= config->bucket_size) {
+    state->tokens = config->bucket_size;
+    state->last_refill_ms = now_ms;
+  } else {
+    state->tokens += earned;
+    state->last_refill_ms += earned * config->refill_ms;
+  }
+}
+
+static bool report_policy_outside_deadband(const report_policy_state_t* state,
+                                           const report_policy_config_t* config,
+                                           int32_t value)
+{
+  int64_t diff = (int64_t)value - state->last_value;
+  uint64_t change = diff < 0 ? -diff : diff;
+
+  if(config->deadband_abs > 0 && change > config->deadband_abs) {
+    return true;
+  }
+
+  if(config->deadband_pct > 0) {
+    uint64_t reference = state->last_value < 0 ? -(int64_t)state->last_value : state->last_value;
+    if(change * 100 > reference * config->deadband_pct) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void report_policy_record(report_policy_state_t* state, int32_t value, uint32_t now_ms)
+{
+  state->has_previous = state->has_reported;
+  state->previous_value = state->last_value;
+  state->previous_report_ms = state->last_report_ms;
+  state->has_reported = true;
+  state->last_value = value;
+  state->last_report_ms = now_ms;
+  state->counters.reported++;
+}
+
+bool report_policy_evaluate(report_metric_t metric, int32_t value, uint32_t now_ms)
+{
+  if(metric >= METRIC_COUNT) {
+    return false;
+  }
+
+  report_policy_state_t* state = &policy_state[metric];
+  report_policy_config_t config;
+  report_policy_config(metric, &config);
+
+  // A metric without any trigger configured is not reported at all
+  if(config.heartbeat_ms == 0 && config.deadband_abs == 0 && config.deadband_pct == 0) {
+    return false;
+  }
+
+  state->counters.evaluated++;
+
+  if(!state->has_reported) {
+    // Nothing reported yet, so there's nothing to compare against
+    state->tokens = config.bucket_size;
+    state->last_refill_ms = now_ms;
+    if(config.bucket_size > 0) {
+      state->tokens--;
+    }
+    report_policy_record(state, value, now_ms);
+    return true;
+  }
+
+  uint32_t elapsed = now_ms - state->last_report_ms;
+  bool heartbeat = config.heartbeat_ms > 0 &&
+                   elapsed + REPORT_POLICY_HEARTBEAT_SLACK_MS >= config.heartbeat_ms;
+
+  if(!heartbeat && !report_policy_outside_deadband(state, &config, value)) {
+    state->counters.suppressed_deadband++;
+    return false;
+  }
+
+  if(elapsed < config.min_interval_ms) {
+    state->counters.suppressed_interval++;
+    return false;
+  }
+
+  // The rate limit is there to stop a noisy value from flooding the network.
+  // Heartbeats are scheduled by definition, so they don't need a token.
+  report_policy_refill(state, &config, now_ms);
+  if(!heartbeat && config.bucket_size > 0) {
+    if(state->tokens == 0) {
+      state->counters.suppressed_rate++;
+      return false;
+    }
+    state->tokens--;
+  }
+
+  if(heartbeat) {
+    state->counters.heartbeats++;
+  }
+  report_policy_record(state, value, now_ms);
+  return true;
+}
+
+void report_policy_reported(report_metric_t metric, int32_t value, uint32_t now_ms)
+{
+  if(metric >= METRIC_COUNT) {
+    return;
+  }
+
+  report_policy_state_t* state = &policy_state[metric];
+
+  // Already accounted for, when the policy itself decided on this report
+  if(state->has_reported && state->last_value == value &&
+     (now_ms - state->last_report_ms) < REPORT_POLICY_SAME_REPORT_MS) {
+    return;
+  }
+
+  if(!state->has_reported) {
+    report_policy_config_t config;
+    report_policy_config(metric, &config);
+    state->tokens = config.bucket_size;
+    state->last_refill_ms = now_ms;
+  }
+  report_policy_record(state, value, now_ms);
+}
+
+bool report_policy_previous_report(report_metric_t metric, int32_t* pValue, uint32_t* pDeltaMs)
+{
+  if(metric >= METRIC_COUNT || !policy_state[metric].has_previous) {
+    return false;
+  }
+
+  const report_policy_state_t* state = &policy_state[metric];
+  *pValue = state->previous_value;
+  *pDeltaMs = state->last_report_ms - state->previous_report_ms;
+  return true;
+}
+
+bool report_policy_last_report(report_metric_t metric, uint32_t now_ms, int32_t* pValue, uint32_t* pAgeMs)
+{
+  if(metric >= METRIC_COUNT || !policy_state[metric].has_reported) {
+    return false;
+  }
+
+  const report_policy_state_t* state = &policy_state[metric];
+  *pValue = state->last_value;
+  *pAgeMs = now_ms - state->last_report_ms;
+  return true;
+}
+
+void report_policy_reset(void)
+{
+  for(size_t i = 0; i < METRIC_COUNT; i++) {
+    report_policy_counters_t counters = policy_state[i].counters;
+    policy_state[i] = (report_policy_state_t){0};
+    policy_state[i].counters = counters;
+  }
+}
+
+void report_policy_retain(report_policy_retained_t retained[METRIC_COUNT], uint32_t now_ms)
+{
+  for(size_t i = 0; i < METRIC_COUNT; i++) {
+    const report_policy_state_t* state = &policy_state[i];
+    retained[i].has_reported = state->has_reported;
+    retained[i].last_value = state->last_value;
+    retained[i].report_age_ms = now_ms - state->last_report_ms;
+    retained[i].refill_age_ms = now_ms - state->last_refill_ms;
+    retained[i].tokens = state->tokens;
+  }
+}
+
+void report_policy_restore(const report_policy_retained_t retained[METRIC_COUNT], uint32_t then_ms)
+{
+  report_policy_reset();
+  for(size_t i = 0; i < METRIC_COUNT; i++) {
+    report_policy_state_t* state = &policy_state[i];
+    // The report before the last one isn't kept, so the first report after a
+    // warm start goes out without history
+    state->has_reported = retained[i].has_reported;
+    state->last_value = retained[i].last_value;
+    state->last_report_ms = then_ms - retained[i].report_age_ms;
+    state->last_refill_ms = then_ms - retained[i].refill_age_ms;
+    state->tokens = retained[i].tokens;
+  }
+}
+
+const report_policy_counters_t* report_policy_counters(report_metric_t metric)
+{
+  if(metric >= METRIC_COUNT) {
+    return NULL;
+  }
+  return &policy_state[metric].counters;
+}
+
+#ifdef __cplusplus
+}
+#endif
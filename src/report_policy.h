@@ -0,0 +1,125 @@
+/***************************************************************************//**
+ * @file report_policy.h
+ * @brief Per-metric policy deciding when a reading is worth a report
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_REPORT_POLICY_H_
+#define AMS_REPORT_POLICY_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Everything we can report unsolicited to the lifeline
+typedef enum {
+  METRIC_POWER = 0,
+  METRIC_ENERGY,
+  METRIC_VOLTAGE_L1,
+  METRIC_VOLTAGE_L2,
+  METRIC_VOLTAGE_L3,
+  METRIC_CURRENT_L1,
+  METRIC_CURRENT_L2,
+  METRIC_CURRENT_L3,
+  METRIC_ENERGY_ESTIMATE,
+  METRIC_ENERGY_EXPORT,
+  METRIC_REACTIVE_POWER,
+  METRIC_REACTIVE_ENERGY,
+  METRIC_APPARENT_ENERGY,
+  METRIC_COUNT
+} report_metric_t;
+
+// Policy for one metric. A value of 0 disables the respective rule.
+typedef struct {
+  uint32_t min_interval_ms; // never report more often than this
+  uint32_t deadband_abs;    // report when the value moved more than this...
+  uint8_t deadband_pct;     // ...or more than this percentage of the last report
+  uint8_t bucket_size;      // token bucket: amount of reports allowed in a burst
+  uint32_t refill_ms;       // token bucket: time to earn back one report
+  uint32_t heartbeat_ms;    // report at least this often, even without change
+} report_policy_config_t;
+
+// The state of one metric as kept across a warm start, with its times as ages
+// at the moment the snapshot was taken
+typedef struct {
+  int32_t last_value;
+  uint32_t report_age_ms;
+  uint32_t refill_age_ms;
+  uint8_t tokens;
+  bool has_reported;
+} report_policy_retained_t;
+
+typedef struct {
+  uint32_t evaluated;
+  uint32_t reported;
+  uint32_t heartbeats;
+  uint32_t suppressed_deadband;
+  uint32_t suppressed_interval;
+  uint32_t suppressed_rate;
+} report_policy_counters_t;
+
+// Decide whether a new reading of 'metric' should be reported now. When this
+// returns true, the report is accounted for: the caller has to send it.
+// 'now_ms' is a free-running millisecond counter, allowed to wrap.
+bool report_policy_evaluate(report_metric_t metric, int32_t value, uint32_t now_ms);
+
+// Account for a report of 'metric' which was sent outside of the policy, e.g.
+// as part of a snapshot, such that deadband and heartbeat start over from it.
+// Reports the policy itself decided on just before are not counted twice.
+void report_policy_reported(report_metric_t metric, int32_t value, uint32_t now_ms);
+
+// The report before the most recent one, and the time between the two. This
+// is the history to include in the report the policy just decided on.
+bool report_policy_previous_report(report_metric_t metric, int32_t* pValue, uint32_t* pDeltaMs);
+
+// The most recent report, and the time since. This is the history to include
+// when answering a Get.
+bool report_policy_last_report(report_metric_t metric, uint32_t now_ms, int32_t* pValue, uint32_t* pAgeMs);
+
+// Forget all report history, e.g. when the readings belong to another meter
+void report_policy_reset(void);
+
+// Take a snapshot of the state of all metrics at 'now_ms'
+void report_policy_retain(report_policy_retained_t retained[METRIC_COUNT], uint32_t now_ms);
+
+// Pick up the state from a snapshot again. 'then_ms' is the time the snapshot
+// was taken, on the clock 'now_ms' runs on from here on, and may well be
+// before it started counting.
+void report_policy_restore(const report_policy_retained_t retained[METRIC_COUNT], uint32_t then_ms);
+
+// Running statistics of the decisions taken for 'metric'
+const report_policy_counters_t* report_policy_counters(report_metric_t metric);
+
+// Fill in the currently configured policy for 'metric'
+void report_policy_config(report_metric_t metric, report_policy_config_t* pConfig);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_REPORT_POLICY_H_ */
@@ -0,0 +1,141 @@
+/***************************************************************************//**
+ * @file report_queue.c
+ * @brief Last-value-wins slots for reports waiting to go out
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+#include "report_queue.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum {
+  SLOT_EMPTY = 0,
+  SLOT_QUEUED,  // waiting for its first transmission
+  SLOT_SENDING, // handed to at least one destination, more may follow
+} report_slot_state_t;
+
+typedef struct {
+  report_slot_state_t state;
+  int32_t value;
+  uint32_t posted_ms;
+  report_queue_counters_t counters;
+} report_slot_t;
+
+static report_slot_t slots[REPORT_QUEUE_SLOTS];
+
+// How long a report stays worth sending. Power is read every 2.5s and goes
+// stale quickly, voltage and current every 10s. The hourly energy reading is
+// valid until the next one, so it never expires here.
+static uint32_t report_queue_deadline_ms(uint8_t slot)
+{
+  switch(slot) {
+    case METRIC_POWER:
+    case REPORT_QUEUE_SNAPSHOT:
+      return 15000;
+    case METRIC_VOLTAGE_L1:
+    case METRIC_VOLTAGE_L2:
+    case METRIC_VOLTAGE_L3:
+    case METRIC_CURRENT_L1:
+    case METRIC_CURRENT_L2:
+    case METRIC_CURRENT_L3:
+    case METRIC_REACTIVE_POWER:
+      return 30000;
+    case METRIC_ENERGY_ESTIMATE:
+      return 60000;
+    default:
+      return 0;
+  }
+}
+
+bool report_queue_post(uint8_t slot, int32_t value, uint32_t now_ms)
+{
+  if(slot >= REPORT_QUEUE_SLOTS) {
+    return false;
+  }
+
+  report_slot_t* pSlot = &slots[slot];
+  bool schedule = (pSlot->state != SLOT_QUEUED);
+
+  if(!schedule) {
+    pSlot->counters.superseded++;
+  }
+
+  pSlot->state = SLOT_QUEUED;
+  pSlot->value = value;
+  pSlot->posted_ms = now_ms;
+  pSlot->counters.posted++;
+  return schedule;
+}
+
+bool report_queue_take(uint8_t slot, uint32_t now_ms, int32_t* pValue)
+{
+  if(slot >= REPORT_QUEUE_SLOTS || slots[slot].state == SLOT_EMPTY) {
+    return false;
+  }
+
+  report_slot_t* pSlot = &slots[slot];
+  uint32_t deadline_ms = report_queue_deadline_ms(slot);
+
+  if(deadline_ms != 0 && (uint32_t)(now_ms - pSlot->posted_ms) > deadline_ms) {
+    pSlot->state = SLOT_EMPTY;
+    pSlot->counters.expired++;
+    return false;
+  }
+
+  if(pSlot->state == SLOT_QUEUED) {
+    pSlot->state = SLOT_SENDING;
+    pSlot->counters.sent++;
+  }
+  *pValue = pSlot->value;
+  return true;
+}
+
+void report_queue_cancel(uint8_t slot)
+{
+  if(slot < REPORT_QUEUE_SLOTS) {
+    slots[slot].state = SLOT_EMPTY;
+  }
+}
+
+void report_queue_reset(void)
+{
+  for(size_t i = 0; i < REPORT_QUEUE_SLOTS; i++) {
+    slots[i].state = SLOT_EMPTY;
+  }
+}
+
+const report_queue_counters_t* report_queue_counters(uint8_t slot)
+{
+  if(slot >= REPORT_QUEUE_SLOTS) {
+    return NULL;
+  }
+  return &slots[slot].counters;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,74 @@
+/***************************************************************************//**
+ * @file report_queue.h
+ * @brief Last-value-wins slots for reports waiting to go out
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_REPORT_QUEUE_H_
+#define AMS_REPORT_QUEUE_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "report_policy.h"
+
+// One slot per metric, plus one for the bundled snapshot
+#define REPORT_QUEUE_SNAPSHOT METRIC_COUNT
+#define REPORT_QUEUE_SLOTS (METRIC_COUNT + 1)
+
+typedef struct {
+  uint32_t posted;
+  uint32_t sent;
+  uint32_t superseded;
+  uint32_t expired;
+} report_queue_counters_t;
+
+// Queue a report of 'value' in 'slot'. If an older report is still waiting
+// there, it is replaced and this returns false: the transmission already
+// scheduled for it will carry the new value. Returns true when the caller
+// needs to schedule a transmission.
+bool report_queue_post(uint8_t slot, int32_t value, uint32_t now_ms);
+
+// Fetch the value to transmit from 'slot'. Returns false when there is
+// nothing to send, either because the slot is empty or because its report
+// became older than the freshness deadline of the slot.
+bool report_queue_take(uint8_t slot, uint32_t now_ms, int32_t* pValue);
+
+// Give up on the report in 'slot', e.g. because it couldn't be scheduled
+void report_queue_cancel(uint8_t slot);
+
+// Empty all slots
+void report_queue_reset(void);
+
+const report_queue_counters_t* report_queue_counters(uint8_t slot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_REPORT_QUEUE_H_ */
@@ -0,0 +1,186 @@
+/***************************************************************************//**
+ * @file signal_filter.c
+ * @brief Fixed-point filters between the meter readings and the report decisions
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#include "signal_filter.h"
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Fractional bits of the EWMA accumulator
+#define EWMA_FRACTION_BITS 8
+
+typedef struct {
+  bool primed;
+  int32_t window[SIGNAL_FILTER_MEDIAN_MAX];
+  uint8_t window_fill;
+  uint8_t window_next;
+  int64_t ewma;
+  int32_t output;
+  signal_filter_stats_t stats;
+} signal_filter_state_t;
+
+static signal_filter_config_t filter_config = {
+  .median_size = 1,
+  .ewma_shift = 0,
+  .hysteresis_pct = 0,
+};
+
+static signal_filter_state_t filters[SIGNAL_FILTER_CHANNEL_COUNT];
+
+void signal_filter_reset(void)
+{
+  memset(filters, 0, sizeof(filters));
+}
+
+void signal_filter_configure(const signal_filter_config_t* pConfig)
+{
+  signal_filter_config_t config = *pConfig;
+
+  // An even window has no middle, round it up
+  if(config.median_size < 1) {
+    config.median_size = 1;
+  }
+  if(config.median_size > SIGNAL_FILTER_MEDIAN_MAX) {
+    config.median_size = SIGNAL_FILTER_MEDIAN_MAX;
+  }
+  config.median_size |= 1;
+
+  if(memcmp(&config, &filter_config, sizeof(config)) != 0) {
+    filter_config = config;
+    signal_filter_reset();
+  }
+}
+
+// Median of what the window holds so far, by insertion sort of a copy. The
+// window is at most SIGNAL_FILTER_MEDIAN_MAX long, so this is bounded.
+static int32_t signal_filter_median(signal_filter_state_t* pFilter, int32_t value)
+{
+  pFilter->window[pFilter->window_next] = value;
+  pFilter->window_next = (pFilter->window_next + 1) % filter_config.median_size;
+  if(pFilter->window_fill < filter_config.median_size) {
+    pFilter->window_fill++;
+  }
+
+  int32_t sorted[SIGNAL_FILTER_MEDIAN_MAX];
+  for(uint8_t i = 0; i < pFilter->window_fill; i++) {
+    int32_t v = pFilter->window[i];
+    uint8_t j = i;
+    while(j > 0 && sorted[j - 1] > v) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = v;
+  }
+  return sorted[pFilter->window_fill / 2];
+}
+
+static int32_t signal_filter_ewma(signal_filter_state_t* pFilter, int32_t value)
+{
+  int64_t scaled = (int64_t)value * (1 << EWMA_FRACTION_BITS);
+  if(!pFilter->primed) {
+    pFilter->ewma = scaled;
+  } else {
+    pFilter->ewma += (scaled - pFilter->ewma) / (1 << filter_config.ewma_shift);
+  }
+
+  // Round to nearest, away from zero on a tie
+  int64_t half = 1 << (EWMA_FRACTION_BITS - 1);
+  int64_t rounded = pFilter->ewma >= 0 ? pFilter->ewma + half : pFilter->ewma - half;
+  return (int32_t)(rounded / (1 << EWMA_FRACTION_BITS));
+}
+
+static uint32_t signal_filter_distance(int32_t a, int32_t b)
+{
+  return a > b ? (uint32_t)((int64_t)a - b) : (uint32_t)((int64_t)b - a);
+}
+
+int32_t signal_filter_add(signal_filter_channel_t channel, int32_t value)
+{
+  if(channel >= SIGNAL_FILTER_CHANNEL_COUNT) {
+    return value;
+  }
+  signal_filter_state_t* pFilter = &filters[channel];
+
+  int32_t filtered = value;
+  if(filter_config.median_size > 1) {
+    filtered = signal_filter_median(pFilter, filtered);
+  }
+  if(filter_config.ewma_shift > 0) {
+    filtered = signal_filter_ewma(pFilter, filtered);
+  }
+
+  if(!pFilter->primed) {
+    pFilter->output = filtered;
+    pFilter->primed = true;
+  } else if(filtered != pFilter->output) {
+    // Hold the output until the filtered value has moved far enough from it
+    uint32_t band = 0;
+    if(filter_config.hysteresis_pct > 0) {
+      band = signal_filter_distance(pFilter->output, 0) / 100 * filter_config.hysteresis_pct;
+      if(band == 0) {
+        band = 1;
+      }
+    }
+    if(signal_filter_distance(filtered, pFilter->output) > band) {
+      pFilter->output = filtered;
+      pFilter->stats.output_changes++;
+    }
+  }
+
+  uint32_t error = signal_filter_distance(pFilter->output, value);
+  pFilter->stats.samples++;
+  pFilter->stats.total_error += error;
+  if(error > pFilter->stats.max_error) {
+    pFilter->stats.max_error = error;
+  }
+
+  return pFilter->output;
+}
+
+bool signal_filter_output(signal_filter_channel_t channel, int32_t* pValue)
+{
+  if(channel >= SIGNAL_FILTER_CHANNEL_COUNT || !filters[channel].primed) {
+    return false;
+  }
+  *pValue = filters[channel].output;
+  return true;
+}
+
+const signal_filter_stats_t* signal_filter_stats(signal_filter_channel_t channel)
+{
+  if(channel >= SIGNAL_FILTER_CHANNEL_COUNT) {
+    return NULL;
+  }
+  return &filters[channel].stats;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,88 @@
+/***************************************************************************//**
+ * @file signal_filter.h
+ * @brief Fixed-point filters between the meter readings and the report decisions
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_SIGNAL_FILTER_H_
+#define AMS_SIGNAL_FILTER_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Noisy loads (induction hobs, compressors) make power and current jump around
+// from one reading to the next, which keeps triggering the change-based
+// reports. Each reading can go through a small filter chain before the
+// reporting policy gets to see it:
+//   median of the last N readings -> EWMA -> hysteresis
+// All integer arithmetic, at a constant cost per reading. A stage which is
+// configured off passes the reading through untouched.
+
+typedef enum {
+  SIGNAL_FILTER_POWER = 0,
+  SIGNAL_FILTER_CURRENT_L1,
+  SIGNAL_FILTER_CURRENT_L2,
+  SIGNAL_FILTER_CURRENT_L3,
+  SIGNAL_FILTER_CHANNEL_COUNT
+} signal_filter_channel_t;
+
+#define SIGNAL_FILTER_MEDIAN_MAX 7
+
+typedef struct {
+  uint8_t median_size;    // readings to take the median of, 1 = off
+  uint8_t ewma_shift;     // EWMA weight of a new reading is 1/2^n, 0 = off
+  uint8_t hysteresis_pct; // output only moves once the reading is this far off, 0 = off
+} signal_filter_config_t;
+
+typedef struct {
+  uint32_t samples;
+  uint32_t output_changes;  // times the output moved
+  uint32_t max_error;       // largest |output - reading| seen
+  uint64_t total_error;     // sum of |output - reading|, for the mean
+} signal_filter_stats_t;
+
+// Apply a configuration. Channels restart from scratch when it changed.
+void signal_filter_configure(const signal_filter_config_t* pConfig);
+
+// Forget all readings, e.g. when they belong to another meter
+void signal_filter_reset(void);
+
+// Feed a reading and get the filtered value back
+int32_t signal_filter_add(signal_filter_channel_t channel, int32_t value);
+
+// Latest filtered value. Returns false if the channel hasn't had any readings.
+bool signal_filter_output(signal_filter_channel_t channel, int32_t* pValue);
+
+const signal_filter_stats_t* signal_filter_stats(signal_filter_channel_t channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_SIGNAL_FILTER_H_ */
@@ -0,0 +1,283 @@
+/***************************************************************************//**
+ * @file statistics.c
+ * @brief Running statistics of the readings over fixed time windows
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+#include "statistics.h"
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+static const uint32_t window_length_ms[STATISTICS_WINDOW_COUNT] = {
+  60UL * 1000UL,
+  15UL * 60UL * 1000UL,
+  60UL * 60UL * 1000UL,
+};
+
+#if STATISTICS_ENABLE_P95
+/* P-square streaming quantile estimator (Jain & Chlamtac, 1985)
+ *
+ * Tracks five markers whose heights approximate the minimum, p/2, p, (1+p)/2
+ * quantiles and the maximum. Heights are kept in Q8 fixed point, the desired
+ * marker positions in Q16.
+ */
+#define P2_HEIGHT_SHIFT 8
+#define P2_POSITION_ONE (1L << 16)
+#define P2_P_Q16 ((int32_t)(0.95 * P2_POSITION_ONE))
+
+typedef struct {
+  int32_t height[5];
+  int32_t position[5];
+  int32_t desired[5];
+} p2_sketch_t;
+
+static const int32_t p2_increment[5] = {
+  0,
+  P2_P_Q16 / 2,
+  P2_P_Q16,
+  (P2_POSITION_ONE + P2_P_Q16) / 2,
+  P2_POSITION_ONE,
+};
+
+static void p2_sort_initial(p2_sketch_t* sketch)
+{
+  for(size_t i = 1; i < 5; i++) {
+    int32_t value = sketch->height[i];
+    size_t j = i;
+    while(j > 0 && sketch->height[j - 1] > value) {
+      sketch->height[j] = sketch->height[j - 1];
+      j--;
+    }
+    sketch->height[j] = value;
+  }
+
+  for(size_t i = 0; i < 5; i++) {
+    sketch->position[i] = i;
+  }
+  sketch->desired[0] = 0;
+  sketch->desired[1] = 2 * P2_P_Q16;
+  sketch->desired[2] = 4 * P2_P_Q16;
+  sketch->desired[3] = 2 * P2_POSITION_ONE + 2 * P2_P_Q16;
+  sketch->desired[4] = 4 * P2_POSITION_ONE;
+}
+
+static int32_t p2_parabolic(const p2_sketch_t* s, size_t i, int32_t d)
+{
+  int64_t n_below = s->position[i] - s->position[i - 1];
+  int64_t n_above = s->position[i + 1] - s->position[i];
+  int64_t q_below = s->height[i] - s->height[i - 1];
+  int64_t q_above = s->height[i + 1] - s->height[i];
+
+  int64_t step = ((n_below + d) * q_above / n_above +
+                  (n_above - d) * q_below / n_below) * d / (n_below + n_above);
+  return s->height[i] + (int32_t)step;
+}
+
+static int32_t p2_linear(const p2_sketch_t* s, size_t i, int32_t d)
+{
+  return s->height[i] + d * (s->height[i + d] - s->height[i]) /
+                        (s->position[i + d] - s->position[i]);
+}
+
+// 'count' is the amount of samples including this one
+static void p2_add(p2_sketch_t* sketch, uint32_t count, int32_t value)
+{
+  int32_t x = value * (1L << P2_HEIGHT_SHIFT);
+
+  if(count <= 5) {
+    sketch->height[count - 1] = x;
+    if(count == 5) {
+      p2_sort_initial(sketch);
+    }
+    return;
+  }
+
+  size_t k;
+  if(x < sketch->height[0]) {
+    sketch->height[0] = x;
+    k = 0;
+  } else if(x >= sketch->height[4]) {
+    sketch->height[4] = x;
+    k = 3;
+  } else {
+    k = 0;
+    while(k < 3 && x >= sketch->height[k + 1]) {
+      k++;
+    }
+  }
+
+  for(size_t i = k + 1; i < 5; i++) {
+    sketch->position[i]++;
+  }
+  for(size_t i = 0; i < 5; i++) {
+    sketch->desired[i] += p2_increment[i];
+  }
+
+  for(size_t i = 1; i < 4; i++) {
+    int32_t diff = sketch->desired[i] - sketch->position[i] * P2_POSITION_ONE;
+    if((diff >= P2_POSITION_ONE && sketch->position[i + 1] - sketch->position[i] > 1) ||
+       (diff <= -P2_POSITION_ONE && sketch->position[i - 1] - sketch->position[i] < -1)) {
+      int32_t d = diff > 0 ? 1 : -1;
+      int32_t candidate = p2_parabolic(sketch, i, d);
+      if(sketch->height[i - 1] < candidate && candidate < sketch->height[i + 1]) {
+        sketch->height[i] = candidate;
+      } else {
+        sketch->height[i] = p2_linear(sketch, i, d);
+      }
+      sketch->position[i] += d;
+    }
+  }
+}
+
+static int32_t p2_result(const p2_sketch_t* sketch, uint32_t count)
+{
+  if(count == 0) {
+    return 0;
+  }
+
+  if(count < 5) {
+    // Not enough samples for the markers yet, go by rank instead
+    int32_t sorted[4];
+    memcpy(sorted, sketch->height, count * sizeof(int32_t));
+    for(size_t i = 1; i < count; i++) {
+      int32_t value = sorted[i];
+      size_t j = i;
+      while(j > 0 && sorted[j - 1] > value) {
+        sorted[j] = sorted[j - 1];
+        j--;
+      }
+      sorted[j] = value;
+    }
+    return sorted[(count * 95 - 1) / 100] / (1L << P2_HEIGHT_SHIFT);
+  }
+
+  return sketch->height[2] / (1L << P2_HEIGHT_SHIFT);
+}
+#endif
+
+typedef struct {
+  bool started;
+  uint32_t start_ms;
+  uint32_t count;
+  int64_t sum;
+  int32_t min;
+  int32_t max;
+#if STATISTICS_ENABLE_P95
+  p2_sketch_t sketch;
+#endif
+  bool has_result;
+  statistics_result_t result;
+} statistics_accumulator_t;
+
+static statistics_accumulator_t accumulators[STATISTICS_METRIC_COUNT][STATISTICS_WINDOW_COUNT];
+
+statistics_result_t statistics_report;
+
+static void statistics_close_window(statistics_accumulator_t* acc)
+{
+  if(acc->count > 0) {
+    acc->result.count = acc->count;
+    acc->result.min = acc->min;
+    acc->result.max = acc->max;
+    acc->result.mean = (int32_t)(acc->sum / (int64_t)acc->count);
+#if STATISTICS_ENABLE_P95
+    acc->result.p95 = p2_result(&acc->sketch, acc->count);
+#else
+    acc->result.p95 = 0;
+#endif
+    acc->has_result = true;
+  }
+
+  acc->count = 0;
+  acc->sum = 0;
+}
+
+void statistics_add(statistics_metric_t metric, int32_t value, uint32_t now_ms)
+{
+  if(metric >= STATISTICS_METRIC_COUNT) {
+    return;
+  }
+
+  for(size_t w = 0; w < STATISTICS_WINDOW_COUNT; w++) {
+    statistics_accumulator_t* acc = &accumulators[metric][w];
+
+    if(!acc->started) {
+      acc->started = true;
+      acc->start_ms = now_ms;
+    } else if(now_ms - acc->start_ms >= window_length_ms[w]) {
+      statistics_close_window(acc);
+      // Stay on the window grid, unless we missed entire windows
+      uint32_t elapsed = now_ms - acc->start_ms;
+      if(elapsed < 2 * window_length_ms[w]) {
+        acc->start_ms += window_length_ms[w];
+      } else {
+        acc->start_ms = now_ms;
+      }
+    }
+
+    acc->count++;
+    acc->sum += value;
+    if(acc->count == 1 || value < acc->min) {
+      acc->min = value;
+    }
+    if(acc->count == 1 || value > acc->max) {
+      acc->max = value;
+    }
+#if STATISTICS_ENABLE_P95
+    p2_add(&acc->sketch, acc->count, value);
+#endif
+  }
+}
+
+bool statistics_get(statistics_metric_t metric, statistics_window_t window,
+                    statistics_result_t* pResult)
+{
+  if(metric >= STATISTICS_METRIC_COUNT || window >= STATISTICS_WINDOW_COUNT ||
+     !accumulators[metric][window].has_result) {
+    memset(pResult, 0, sizeof(*pResult));
+    return false;
+  }
+
+  *pResult = accumulators[metric][window].result;
+  return true;
+}
+
+void statistics_select(uint8_t metric, uint8_t window)
+{
+  statistics_get((statistics_metric_t)metric, (statistics_window_t)window, &statistics_report);
+}
+
+void statistics_reset(void)
+{
+  memset(accumulators, 0, sizeof(accumulators));
+  memset(&statistics_report, 0, sizeof(statistics_report));
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,94 @@
+/***************************************************************************//**
+ * @file statistics.h
+ * @brief Running statistics of the readings over fixed time windows
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_STATISTICS_H_
+#define AMS_STATISTICS_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Keep a 95th percentile estimate next to min/mean/max. Costs about 60 bytes
+// of RAM per metric and window.
+#ifndef STATISTICS_ENABLE_P95
+#define STATISTICS_ENABLE_P95 1
+#endif
+
+typedef enum {
+  STATISTICS_POWER = 0,
+  STATISTICS_VOLTAGE_L1,
+  STATISTICS_VOLTAGE_L2,
+  STATISTICS_VOLTAGE_L3,
+  STATISTICS_CURRENT_L1,
+  STATISTICS_CURRENT_L2,
+  STATISTICS_CURRENT_L3,
+  STATISTICS_METRIC_COUNT
+} statistics_metric_t;
+
+typedef enum {
+  STATISTICS_WINDOW_1MIN = 0,
+  STATISTICS_WINDOW_15MIN,
+  STATISTICS_WINDOW_1H,
+  STATISTICS_WINDOW_COUNT
+} statistics_window_t;
+
+// Outcome of one completed window. All zero until a window has completed.
+typedef struct {
+  uint32_t count;
+  int32_t min;
+  int32_t mean;
+  int32_t max;
+  int32_t p95;  // 0 when compiled without STATISTICS_ENABLE_P95
+} statistics_result_t;
+
+// Outcome selected for reporting on demand through the configuration
+// parameters, refreshed by statistics_select
+extern statistics_result_t statistics_report;
+
+// Add a reading of 'metric' taken at 'now_ms'. Constant time per sample.
+void statistics_add(statistics_metric_t metric, int32_t value, uint32_t now_ms);
+
+// Outcome of the last completed window of 'metric'. Returns false when no
+// window has completed yet.
+bool statistics_get(statistics_metric_t metric, statistics_window_t window,
+                    statistics_result_t* pResult);
+
+// Refresh statistics_report with the outcome of 'metric' over 'window'
+void statistics_select(uint8_t metric, uint8_t window);
+
+// Drop all statistics, e.g. when the readings belong to another meter
+void statistics_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_STATISTICS_H_ */
@@ -0,0 +1,329 @@
+/***************************************************************************//**
+ * @file timeseries.c
+ * @brief Tiered, compressed history of a measurement
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#include "timeseries.h"
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// A sample takes at most a 5 byte value varint and a 5 byte time varint
+#define TIMESERIES_SAMPLE_MAX_BYTES 10
+
+static timeseries_block_t raw_blocks[TIMESERIES_RAW_BLOCKS];
+static timeseries_block_t min1_blocks[TIMESERIES_1MIN_BLOCKS];
+static timeseries_block_t min15_blocks[TIMESERIES_15MIN_BLOCKS];
+
+typedef struct {
+  timeseries_block_t* blocks;
+  uint8_t size;
+  uint32_t unit_ds;     // length of a time unit
+  uint32_t span_units;  // how far back the tier goes
+} timeseries_tier_desc_t;
+
+static const timeseries_tier_desc_t tier_desc[TIMESERIES_TIER_COUNT] = {
+  // Samples come every 2.5 s, half a second keeps their time steps steady
+  { raw_blocks,   TIMESERIES_RAW_BLOCKS,   5,    10 * 60 * 2 },
+  { min1_blocks,  TIMESERIES_1MIN_BLOCKS,  600,  24 * 60 },
+  { min15_blocks, TIMESERIES_15MIN_BLOCKS, 9000, 7 * 24 * 4 },
+};
+
+typedef struct {
+  uint8_t first;
+  uint8_t count;
+  uint16_t sequence;    // of the next block
+  // State of the encoder at the end of the newest block
+  uint32_t last_time;
+  int32_t last_value;
+  int32_t last_step;
+  // Mean being built up, for the aggregated tiers
+  uint32_t period;
+  int64_t sum;
+  uint32_t sum_count;
+  timeseries_stats_t stats;
+} timeseries_tier_state_t;
+
+static timeseries_tier_state_t tiers[TIMESERIES_TIER_COUNT];
+
+// Free-running time in tenths of a second, built up from the millisecond
+// timestamps so it survives the tick counter wrapping
+static struct {
+  bool started;
+  uint32_t last_ms;
+  uint32_t remainder_ms;
+  uint32_t now_ds;
+} ts_clock;
+
+static uint8_t put_varint(uint8_t* pData, uint64_t value)
+{
+  uint8_t length = 0;
+  while(value >= 0x80) {
+    pData[length++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  pData[length++] = (uint8_t)value;
+  return length;
+}
+
+static uint8_t get_varint(const uint8_t* pData, uint8_t available, uint64_t* pValue)
+{
+  uint64_t value = 0;
+  uint8_t length = 0;
+  while(length < available && length < 10) {
+    uint8_t byte = pData[length];
+    value |= (uint64_t)(byte & 0x7F) << (7 * length);
+    length++;
+    if(!(byte & 0x80)) {
+      *pValue = value;
+      return length;
+    }
+  }
+  return 0;
+}
+
+static uint64_t zigzag(int64_t value)
+{
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static timeseries_block_t* timeseries_at(timeseries_tier_t tier, uint8_t index)
+{
+  const timeseries_tier_desc_t* pDesc = &tier_desc[tier];
+  return &pDesc->blocks[(tiers[tier].first + index) % pDesc->size];
+}
+
+static void timeseries_drop_oldest(timeseries_tier_t tier)
+{
+  tiers[tier].first = (tiers[tier].first + 1) % tier_desc[tier].size;
+  tiers[tier].count--;
+}
+
+static void timeseries_start_block(timeseries_tier_t tier, uint32_t time, int32_t value)
+{
+  timeseries_tier_state_t* pTier = &tiers[tier];
+  if(pTier->count == tier_desc[tier].size) {
+    timeseries_drop_oldest(tier);
+    pTier->stats.dropped++;
+  }
+
+  timeseries_block_t* pBlock = timeseries_at(tier, pTier->count);
+  pTier->count++;
+  pBlock->start = time;
+  pBlock->first_value = value;
+  pBlock->sequence = pTier->sequence++;
+  pBlock->span = 0;
+  pBlock->count = 1;
+  pBlock->length = 0;
+
+  pTier->last_time = time;
+  pTier->last_value = value;
+  pTier->last_step = 0;
+  pTier->stats.bytes += sizeof(pBlock->start) + sizeof(pBlock->first_value);
+}
+
+static void timeseries_add(timeseries_tier_t tier, uint32_t time, int32_t value)
+{
+  timeseries_tier_state_t* pTier = &tiers[tier];
+  pTier->stats.samples++;
+
+  // Blocks which have gone past the span of the tier
+  while(pTier->count > 0) {
+    const timeseries_block_t* pOldest = timeseries_at(tier, 0);
+    if(time - (pOldest->start + pOldest->span) <= tier_desc[tier].span_units) {
+      break;
+    }
+    timeseries_drop_oldest(tier);
+  }
+
+  timeseries_block_t* pBlock = pTier->count > 0 ? timeseries_at(tier, pTier->count - 1) : NULL;
+  uint32_t span = pBlock != NULL ? time - pBlock->start : 0;
+  if(pBlock == NULL ||
+     pBlock->count == UINT8_MAX ||
+     span > UINT16_MAX) {
+    timeseries_start_block(tier, time, value);
+    return;
+  }
+
+  int32_t step = (int32_t)(time - pTier->last_time);
+  int64_t step_change = (int64_t)step - pTier->last_step;
+  int64_t delta = (int64_t)value - pTier->last_value;
+
+  uint8_t sample[TIMESERIES_SAMPLE_MAX_BYTES];
+  uint8_t length = put_varint(sample, (zigzag(delta) << 1) | (step_change != 0 ? 1 : 0));
+  if(step_change != 0) {
+    length += put_varint(&sample[length], zigzag(step_change));
+  }
+
+  // The block is full when this sample doesn't fit, not when the largest
+  // possible one wouldn't
+  if(pBlock->length + length > TIMESERIES_BLOCK_DATA) {
+    timeseries_start_block(tier, time, value);
+    return;
+  }
+  memcpy(&pBlock->data[pBlock->length], sample, length);
+  pBlock->length += length;
+  pBlock->count++;
+  pBlock->span = (uint16_t)span;
+  pTier->stats.bytes += length;
+
+  pTier->last_time = time;
+  pTier->last_value = value;
+  pTier->last_step = step;
+}
+
+// Feed an aggregated tier, which adds the mean of a period once it's over
+static void timeseries_aggregate(timeseries_tier_t tier, int32_t value)
+{
+  timeseries_tier_state_t* pTier = &tiers[tier];
+  uint32_t period = timeseries_now(tier);
+
+  if(pTier->sum_count > 0 && period != pTier->period) {
+    int64_t half = (pTier->sum >= 0 ? 1 : -1) * (int64_t)(pTier->sum_count / 2);
+    timeseries_add(tier, pTier->period, (int32_t)((pTier->sum + half) / (int64_t)pTier->sum_count));
+    pTier->sum = 0;
+    pTier->sum_count = 0;
+  }
+
+  pTier->period = period;
+  pTier->sum += value;
+  pTier->sum_count++;
+}
+
+void timeseries_append(int32_t value, uint32_t now_ms)
+{
+  if(!ts_clock.started) {
+    ts_clock.started = true;
+    ts_clock.last_ms = now_ms;
+  }
+  uint32_t elapsed_ms = now_ms - ts_clock.last_ms + ts_clock.remainder_ms;
+  ts_clock.last_ms = now_ms;
+  ts_clock.now_ds += elapsed_ms / 100;
+  ts_clock.remainder_ms = elapsed_ms % 100;
+
+  timeseries_add(TIMESERIES_TIER_RAW, timeseries_now(TIMESERIES_TIER_RAW), value);
+  timeseries_aggregate(TIMESERIES_TIER_1MIN, value);
+  timeseries_aggregate(TIMESERIES_TIER_15MIN, value);
+}
+
+uint32_t timeseries_unit_ds(timeseries_tier_t tier)
+{
+  return tier_desc[tier].unit_ds;
+}
+
+uint32_t timeseries_now(timeseries_tier_t tier)
+{
+  return ts_clock.now_ds / tier_desc[tier].unit_ds;
+}
+
+uint8_t timeseries_block_count(timeseries_tier_t tier)
+{
+  return tiers[tier].count;
+}
+
+const timeseries_block_t* timeseries_block(timeseries_tier_t tier, uint8_t index)
+{
+  if(index >= tiers[tier].count) {
+    return NULL;
+  }
+  return timeseries_at(tier, index);
+}
+
+void timeseries_cursor_init(timeseries_cursor_t* pCursor, const timeseries_block_t* pBlock)
+{
+  pCursor->pBlock = pBlock;
+  pCursor->index = 0;
+  pCursor->offset = 0;
+  pCursor->time = pBlock->start;
+  pCursor->value = pBlock->first_value;
+  pCursor->step = 0;
+}
+
+bool timeseries_next(timeseries_cursor_t* pCursor, uint32_t* pTime, int32_t* pValue)
+{
+  const timeseries_block_t* pBlock = pCursor->pBlock;
+  if(pCursor->index >= pBlock->count) {
+    return false;
+  }
+
+  if(pCursor->index > 0) {
+    uint64_t word;
+    uint8_t length = get_varint(&pBlock->data[pCursor->offset],
+                                pBlock->length - pCursor->offset, &word);
+    if(length == 0) {
+      return false;
+    }
+    pCursor->offset += length;
+
+    if(word & 1) {
+      uint64_t step_change;
+      length = get_varint(&pBlock->data[pCursor->offset],
+                          pBlock->length - pCursor->offset, &step_change);
+      if(length == 0) {
+        return false;
+      }
+      pCursor->offset += length;
+      pCursor->step += (int32_t)unzigzag(step_change);
+    }
+    pCursor->time += pCursor->step;
+    pCursor->value += (int32_t)unzigzag(word >> 1);
+  }
+
+  pCursor->index++;
+  *pTime = pCursor->time;
+  *pValue = pCursor->value;
+  return true;
+}
+
+const timeseries_stats_t* timeseries_stats(timeseries_tier_t tier)
+{
+  return &tiers[tier].stats;
+}
+
+// Block sequence numbers carry on, so a reader can tell the history changed
+void timeseries_reset(void)
+{
+  uint16_t sequence[TIMESERIES_TIER_COUNT];
+  for(uint8_t i = 0; i < TIMESERIES_TIER_COUNT; i++) {
+    sequence[i] = tiers[i].sequence;
+  }
+  memset(tiers, 0, sizeof(tiers));
+  for(uint8_t i = 0; i < TIMESERIES_TIER_COUNT; i++) {
+    tiers[i].sequence = sequence[i];
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
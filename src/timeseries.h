@@ -0,0 +1,129 @@
+/***************************************************************************//**
+ * @file timeseries.h
+ * @brief Tiered, compressed history of a measurement
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_TIMESERIES_H_
+#define AMS_TIMESERIES_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* History of one measurement at three resolutions: every sample for the last
+ * 10 minutes, 1 minute means for the last 24 hours and 15 minute means for the
+ * last week.
+ *
+ * Each tier is a ring of fixed-size blocks. A block holds its first sample as
+ * is, and every sample after that as a single varint of
+ * (zigzag(value delta) << 1 | time flag). The flag is set when the time step
+ * differs from the one before, in which case the delta-of-delta of the time
+ * follows as another zigzag varint. Samples at a steady interval therefore
+ * cost only their value delta, typically one or two bytes. Blocks decode on
+ * their own, so the oldest can be dropped, or sent off, as a whole.
+ */
+typedef enum {
+  TIMESERIES_TIER_RAW = 0,
+  TIMESERIES_TIER_1MIN,
+  TIMESERIES_TIER_15MIN,
+  TIMESERIES_TIER_COUNT
+} timeseries_tier_t;
+
+// Block budget per tier. The tiers also drop blocks which are past their span.
+// Sized from test/timeseries_test.c, which measures about 1.3 bytes per sample
+// for the raw and 1 minute tiers, and 2.3 for the 15 minute tier. The 15 minute
+// tier has room for 2.8 bytes per sample, as its means move more.
+#ifndef TIMESERIES_RAW_BLOCKS
+#define TIMESERIES_RAW_BLOCKS 12
+#endif
+#ifndef TIMESERIES_1MIN_BLOCKS
+#define TIMESERIES_1MIN_BLOCKS 44
+#endif
+#ifndef TIMESERIES_15MIN_BLOCKS
+#define TIMESERIES_15MIN_BLOCKS 36
+#endif
+
+#define TIMESERIES_BLOCK_DATA 50
+
+typedef struct {
+  uint32_t start;       // time of the first sample, in tier units
+  int32_t first_value;
+  uint16_t sequence;    // increments with every new block in the tier
+  uint16_t span;        // time from the first to the last sample, in tier units
+  uint8_t count;        // samples in the block
+  uint8_t length;       // bytes used in data
+  uint8_t data[TIMESERIES_BLOCK_DATA];
+} timeseries_block_t;
+
+typedef struct {
+  uint32_t samples;     // appended to the tier
+  uint32_t bytes;       // encoded for those samples, first values included
+  uint32_t dropped;     // blocks dropped for lack of room
+} timeseries_stats_t;
+
+// Walks the samples of a block, see timeseries_next
+typedef struct {
+  const timeseries_block_t* pBlock;
+  uint8_t index;
+  uint8_t offset;
+  uint32_t time;
+  int32_t value;
+  int32_t step;
+} timeseries_cursor_t;
+
+// Add a sample taken at 'now_ms'. The aggregated tiers get a mean once a
+// minute or quarter of an hour has passed.
+void timeseries_append(int32_t value, uint32_t now_ms);
+
+// Length of a time unit of 'tier', in tenths of a second
+uint32_t timeseries_unit_ds(timeseries_tier_t tier);
+
+// Current time in units of 'tier'
+uint32_t timeseries_now(timeseries_tier_t tier);
+
+// Blocks held by 'tier', and block 'index' of them with 0 being the oldest
+uint8_t timeseries_block_count(timeseries_tier_t tier);
+const timeseries_block_t* timeseries_block(timeseries_tier_t tier, uint8_t index);
+
+// Start walking the samples of 'pBlock'
+void timeseries_cursor_init(timeseries_cursor_t* pCursor, const timeseries_block_t* pBlock);
+
+// Next sample of the block. Returns false when there are no more.
+bool timeseries_next(timeseries_cursor_t* pCursor, uint32_t* pTime, int32_t* pValue);
+
+const timeseries_stats_t* timeseries_stats(timeseries_tier_t tier);
+
+// Forget all history, e.g. when it belongs to another meter
+void timeseries_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_TIMESERIES_H_ */
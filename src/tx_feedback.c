@@ -0,0 +1,173 @@
+/***************************************************************************//**
+ * @file tx_feedback.c
+ * @brief Transmit outcome tracking per destination, and the resulting backoff
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+#include "tx_feedback.h"
+#include "config_app.h"
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Congestion score is a running average of the failure rate, where 256 means
+// every transmission failed. Each outcome moves it 1/8th of the way.
+#define TX_FEEDBACK_SCORE_FAIL 256
+#define TX_FEEDBACK_SCORE_SHIFT 3
+// A success which took this long was fighting for the channel, and counts as
+// half a failure
+#define TX_FEEDBACK_SLOW_RTT_MS 500
+// Back off above 25% failures, recover below 6%
+#define TX_FEEDBACK_SCORE_UP 64
+#define TX_FEEDBACK_SCORE_DOWN 16
+// Outcomes to wait between level changes, to see the effect of the last one
+#define TX_FEEDBACK_HOLD 8
+// Period of list1, which is the fastest anything gets reported
+#define TX_FEEDBACK_BASE_INTERVAL_MS 2500
+
+uint8_t tx_feedback_backoff_level = 0;
+
+static tx_feedback_destination_t destinations[MAX_ASSOCIATION_IN_GROUP];
+static uint16_t pending_node_id;
+static uint16_t score;
+static uint8_t outcomes_since_change;
+
+static tx_feedback_destination_t* tx_feedback_find(uint16_t node_id, bool create)
+{
+  tx_feedback_destination_t* pFree = NULL;
+  tx_feedback_destination_t* pOldest = &destinations[0];
+
+  for(size_t i = 0; i < MAX_ASSOCIATION_IN_GROUP; i++) {
+    if(destinations[i].node_id == node_id) {
+      return &destinations[i];
+    }
+    if(destinations[i].node_id == 0 && pFree == NULL) {
+      pFree = &destinations[i];
+    }
+    if(destinations[i].successes + destinations[i].failures <
+       pOldest->successes + pOldest->failures) {
+      pOldest = &destinations[i];
+    }
+  }
+
+  if(!create) {
+    return NULL;
+  }
+
+  // Associations changed: take over the least used entry
+  if(pFree == NULL) {
+    pFree = pOldest;
+  }
+  memset(pFree, 0, sizeof(*pFree));
+  pFree->node_id = node_id;
+  return pFree;
+}
+
+static void tx_feedback_update_level(uint16_t sample)
+{
+  score = score - (score >> TX_FEEDBACK_SCORE_SHIFT) + (sample >> TX_FEEDBACK_SCORE_SHIFT);
+
+  if(outcomes_since_change < TX_FEEDBACK_HOLD) {
+    outcomes_since_change++;
+    return;
+  }
+
+  if(score > TX_FEEDBACK_SCORE_UP && tx_feedback_backoff_level < TX_FEEDBACK_MAX_LEVEL) {
+    tx_feedback_backoff_level++;
+    outcomes_since_change = 0;
+  } else if(score < TX_FEEDBACK_SCORE_DOWN && tx_feedback_backoff_level > 0) {
+    tx_feedback_backoff_level--;
+    outcomes_since_change = 0;
+  }
+}
+
+void tx_feedback_sent(uint16_t node_id)
+{
+  pending_node_id = node_id;
+}
+
+void tx_feedback_result(bool success, uint16_t rtt_ms)
+{
+  if(pending_node_id == 0) {
+    return;
+  }
+  tx_feedback_node_result(pending_node_id, success, rtt_ms);
+  pending_node_id = 0;
+}
+
+void tx_feedback_node_result(uint16_t node_id, bool success, uint16_t rtt_ms)
+{
+  tx_feedback_destination_t* pDest = tx_feedback_find(node_id, true);
+  uint16_t sample;
+
+  if(success) {
+    pDest->successes++;
+    pDest->consecutive_failures = 0;
+    if(rtt_ms != 0) {
+      pDest->rtt_ms = pDest->rtt_ms == 0 ? rtt_ms
+                    : (uint16_t)(pDest->rtt_ms + ((int32_t)rtt_ms - pDest->rtt_ms) / 4);
+    }
+    sample = rtt_ms >= TX_FEEDBACK_SLOW_RTT_MS ? TX_FEEDBACK_SCORE_FAIL / 2 : 0;
+  } else {
+    pDest->failures++;
+    if(pDest->consecutive_failures < UINT8_MAX) {
+      pDest->consecutive_failures++;
+    }
+    sample = TX_FEEDBACK_SCORE_FAIL;
+  }
+
+  tx_feedback_update_level(sample);
+}
+
+const tx_feedback_destination_t* tx_feedback_destination(uint16_t node_id)
+{
+  return tx_feedback_find(node_id, false);
+}
+
+uint32_t tx_feedback_scale_interval(uint32_t interval_ms)
+{
+  if(tx_feedback_backoff_level == 0) {
+    return interval_ms;
+  }
+  if(interval_ms == 0) {
+    interval_ms = TX_FEEDBACK_BASE_INTERVAL_MS;
+  }
+  return interval_ms << tx_feedback_backoff_level;
+}
+
+void tx_feedback_reset(void)
+{
+  memset(destinations, 0, sizeof(destinations));
+  pending_node_id = 0;
+  score = 0;
+  outcomes_since_change = 0;
+  tx_feedback_backoff_level = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,77 @@
+/***************************************************************************//**
+ * @file tx_feedback.h
+ * @brief Transmit outcome tracking per destination, and the resulting backoff
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_TX_FEEDBACK_H_
+#define AMS_TX_FEEDBACK_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Highest backoff level. Each level doubles the reporting intervals.
+#define TX_FEEDBACK_MAX_LEVEL 4
+
+typedef struct {
+  uint16_t node_id;               // 0 for an unused entry
+  uint32_t successes;
+  uint32_t failures;
+  uint8_t consecutive_failures;
+  uint16_t rtt_ms;                // running average of successful transmissions
+} tx_feedback_destination_t;
+
+// Current backoff level, 0 when the network is healthy. Exposed as telemetry.
+extern uint8_t tx_feedback_backoff_level;
+
+// Remember the destination of the transmission which was just queued, such
+// that its status (which doesn't say who it was for) can be attributed.
+void tx_feedback_sent(uint16_t node_id);
+
+// Outcome of the transmission registered with tx_feedback_sent()
+void tx_feedback_result(bool success, uint16_t rtt_ms);
+
+// Outcome of a transmission to a known destination
+void tx_feedback_node_result(uint16_t node_id, bool success, uint16_t rtt_ms);
+
+// Statistics for one destination, NULL if it was never sent to
+const tx_feedback_destination_t* tx_feedback_destination(uint16_t node_id);
+
+// Scale a reporting interval according to the current backoff level. An
+// interval of 0 (no limit) is scaled from the list1 period.
+uint32_t tx_feedback_scale_interval(uint32_t interval_ms);
+
+// Forget all destinations and start over at level 0
+void tx_feedback_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMS_TX_FEEDBACK_H_ */
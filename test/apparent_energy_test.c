@@ -0,0 +1,132 @@
+/***************************************************************************//**
+ * @file apparent_energy_test.c
+ * @brief Host test of the apparent energy built up from the hourly readings
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+// Checks the square root and power factor against known values, that the
+// total starts at 0 rather than at the lifetime registers, only grows by what
+// the registers moved within each hour, and carries on from a saved state.
+
+#include "apparent_energy.h"
+#include "test_util.h"
+
+#include <stdio.h>
+
+static void test_isqrt(void)
+{
+  CHECK(apparent_isqrt(0) == 0);
+  CHECK(apparent_isqrt(1) == 1);
+  CHECK(apparent_isqrt(24) == 4);
+  CHECK(apparent_isqrt(25) == 5);
+  CHECK(apparent_isqrt(0xFFFFFFFFULL * 0xFFFFFFFFULL) == 0xFFFFFFFFUL);
+
+  for(uint32_t i = 0; i < 100000; i++) {
+    uint64_t value = ((uint64_t)test_random() << 24) ^ test_random();
+    uint64_t root = apparent_isqrt(value);
+    CHECK(root * root <= value && (root + 1) * (root + 1) > value);
+  }
+}
+
+static void test_power_factor(void)
+{
+  CHECK(apparent_power_va(3000, 4000) == 5000);
+  CHECK(apparent_power_va(-3000, 4000) == 5000);
+  CHECK(apparent_power_factor(3000, 4000) == 60);
+  CHECK(apparent_power_factor(-3000, -4000) == 60);
+  CHECK(apparent_power_factor(2000, 0) == 100);
+  CHECK(apparent_power_factor(0, 500) == 0);
+  CHECK(apparent_power_factor(0, 0) == 100);
+}
+
+static void test_first_reading(void)
+{
+  apparent_energy_reset();
+
+  // Years' worth on the registers say nothing about the apparent energy
+  apparent_energy_update(45678901, 12345678);
+  CHECK(apparent_energy_total() == 0);
+
+  // An hour at 3 kW and 4 kvar
+  apparent_energy_update(45678901 + 3000, 12345678 + 4000);
+  CHECK(apparent_energy_total() == 5000);
+
+  // An hour of purely active load
+  apparent_energy_update(45678901 + 4000, 12345678 + 4000);
+  CHECK(apparent_energy_total() == 6000);
+
+  // No load at all
+  apparent_energy_update(45678901 + 4000, 12345678 + 4000);
+  CHECK(apparent_energy_total() == 6000);
+}
+
+static void test_backwards(void)
+{
+  apparent_energy_reset();
+  apparent_energy_update(1000000, 500000);
+  apparent_energy_update(1000300, 500400);
+  CHECK(apparent_energy_total() == 500);
+
+  // Registers reset: only the anchor moves
+  apparent_energy_update(100, 50);
+  CHECK(apparent_energy_total() == 500);
+  apparent_energy_update(400, 450);
+  CHECK(apparent_energy_total() == 1000);
+}
+
+static void test_saved_state(void)
+{
+  apparent_energy_state_t state;
+
+  apparent_energy_reset();
+  apparent_energy_update(2000000, 100000);
+  apparent_energy_update(2000600, 100800);
+  apparent_energy_get_state(&state);
+  CHECK(state.total_vah == 1000);
+
+  // After a restart it carries on from the saved total and anchor
+  apparent_energy_reset();
+  apparent_energy_set_state(&state);
+  apparent_energy_update(2001200, 101600);
+  CHECK(apparent_energy_total() == 2000);
+
+  // A saved total without an anchor keeps the total, and anchors anew
+  state.total_vah = 7000;
+  state.anchored = 0;
+  apparent_energy_set_state(&state);
+  apparent_energy_update(9000000, 9000000);
+  CHECK(apparent_energy_total() == 7000);
+  apparent_energy_update(9000300, 9000400);
+  CHECK(apparent_energy_total() == 7500);
+}
+
+int main(void)
+{
+  test_isqrt();
+  test_power_factor();
+  test_first_reading();
+  test_backwards();
+  test_saved_state();
+  return test_result();
+}
@@ -0,0 +1,218 @@
+/***************************************************************************//**
+ * @file energy_estimator_test.c
+ * @brief Host test of the sub-hour energy estimate
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+// Checks the estimate against hand-computed integrals, that it never goes
+// backwards and stays below the hourly readings, then runs a few days of a
+// varying load through it and prints how far off it is when the readings come.
+
+#include "energy_estimator.h"
+#include "test_util.h"
+
+#include <stdio.h>
+
+#define SAMPLE_INTERVAL_MS 2500
+#define MS_PER_HOUR 3600000UL
+
+// Feed 'watt' for 'ms' worth of readings, starting at 'now_ms'. Returns the
+// time of the next reading.
+static uint32_t feed(uint32_t watt, uint32_t now_ms, uint32_t ms)
+{
+  for(uint32_t t = 0; t < ms; t += SAMPLE_INTERVAL_MS) {
+    energy_estimator_add_power(watt, now_ms + t);
+  }
+  return now_ms + ms;
+}
+
+static void test_not_anchored(void)
+{
+  energy_estimator_reset();
+  CHECK(!energy_estimator_valid());
+  CHECK(energy_estimator_estimate() == 0);
+
+  // Readings before the first hourly value go nowhere
+  feed(1000, 0, MS_PER_HOUR);
+  CHECK(!energy_estimator_valid());
+  CHECK(energy_estimator_estimate() == 0);
+}
+
+static void test_integration(void)
+{
+  // 3600 W over an hour is 3600 Wh, less the 3% margin
+  energy_estimator_reset();
+  uint32_t now = 0;
+  energy_estimator_add_power(3600, now);
+  energy_estimator_reconcile(10000);
+  CHECK(energy_estimator_valid());
+  CHECK(energy_estimator_estimate() == 10000);
+
+  now = feed(3600, now + SAMPLE_INTERVAL_MS, MS_PER_HOUR);
+  CHECK(energy_estimator_estimate() == 10000 + 3492);
+
+  // Half an hour of 1000 W on top
+  now = feed(1000, now, MS_PER_HOUR / 2);
+  uint32_t estimate = energy_estimator_estimate();
+  CHECK(estimate > 10000 + 3492 + 450 && estimate <= 10000 + 3492 + 500);
+
+  // Across the tick counter wrapping
+  energy_estimator_reset();
+  now = UINT32_MAX - MS_PER_HOUR / 2;
+  energy_estimator_add_power(2000, now);
+  energy_estimator_reconcile(500);
+  feed(2000, now + SAMPLE_INTERVAL_MS, MS_PER_HOUR);
+  CHECK(energy_estimator_estimate() == 500 + 1940);
+}
+
+static void test_gap(void)
+{
+  energy_estimator_reset();
+  energy_estimator_add_power(1000, 0);
+  energy_estimator_reconcile(0);
+
+  // A reading 20 s after the last one doesn't count what came in between
+  energy_estimator_add_power(1000, 20000);
+  CHECK(energy_estimator_estimate() == 0);
+
+  // But integration picks up again from there
+  feed(1000, 20000 + SAMPLE_INTERVAL_MS, MS_PER_HOUR);
+  CHECK(energy_estimator_estimate() == 970);
+}
+
+static void test_monotonic(void)
+{
+  energy_estimator_reset();
+  uint32_t now = 0;
+  energy_estimator_add_power(2000, now);
+  energy_estimator_reconcile(1000);
+  now = feed(2000, now + SAMPLE_INTERVAL_MS, MS_PER_HOUR);
+  uint32_t published = energy_estimator_estimate();
+  CHECK(published == 1000 + 1940);
+
+  // The meter says less than what went out: hold until it's caught up
+  uint32_t overshoots = energy_estimator_stats()->overshoots;
+  energy_estimator_reconcile(2500);
+  CHECK(energy_estimator_stats()->overshoots == overshoots + 1);
+  CHECK(energy_estimator_stats()->last_error_wh == published - 2500);
+  CHECK(energy_estimator_estimate() == published);
+
+  now = feed(2000, now, MS_PER_HOUR / 10);
+  CHECK(energy_estimator_estimate() == published);
+  now = feed(2000, now, MS_PER_HOUR / 2);
+  CHECK(energy_estimator_estimate() > published);
+
+  // What was published before a reset still holds
+  energy_estimator_reset();
+  energy_estimator_restore(5000);
+  CHECK(energy_estimator_estimate() == 5000);
+  energy_estimator_add_power(0, now);
+  energy_estimator_reconcile(4990);
+  CHECK(energy_estimator_estimate() == 5000);
+
+  // A lower value doesn't take it back
+  energy_estimator_restore(10);
+  CHECK(energy_estimator_estimate() == 5000);
+}
+
+// Power drawn by a house, changing every few minutes, with short spikes the
+// meter happens to catch
+static uint32_t household_power(uint32_t sample)
+{
+  uint32_t minute = sample * SAMPLE_INTERVAL_MS / 60000;
+  uint32_t power = 300 + (minute * 7919 % 13) * 400;
+  if(test_random() % 100 == 0) {
+    power += 5000;
+  }
+  return power;
+}
+
+static void benchmark(void)
+{
+  static const uint32_t hours = 24 * 7;
+  static const uint32_t samples_per_hour = MS_PER_HOUR / SAMPLE_INTERVAL_MS;
+
+  // The stats carry on over a reset, so only count what happens from here
+  energy_estimator_reset();
+  energy_estimator_stats_t start = *energy_estimator_stats();
+  uint32_t max_error_wh = 0;
+  uint64_t meter_wms = 0;
+  uint32_t last_watt = 0;
+  uint32_t previous_estimate = 0;
+  bool went_back = false;
+  uint64_t total_ns = 0;
+
+  for(uint32_t i = 0; i <= hours * samples_per_hour; i++) {
+    uint32_t watt = household_power(i);
+    uint32_t now = i * SAMPLE_INTERVAL_MS;
+
+    // What the meter counts: the power between readings, not just at them
+    if(i > 0) {
+      meter_wms += (uint64_t)last_watt * SAMPLE_INTERVAL_MS;
+    }
+    last_watt = watt;
+
+    uint64_t before = test_now_ns();
+    energy_estimator_add_power(watt, now);
+    if(i % samples_per_hour == 0) {
+      energy_estimator_reconcile((uint32_t)(meter_wms / MS_PER_HOUR));
+      if(energy_estimator_stats()->last_error_wh > max_error_wh) {
+        max_error_wh = energy_estimator_stats()->last_error_wh;
+      }
+    }
+    uint32_t estimate = energy_estimator_estimate();
+    total_ns += test_now_ns() - before;
+
+    if(estimate < previous_estimate) {
+      went_back = true;
+    }
+    previous_estimate = estimate;
+  }
+
+  const energy_estimator_stats_t* pStats = energy_estimator_stats();
+  uint32_t hourly = pStats->reconciliations - start.reconciliations;
+  uint32_t overshoots = pStats->overshoots - start.overshoots;
+  CHECK(hourly == hours);
+  CHECK(!went_back);
+
+  // Spikes stand in for a whole interval now and then, the margin should
+  // keep that from pushing the estimate above the meter
+  CHECK(overshoots < hours / 10);
+
+  printf("%u hours, %.1f ns per reading\n",
+         hours, (double)total_ns / (hours * samples_per_hour));
+  printf("off by %.1f Wh on average at the hourly reading, at most %u Wh, %u overshoots\n",
+         (double)(pStats->total_error_wh - start.total_error_wh) / hourly, max_error_wh,
+         overshoots);
+}
+
+int main(void)
+{
+  test_not_anchored();
+  test_integration();
+  test_gap();
+  test_monotonic();
+  benchmark();
+  return test_result();
+}
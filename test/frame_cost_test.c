@@ -0,0 +1,98 @@
+/***************************************************************************//**
+ * @file frame_cost_test.c
+ * @brief Host test of the lifeline multicast decision
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+// Works out what a multicast to 1 to 5 lifeline destinations saves over
+// singlecasts for the report sizes the firmware sends, with and without S2,
+// and checks it against counting the frames by hand.
+
+#include "frame_cost.h"
+#include "test_util.h"
+
+#include <stdio.h>
+
+#define MAX_DESTINATIONS 5
+
+// A power report, an energy report with its previous value, a full bundle
+static const uint8_t sizes[] = {8, 14, 39};
+
+// Bytes on air for each way of sending, frame by frame
+static int32_t singlecasts(uint8_t destinations, uint8_t size)
+{
+  int32_t bytes = 0;
+  for(uint8_t i = 0; i < destinations; i++) {
+    bytes += size + FRAME_OVERHEAD_BYTES;
+  }
+  return bytes;
+}
+
+static int32_t multicast(uint8_t destinations, uint8_t size, bool secure)
+{
+  int32_t bytes = size + FRAME_OVERHEAD_BYTES + MULTICAST_MASK_BYTES;
+  if(secure) {
+    for(uint8_t i = 0; i < destinations; i++) {
+      bytes += size + FRAME_OVERHEAD_BYTES + MULTICAST_FOLLOWUP_EXTENSION_BYTES;
+    }
+  }
+  return bytes;
+}
+
+static void test_saving(bool secure)
+{
+  printf("%s:\n", secure ? "S2" : "no security");
+  for(size_t s = 0; s < sizeof(sizes); s++) {
+    uint8_t size = sizes[s];
+    int32_t last = 0;
+    printf("  %2u bytes:", size);
+    for(uint8_t destinations = 1; destinations <= MAX_DESTINATIONS; destinations++) {
+      int32_t saving = frame_cost_multicast_saving(destinations, size, secure);
+      printf(" %5d", saving);
+
+      CHECK(saving == singlecasts(destinations, size) - multicast(destinations, size, secure));
+
+      if(secure) {
+        // The follow-ups alone cost more than the singlecasts they replace
+        CHECK(saving < 0);
+        CHECK(saving == -(size + FRAME_OVERHEAD_BYTES + MULTICAST_MASK_BYTES) -
+                        destinations * MULTICAST_FOLLOWUP_EXTENSION_BYTES);
+        CHECK(destinations == 1 || saving < last);
+      } else {
+        // A single destination never gains from the node mask; any more do
+        CHECK((destinations == 1) == (saving <= 0));
+        CHECK(destinations == 1 || saving > last);
+      }
+      last = saving;
+    }
+    printf("\n");
+  }
+}
+
+int main(void)
+{
+  test_saving(false);
+  test_saving(true);
+  return test_result();
+}
@@ -0,0 +1,229 @@
+/***************************************************************************//**
+ * @file han_tunnel_test.c
+ * @brief Host test of the HDLC framing and segmenting of the HAN tunnel
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+// Feeds HDLC frames laid out the way the meters send lists 1, 2 and 3 through
+// the tunnel's framer, byte by byte like the UART does, and checks each one
+// comes out whole and takes the expected number of segments. Also checks
+// back-to-back frames, line noise, bad frame check sequences and overruns.
+
+#include "han_tunnel.h"
+#include "test_util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define HDLC_FLAG 0x7E
+
+typedef struct {
+  const char* name;
+  size_t length;      // format field through FCS
+  uint16_t segments;
+} frame_case_t;
+
+// List 1 (power only) fits a single segment; lists 2 and 3 take a few. The
+// others sit on the segment boundaries and at the largest frame held.
+static const frame_case_t cases[] = {
+  {"list 1",          HAN_TUNNEL_SEGMENT_DATA - 1,  1},
+  {"one full segment", HAN_TUNNEL_SEGMENT_DATA,      1},
+  {"one byte over",   HAN_TUNNEL_SEGMENT_DATA + 1,  2},
+  {"list 2",          123,                          4},
+  {"list 3",          157,                          5},
+  {"largest",         HAN_TUNNEL_MAX_FRAME,         16},
+};
+
+// An HDLC frame of 'length' bytes: frame format type 3 with the length,
+// destination and source address, control, header check sequence, the LLC
+// header and a payload, then the frame check sequence
+static void build_frame(uint8_t* pFrame, size_t length, uint8_t seed)
+{
+  pFrame[0] = 0xA0 | ((length >> 8) & 0x07);
+  pFrame[1] = length & 0xFF;
+  pFrame[2] = 0x01;   // destination address
+  pFrame[3] = 0x02;   // source address
+  pFrame[4] = 0x01;
+  pFrame[5] = 0x10;   // control
+  uint16_t hcs = han_tunnel_crc16_x25(pFrame, 6);
+  pFrame[6] = hcs & 0xFF;
+  pFrame[7] = hcs >> 8;
+  pFrame[8] = 0xE6;   // LLC
+  pFrame[9] = 0xE7;
+  pFrame[10] = 0x00;
+  for(size_t i = 11; i < length - 2; i++) {
+    // Flags inside the payload must not confuse the framer
+    pFrame[i] = (i % 17 == 0) ? HDLC_FLAG : (uint8_t)(seed + i * 31);
+  }
+  uint16_t fcs = han_tunnel_crc16_x25(pFrame, length - 2);
+  pFrame[length - 2] = fcs & 0xFF;
+  pFrame[length - 1] = fcs >> 8;
+}
+
+// Feed bytes, and return how many frames completed
+static unsigned feed(const uint8_t* pData, size_t length)
+{
+  unsigned completed = 0;
+  for(size_t i = 0; i < length; i++) {
+    if(han_tunnel_input_byte(pData[i])) {
+      completed++;
+    }
+  }
+  return completed;
+}
+
+static unsigned feed_frame(const uint8_t* pFrame, size_t length)
+{
+  uint8_t flag = HDLC_FLAG;
+  unsigned completed = feed(&flag, 1);
+  completed += feed(pFrame, length);
+  completed += feed(&flag, 1);
+  return completed;
+}
+
+static void test_crc(void)
+{
+  // CRC-16/X-25 check value
+  CHECK(han_tunnel_crc16_x25((const uint8_t*)"123456789", 9) == 0x906E);
+}
+
+static void test_segments(void)
+{
+  CHECK(han_tunnel_segment_count(1) == 1);
+
+  for(size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    uint8_t frame[HAN_TUNNEL_MAX_FRAME];
+    size_t length = cases[c].length;
+    build_frame(frame, length, (uint8_t)c);
+
+    han_tunnel_reset();
+    CHECK(feed_frame(frame, length) == 1);
+
+    size_t held_length = 0;
+    const uint8_t* pHeld = han_tunnel_frame(&held_length);
+    CHECK(pHeld != NULL);
+    if(pHeld == NULL) {
+      continue;
+    }
+    CHECK(held_length == length);
+    CHECK(memcmp(pHeld, frame, length) == 0);
+
+    uint16_t segments = han_tunnel_segment_count(held_length);
+    printf("%-17s %3zu bytes: %2u segments\n", cases[c].name, held_length, segments);
+    CHECK(segments == cases[c].segments);
+    // The last segment holds what's left, and never nothing
+    CHECK(held_length > (size_t)(segments - 1) * HAN_TUNNEL_SEGMENT_DATA);
+    CHECK(held_length <= (size_t)segments * HAN_TUNNEL_SEGMENT_DATA);
+    han_tunnel_release();
+  }
+}
+
+static void test_stream(void)
+{
+  static uint8_t stream[4 * HAN_TUNNEL_MAX_FRAME];
+  uint8_t list1[64];
+  uint8_t list2[160];
+  size_t length = 0;
+
+  build_frame(list1, cases[0].length, 1);
+  build_frame(list2, cases[3].length, 2);
+
+  // Noise, then list 1 and list 2 sharing a flag, then list 1 again after
+  // back-to-back flags
+  const uint8_t noise[] = {0x00, 0xFF, 0xA0, 0x13, 0x55};
+  memcpy(&stream[length], noise, sizeof(noise));
+  length += sizeof(noise);
+  stream[length++] = HDLC_FLAG;
+  memcpy(&stream[length], list1, cases[0].length);
+  length += cases[0].length;
+  stream[length++] = HDLC_FLAG;
+  memcpy(&stream[length], list2, cases[3].length);
+  length += cases[3].length;
+  stream[length++] = HDLC_FLAG;
+  stream[length++] = HDLC_FLAG;
+  memcpy(&stream[length], list1, cases[0].length);
+  length += cases[0].length;
+  stream[length++] = HDLC_FLAG;
+
+  han_tunnel_reset();
+  han_tunnel_counters_t before = *han_tunnel_counters();
+  size_t held_length;
+  unsigned completed = 0;
+  unsigned segments = 0;
+  for(size_t i = 0; i < length; i++) {
+    if(han_tunnel_input_byte(stream[i])) {
+      completed++;
+      // Forwarded right away, as the event loop would
+      CHECK(han_tunnel_frame(&held_length) != NULL);
+      segments += han_tunnel_segment_count(held_length);
+      han_tunnel_release();
+    }
+  }
+  CHECK(completed == 3);
+  CHECK(segments == 1 + 4 + 1);
+  CHECK(han_tunnel_counters()->frames - before.frames == 3);
+  CHECK(han_tunnel_counters()->crc_errors == before.crc_errors);
+}
+
+static void test_errors(void)
+{
+  uint8_t frame[160];
+  size_t length = cases[3].length;
+  build_frame(frame, length, 3);
+
+  // A flipped bit fails the FCS
+  han_tunnel_reset();
+  han_tunnel_counters_t before = *han_tunnel_counters();
+  frame[40] ^= 0x04;
+  CHECK(feed_frame(frame, length) == 0);
+  CHECK(han_tunnel_counters()->crc_errors - before.crc_errors == 1);
+  frame[40] ^= 0x04;
+
+  // A frame that isn't released keeps its place, the next one is lost
+  CHECK(feed_frame(frame, length) == 1);
+  CHECK(feed_frame(frame, length) == 0);
+  CHECK(han_tunnel_counters()->overruns - before.overruns == 1);
+  han_tunnel_release();
+  CHECK(feed_frame(frame, length) == 1);
+  han_tunnel_release();
+
+  // A length field past what we hold is dropped without collecting it
+  const uint8_t oversize[] = {HDLC_FLAG, 0xA7, 0xFF, 0x01, 0x02, HDLC_FLAG};
+  before = *han_tunnel_counters();
+  CHECK(feed(oversize, sizeof(oversize)) == 0);
+  CHECK(han_tunnel_counters()->oversize - before.oversize == 1);
+
+  // And the framer picks up again on the next frame
+  CHECK(feed_frame(frame, length) == 1);
+  han_tunnel_release();
+}
+
+int main(void)
+{
+  test_crc();
+  test_segments();
+  test_stream();
+  test_errors();
+  return test_result();
+}
@@ -0,0 +1,137 @@
+/***************************************************************************//**
+ * @file history_decoder.c
+ * @brief Reference decoder of the power history transfers
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#include "history_decoder.h"
+
+static uint32_t get_u16(const uint8_t* pData)
+{
+  return ((uint32_t)pData[0] << 8) | pData[1];
+}
+
+static uint32_t get_u32(const uint8_t* pData)
+{
+  return ((uint32_t)pData[0] << 24) | ((uint32_t)pData[1] << 16) |
+         ((uint32_t)pData[2] << 8) | pData[3];
+}
+
+// 7 bits per byte, least significant first, bit 7 set when more bytes follow.
+// Returns the bytes read, 0 if it runs past the end or over 64 bits.
+static size_t get_varint(const uint8_t* pData, size_t available, uint64_t* pValue)
+{
+  uint64_t value = 0;
+  for(size_t i = 0; i < available && i < 10; i++) {
+    value |= (uint64_t)(pData[i] & 0x7F) << (7 * i);
+    if(!(pData[i] & 0x80)) {
+      *pValue = value;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+// 0, -1, 1, -2, 2, ... from 0, 1, 2, 3, 4, ...
+static int64_t unzigzag(uint64_t value)
+{
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+bool history_decode(const uint8_t* pData, size_t length, history_transfer_t* pTransfer,
+                    history_sample_t sample, void* pContext)
+{
+  // Tier, time unit, flags, number of blocks
+  if(length < 5) {
+    return false;
+  }
+  pTransfer->tier = pData[0];
+  pTransfer->unit_ds = (uint16_t)get_u16(&pData[1]);
+  pTransfer->more = (pData[3] & 0x80) != 0;
+  pTransfer->blocks = pData[4];
+  size_t offset = 5;
+
+  for(uint8_t block = 0; block < pTransfer->blocks; block++) {
+    // Sequence number, age of the first sample, first value, number of
+    // samples, data length
+    if(length - offset < 12) {
+      return false;
+    }
+    uint16_t sequence = (uint16_t)get_u16(&pData[offset]);
+    uint32_t age = get_u32(&pData[offset + 2]);
+    int32_t value = (int32_t)get_u32(&pData[offset + 6]);
+    uint8_t samples = pData[offset + 10];
+    uint8_t data_length = pData[offset + 11];
+    offset += 12;
+    if(length - offset < data_length) {
+      return false;
+    }
+    const uint8_t* pBlock = &pData[offset];
+    offset += data_length;
+    pTransfer->last_sequence = sequence;
+
+    if(samples == 0) {
+      continue;
+    }
+    sample(pContext, sequence, age, value);
+
+    // The time step starts out at 0 in every block
+    int64_t step = 0;
+    size_t used = 0;
+    for(uint8_t i = 1; i < samples; i++) {
+      uint64_t word;
+      size_t read = get_varint(&pBlock[used], data_length - used, &word);
+      if(read == 0) {
+        return false;
+      }
+      used += read;
+
+      if(word & 1) {
+        uint64_t step_change;
+        read = get_varint(&pBlock[used], data_length - used, &step_change);
+        if(read == 0) {
+          return false;
+        }
+        used += read;
+        step += unzigzag(step_change);
+      }
+
+      // Ages count down as time goes on
+      if(step < 0 || (uint64_t)step > age) {
+        return false;
+      }
+      age -= (uint32_t)step;
+      // Changes can span the whole 32 bit range, wrap around like the encoder
+      value = (int32_t)((uint32_t)value + (uint32_t)unzigzag(word >> 1));
+      sample(pContext, sequence, age, value);
+    }
+
+    // Anything left over means the count and the data disagree
+    if(used != data_length) {
+      return false;
+    }
+  }
+
+  return offset == length;
+}
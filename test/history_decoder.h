@@ -0,0 +1,57 @@
+/***************************************************************************//**
+ * @file history_decoder.h
+ * @brief Reference decoder of the power history transfers
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_HISTORY_DECODER_H_
+#define AMS_HISTORY_DECODER_H_
+
+// Reads a reassembled History transfer (Manufacturer Proprietary type 0x03)
+// exactly as README.md describes it, without any of the firmware's code, so a
+// controller can start from it and the description gets checked against what
+// the device sends.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  uint8_t tier;
+  uint16_t unit_ds;       // length of a time unit, in tenths of a second
+  bool more;              // another transfer follows
+  uint8_t blocks;
+  uint16_t last_sequence; // of the last block, to resume from
+} history_transfer_t;
+
+// Called for every sample, oldest first. 'age' is in time units of the tier,
+// counted back from when the transfer was put together.
+typedef void (*history_sample_t)(void* pContext, uint16_t sequence, uint32_t age, int32_t value);
+
+// Returns false if the transfer doesn't follow the format, in which case some
+// samples may have been handed out already
+bool history_decode(const uint8_t* pData, size_t length, history_transfer_t* pTransfer,
+                    history_sample_t sample, void* pContext);
+
+#endif /* AMS_HISTORY_DECODER_H_ */
@@ -0,0 +1,201 @@
+/***************************************************************************//**
+ * @file history_test.c
+ * @brief Host test of the power history transfers against the reference decoder
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+// Packs every tier of a few days of history into transfers the way a History
+// Get does, reads them back with the reference decoder, and checks it gets the
+// same samples the history holds. Prints how many frames a day of each tier
+// takes to send.
+
+#include "timeseries.h"
+#include "history_wire.h"
+#include "history_decoder.h"
+#include "test_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// What a History Get packs into one transfer, see AMS2ZWAVE.c
+#define BLOCKS_PER_TRANSFER 4
+// Payload bytes per Manufacturer Proprietary segment, see
+// CC_ManufacturerProprietary.h
+#define SEGMENT_DATA 33
+
+#define SAMPLE_INTERVAL_MS 2500
+#define DAYS 3
+
+typedef struct {
+  uint16_t sequence;
+  uint32_t age;
+  int32_t value;
+} sample_t;
+
+static sample_t* decoded;
+static uint32_t decoded_count;
+
+static void collect(void* pContext, uint16_t sequence, uint32_t age, int32_t value)
+{
+  (void)pContext;
+  decoded[decoded_count++] = (sample_t){ sequence, age, value };
+}
+
+static void check_tier(timeseries_tier_t tier)
+{
+  static uint8_t payload[HISTORY_WIRE_TRANSFER_HEADER_SIZE +
+                         BLOCKS_PER_TRANSFER * HISTORY_WIRE_BLOCK_MAX_SIZE];
+  uint32_t now = timeseries_now(tier);
+  uint8_t block_count = timeseries_block_count(tier);
+  uint32_t segments = 0;
+  decoded_count = 0;
+
+  for(uint8_t first = 0; first < block_count; first += BLOCKS_PER_TRANSFER) {
+    uint8_t blocks = block_count - first < BLOCKS_PER_TRANSFER ? block_count - first : BLOCKS_PER_TRANSFER;
+    bool more = first + blocks < block_count;
+
+    size_t length = history_wire_put_header(payload, tier, more, blocks);
+    for(uint8_t b = 0; b < blocks; b++) {
+      uint8_t block_length = history_wire_put_block(&payload[length], timeseries_block(tier, first + b), now);
+      CHECK(block_length <= HISTORY_WIRE_BLOCK_MAX_SIZE);
+      length += block_length;
+    }
+    CHECK(length <= sizeof(payload));
+    segments += (length + SEGMENT_DATA - 1) / SEGMENT_DATA;
+
+    history_transfer_t transfer;
+    CHECK(history_decode(payload, length, &transfer, collect, NULL));
+    CHECK(transfer.tier == tier);
+    CHECK(transfer.unit_ds == timeseries_unit_ds(tier));
+    CHECK(transfer.more == more);
+    CHECK(transfer.blocks == blocks);
+    CHECK(transfer.last_sequence == timeseries_block(tier, first + blocks - 1)->sequence);
+
+    // A transfer cut short anywhere doesn't decode
+    for(size_t cut = 0; cut < length; cut += 7) {
+      uint32_t kept = decoded_count;
+      CHECK(!history_decode(payload, cut, &transfer, collect, NULL));
+      decoded_count = kept;
+    }
+  }
+
+  // The same samples as walking the blocks directly
+  uint32_t index = 0;
+  uint32_t oldest = 0;
+  for(uint8_t b = 0; b < block_count; b++) {
+    const timeseries_block_t* pBlock = timeseries_block(tier, b);
+    timeseries_cursor_t cursor;
+    timeseries_cursor_init(&cursor, pBlock);
+    uint32_t time;
+    int32_t value;
+    while(timeseries_next(&cursor, &time, &value)) {
+      if(index == 0) {
+        oldest = time;
+      }
+      CHECK(index < decoded_count);
+      if(index < decoded_count) {
+        CHECK(decoded[index].sequence == pBlock->sequence);
+        CHECK(decoded[index].age == now - time);
+        CHECK(decoded[index].value == value);
+      }
+      index++;
+    }
+  }
+  CHECK(index == decoded_count);
+
+  uint32_t covered_ds = (now - oldest) * timeseries_unit_ds(tier);
+  printf("tier %u: %u samples in %u blocks, %u frames, %u frames per day of history\n",
+         tier, decoded_count, block_count, segments,
+         covered_ds > 0 ? (uint32_t)((uint64_t)segments * 24 * 60 * 60 * 10 / covered_ds) : 0);
+}
+
+// Hand-made transfer: one block of three samples, 2 units apart from the
+// second on. Then the same with a sample count which doesn't match the data,
+// a runaway varint, time steps which go backwards or past the present, and
+// bytes after the last block, all of which are turned down.
+static void check_malformed(void)
+{
+  history_transfer_t transfer;
+  uint8_t frame[] = {
+    0x00, 0x00, 0x05, 0x00, 0x01,
+    0x00, 0x07, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x01, 0xF4, 0x03, 0x03,
+    0x05, 0x04, 0x02
+  };
+
+  decoded_count = 0;
+  CHECK(history_decode(frame, sizeof(frame), &transfer, collect, NULL));
+  CHECK(transfer.unit_ds == 5 && !transfer.more && transfer.last_sequence == 7);
+  CHECK(decoded_count == 3);
+  CHECK(decoded[0].age == 10 && decoded[0].value == 500);
+  CHECK(decoded[1].age == 8 && decoded[1].value == 501);
+  CHECK(decoded[2].age == 6 && decoded[2].value == 500);
+
+  frame[15] = 0x04;
+  CHECK(!history_decode(frame, sizeof(frame), &transfer, collect, NULL));
+  frame[15] = 0x02;
+  CHECK(!history_decode(frame, sizeof(frame), &transfer, collect, NULL));
+  frame[15] = 0x03;
+
+  frame[19] = 0x82;
+  CHECK(!history_decode(frame, sizeof(frame), &transfer, collect, NULL));
+  frame[19] = 0x02;
+
+  frame[18] = 0x03;
+  CHECK(!history_decode(frame, sizeof(frame), &transfer, collect, NULL));
+  frame[18] = 0x7E;
+  CHECK(!history_decode(frame, sizeof(frame), &transfer, collect, NULL));
+  frame[18] = 0x04;
+
+  uint8_t longer[sizeof(frame) + 1] = {0};
+  memcpy(longer, frame, sizeof(frame));
+  CHECK(history_decode(longer, sizeof(frame), &transfer, collect, NULL));
+  CHECK(!history_decode(longer, sizeof(longer), &transfer, collect, NULL));
+}
+
+int main(void)
+{
+  uint32_t total = DAYS * 24UL * 60 * 60 * 1000 / SAMPLE_INTERVAL_MS;
+  decoded = malloc(total * sizeof(sample_t));
+  CHECK(decoded != NULL);
+
+  check_malformed();
+
+  // A household load, with a frame lost now and then so the time step changes
+  uint32_t now_ms = 1000;
+  int32_t power = 800;
+  for(uint32_t i = 0; i < total; i++) {
+    power += (int32_t)(test_random() % 401) - 200;
+    if(test_random() % 500 == 0) {
+      power = -(power / 2);
+    }
+    timeseries_append(power, now_ms);
+    now_ms += SAMPLE_INTERVAL_MS * (test_random() % 50 == 0 ? 2 : 1);
+  }
+
+  for(uint8_t tier = 0; tier < TIMESERIES_TIER_COUNT; tier++) {
+    check_tier(tier);
+  }
+  return test_result();
+}
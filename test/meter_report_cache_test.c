@@ -0,0 +1,208 @@
+/***************************************************************************//**
+ * @file meter_report_cache_test.c
+ * @brief Host test and benchmark of the Meter Get answers
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+// Checks every Get a controller can send to each endpoint finds the right
+// pre-encoded report, or none, then times answering Gets from the cache
+// against encoding the report for every Get.
+
+#include "meter_report_cache.h"
+#include "meter_value.h"
+#include "test_util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define METER_CC 0x32
+#define METER_REPORT 0x02
+
+#define GETS 1000000
+
+typedef struct {
+  uint8_t rate;
+  uint8_t scale;
+  uint8_t precision;
+  int32_t value;
+} cached_report_t;
+
+// What the firmware puts in each entry, with made up readings
+static const cached_report_t reports[METER_CACHE_COUNT] = {
+  [METER_CACHE_KWH]          = {RT_IMPORT, SCALE_KWH, 3, 123456789},
+  [METER_CACHE_W]            = {RT_IMPORT, SCALE_W, 0, 2345},
+  [METER_CACHE_KWH_EXPORT]   = {RT_EXPORT, SCALE_KWH, 3, 4567890},
+  [METER_CACHE_W_EXPORT]     = {RT_EXPORT, SCALE_W, 0, 0},
+  [METER_CACHE_KVAH]         = {RT_IMPORT, SCALE_KVAH, 3, 130012345},
+  [METER_CACHE_PF]           = {RT_IMPORT, SCALE_PF, 2, 97},
+  [METER_CACHE_KVAR]         = {RT_IMPORT, SCALE_KVAR, 3, 512},
+  [METER_CACHE_KVARH]        = {RT_IMPORT, SCALE_KVARH, 3, 23456789},
+  [METER_CACHE_KVAR_EXPORT]  = {RT_EXPORT, SCALE_KVAR, 3, 0},
+  [METER_CACHE_KVARH_EXPORT] = {RT_EXPORT, SCALE_KVARH, 3, 345678},
+  [METER_CACHE_V_L1]         = {RT_IMPORT, SCALE_V, 0, 231},
+  [METER_CACHE_V_L2]         = {RT_IMPORT, SCALE_V, 0, 229},
+  [METER_CACHE_V_L3]         = {RT_IMPORT, SCALE_V, 0, 232},
+  [METER_CACHE_A_L1]         = {RT_IMPORT, SCALE_A, 3, 4321},
+  [METER_CACHE_A_L2]         = {RT_IMPORT, SCALE_A, 3, 1234},
+  [METER_CACHE_A_L3]         = {RT_IMPORT, SCALE_A, 3, 987},
+  [METER_CACHE_KWH_ESTIMATE] = {RT_IMPORT, SCALE_KWH, 3, 123460000},
+};
+
+static uint8_t encode(uint8_t* pFrame, const cached_report_t* pReport)
+{
+  pFrame[0] = METER_CC;
+  pFrame[1] = METER_REPORT;
+  return 2 + meter_value_encode(&pFrame[2], pReport->rate, pReport->scale, pReport->precision,
+                                pReport->value, 0, 0);
+}
+
+static void refresh(void)
+{
+  for(size_t i = 0; i < METER_CACHE_COUNT; i++) {
+    meter_report_cache[i].length = encode(meter_report_cache[i].frame, &reports[i]);
+  }
+}
+
+// The entry a Get should find, -1 for no support
+static int expected_entry(uint8_t endpoint, uint8_t rate, uint8_t scale)
+{
+  if(rate == RT_DEFAULT) {
+    rate = RT_IMPORT;
+  }
+  if(endpoint == ENDPOINT_ENERGY_ESTIMATE) {
+    return rate == RT_IMPORT && scale == SCALE_KWH ? METER_CACHE_KWH_ESTIMATE : -1;
+  }
+  if(endpoint > ENDPOINT_ENERGY_ESTIMATE) {
+    return -1;
+  }
+  if(endpoint != 0) {
+    // The phases only have their voltage and current
+    if(rate != RT_IMPORT) {
+      return -1;
+    }
+    if(scale == SCALE_V) {
+      return METER_CACHE_V_L1 + endpoint - 1;
+    }
+    if(scale == SCALE_A) {
+      return METER_CACHE_A_L1 + endpoint - 1;
+    }
+    return -1;
+  }
+  // The root answers for phase 1 and everything else there is
+  for(int i = 0; i < METER_CACHE_COUNT; i++) {
+    if(i == METER_CACHE_KWH_ESTIMATE ||
+       (i > METER_CACHE_V_L1 && i <= METER_CACHE_V_L3) ||
+       (i > METER_CACHE_A_L1 && i <= METER_CACHE_A_L3)) {
+      continue;
+    }
+    if(reports[i].rate == rate && reports[i].scale == scale) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void test_lookup(void)
+{
+  unsigned supported = 0;
+
+  for(uint8_t endpoint = 0; endpoint <= ENDPOINT_ENERGY_ESTIMATE + 1; endpoint++) {
+    for(uint8_t rate = RT_DEFAULT; rate <= 3; rate++) {
+      for(uint8_t scale = 0; scale <= SCALE_KVARH + 1; scale++) {
+        const meter_report_cache_entry_t* pEntry = meter_report_cache_lookup(endpoint, rate, scale);
+        int expected = expected_entry(endpoint, rate, scale);
+        if(rate == 3) {
+          // Not a rate type; the handler turns it down before looking it up
+          continue;
+        }
+        if(expected < 0) {
+          CHECK(pEntry == NULL);
+          continue;
+        }
+        CHECK(pEntry == &meter_report_cache[expected]);
+        supported++;
+      }
+    }
+  }
+
+  // Root: import kWh, kVAh, W, V, A, PF, kvar, kvarh and export kWh, W, kvar,
+  // kvarh. Phases: V and A. Estimate: kWh. All of the import ones twice, for
+  // the default rate type.
+  CHECK(supported == 2 * 8 + 4 + 3 * 2 * 2 + 2 * 1);
+}
+
+static void bench(void)
+{
+  uint8_t frame[METER_REPORT_MAX_SIZE];
+  uint32_t checksum_cached = 0;
+  uint32_t checksum_encoded = 0;
+  static const uint8_t scales[] = {SCALE_KWH, SCALE_W, SCALE_V, SCALE_A, SCALE_KVAR, SCALE_PF};
+
+  // A controller polling the root device for the usual values. Either way
+  // the transport gets a frame and its length to copy into its queue.
+  uint64_t start = test_now_ns();
+  for(uint32_t i = 0; i < GETS; i++) {
+    const meter_report_cache_entry_t* pEntry =
+      meter_report_cache_lookup(0, RT_IMPORT, scales[i % sizeof(scales)]);
+    checksum_cached += pEntry->frame[pEntry->length - 1] + pEntry->length;
+  }
+  uint64_t cached_ns = test_now_ns() - start;
+
+  start = test_now_ns();
+  for(uint32_t i = 0; i < GETS; i++) {
+    const meter_report_cache_entry_t* pEntry =
+      meter_report_cache_lookup(0, RT_IMPORT, scales[i % sizeof(scales)]);
+    uint8_t length = encode(frame, &reports[pEntry - meter_report_cache]);
+    checksum_encoded += frame[length - 1] + length;
+  }
+  uint64_t encoded_ns = test_now_ns() - start;
+
+  CHECK(checksum_cached == checksum_encoded);
+  printf("%u Gets: %.1f ns from the cache, %.1f ns encoding each time\n",
+         GETS, (double)cached_ns / GETS, (double)encoded_ns / GETS);
+}
+
+int main(void)
+{
+  refresh();
+
+  // The cached frames are the same a Get used to be answered with
+  for(size_t i = 0; i < METER_CACHE_COUNT; i++) {
+    uint8_t frame[METER_REPORT_MAX_SIZE];
+    uint8_t length = encode(frame, &reports[i]);
+    CHECK(meter_report_cache[i].length == length);
+    CHECK(memcmp(meter_report_cache[i].frame, frame, length) == 0);
+  }
+
+  test_lookup();
+
+  // An entry without a reading behind it isn't answered
+  meter_report_cache[METER_CACHE_PF].length = 0;
+  CHECK(meter_report_cache_lookup(0, RT_IMPORT, SCALE_PF) == NULL);
+  CHECK(meter_report_cache_lookup(0, RT_IMPORT, SCALE_W) == &meter_report_cache[METER_CACHE_W]);
+  refresh();
+
+  bench();
+  return test_result();
+}
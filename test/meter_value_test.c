@@ -0,0 +1,282 @@
+/***************************************************************************//**
+ * @file meter_value_test.c
+ * @brief Host round-trip test of the compact Meter Report values
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+// Encodes values of all sizes, signs, precisions and scales, decodes them back
+// the way a controller reads a Meter Report V5, and checks nothing was lost
+// and the smallest field was used. Prints the average frame size against the
+// fixed 4 byte fields.
+
+#include "meter_value.h"
+#include "test_util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+  uint8_t rate;
+  uint8_t scale;
+  uint8_t precision;
+  uint8_t size;
+  int32_t value;
+  uint16_t delta_time_s;
+  bool has_previous;
+  int32_t previous;
+  uint8_t length;
+} decoded_t;
+
+static int32_t get_value(const uint8_t* pFrame, uint8_t size)
+{
+  uint32_t value = 0;
+  for(uint8_t i = 0; i < size; i++) {
+    value = (value << 8) | pFrame[i];
+  }
+  // Sign extend from the field size
+  if(size < 4 && (value & (1UL << (8 * size - 1)))) {
+    value |= ~0UL << (8 * size);
+  }
+  return (int32_t)value;
+}
+
+// Straight from the Meter Report V5 frame layout, independent of the encoder
+static bool decode(const uint8_t* pFrame, uint8_t length, decoded_t* pDecoded)
+{
+  uint8_t i = 0;
+  if(length < 2) {
+    return false;
+  }
+  CHECK((pFrame[0] & 0x1F) == 0x01);
+  pDecoded->rate = (pFrame[0] >> 5) & 0x3;
+  pDecoded->scale = ((pFrame[0] >> 5) & 0x4) | ((pFrame[1] >> 3) & 0x3);
+  pDecoded->precision = pFrame[1] >> 5;
+  pDecoded->size = pFrame[1] & 0x7;
+  i = 2;
+
+  if(pDecoded->size != 1 && pDecoded->size != 2 && pDecoded->size != 4) {
+    return false;
+  }
+  if(length < i + pDecoded->size + 2) {
+    return false;
+  }
+  pDecoded->value = get_value(&pFrame[i], pDecoded->size);
+  i += pDecoded->size;
+
+  pDecoded->delta_time_s = ((uint16_t)pFrame[i] << 8) | pFrame[i + 1];
+  i += 2;
+
+  pDecoded->has_previous = pDecoded->delta_time_s > 0;
+  pDecoded->previous = 0;
+  if(pDecoded->has_previous) {
+    if(length < i + pDecoded->size) {
+      return false;
+    }
+    pDecoded->previous = get_value(&pFrame[i], pDecoded->size);
+    i += pDecoded->size;
+  }
+
+  if(pDecoded->scale == 7) {
+    if(length < i + 1) {
+      return false;
+    }
+    pDecoded->scale += pFrame[i++];
+  }
+
+  pDecoded->length = i;
+  return i == length;
+}
+
+static uint8_t smallest_size(int32_t value)
+{
+  return value >= INT8_MIN && value <= INT8_MAX ? 1 :
+         value >= INT16_MIN && value <= INT16_MAX ? 2 : 4;
+}
+
+static int64_t power_of_ten(uint8_t exponent)
+{
+  int64_t result = 1;
+  while(exponent-- > 0) {
+    result *= 10;
+  }
+  return result;
+}
+
+static uint32_t frames = 0;
+static uint32_t frame_bytes = 0;
+static uint32_t fixed_bytes = 0;
+
+static void round_trip(uint8_t rate, uint8_t scale, uint8_t precision,
+                       int32_t value, int32_t previous, uint16_t delta_time_s)
+{
+  uint8_t frame[METER_VALUE_MAX_LENGTH + 1];
+  frame[METER_VALUE_MAX_LENGTH] = 0xA5;
+
+  uint8_t length = meter_value_encode(frame, rate, scale, precision, value, previous, delta_time_s);
+  CHECK(length <= METER_VALUE_MAX_LENGTH);
+  CHECK(frame[METER_VALUE_MAX_LENGTH] == 0xA5);
+
+  decoded_t decoded;
+  if(!decode(frame, length, &decoded)) {
+    CHECK(!"frame decodes");
+    return;
+  }
+  CHECK(decoded.rate == rate);
+  CHECK(decoded.scale == scale);
+  CHECK(decoded.delta_time_s == delta_time_s);
+  CHECK(decoded.has_previous == (delta_time_s > 0));
+
+  // The same number, possibly with fewer trailing decimal zeros
+  CHECK(decoded.precision <= precision);
+  int64_t factor = power_of_ten(precision - decoded.precision);
+  CHECK((int64_t)decoded.value * factor == value);
+  if(decoded.has_previous) {
+    CHECK((int64_t)decoded.previous * factor == previous);
+  }
+
+  // Nothing smaller would have held it, even with fewer decimals
+  uint8_t size = smallest_size(value);
+  if(decoded.has_previous && smallest_size(previous) > size) {
+    size = smallest_size(previous);
+  }
+  CHECK(decoded.size <= size);
+  int64_t reduced = value;
+  int64_t reduced_previous = decoded.has_previous ? previous : 0;
+  for(uint8_t p = precision; p > 0 && reduced % 10 == 0 && reduced_previous % 10 == 0; p--) {
+    reduced /= 10;
+    reduced_previous /= 10;
+    uint8_t reduced_size = smallest_size((int32_t)reduced);
+    if(decoded.has_previous && smallest_size((int32_t)reduced_previous) > reduced_size) {
+      reduced_size = smallest_size((int32_t)reduced_previous);
+    }
+    CHECK(decoded.size <= reduced_size);
+  }
+
+  frames++;
+  frame_bytes += length;
+  fixed_bytes += 2 + 4 + 2 + (delta_time_s > 0 ? 4 : 0) + (scale >= 7 ? 1 : 0);
+}
+
+static void test_vectors(void)
+{
+  uint8_t frame[METER_VALUE_MAX_LENGTH];
+
+  // 1234 W import, no previous value: 2 byte field
+  static const uint8_t power[] = { 0x21, 0x12, 0x04, 0xD2, 0x00, 0x00 };
+  CHECK(meter_value_encode(frame, 1, 2, 0, 1234, 0, 0) == sizeof(power));
+  CHECK(memcmp(frame, power, sizeof(power)) == 0);
+
+  // -5 W export with a previous value of 100 W, 30 s ago: 1 byte fields
+  static const uint8_t export[] = { 0x41, 0x11, 0xFB, 0x00, 0x1E, 0x64 };
+  CHECK(meter_value_encode(frame, 2, 2, 0, -5, 100, 30) == sizeof(export));
+  CHECK(memcmp(frame, export, sizeof(export)) == 0);
+
+  // 230.000 V fits 2 bytes as 230.00 V. Bit 2 of the scale goes in byte 0.
+  static const uint8_t voltage[] = { 0xA1, 0x42, 0x59, 0xD8, 0x00, 0x00 };
+  CHECK(meter_value_encode(frame, 1, 4, 3, 230000, 0, 0) == sizeof(voltage));
+  CHECK(memcmp(frame, voltage, sizeof(voltage)) == 0);
+
+  // 12.5 kVarh goes out as scale 7 with 1 in scale 2
+  static const uint8_t kvarh[] = { 0xA1, 0x39, 0x7D, 0x00, 0x00, 0x01 };
+  CHECK(meter_value_encode(frame, 1, 8, 1, 125, 0, 0) == sizeof(kvarh));
+  CHECK(memcmp(frame, kvarh, sizeof(kvarh)) == 0);
+}
+
+static void test_edges(void)
+{
+  static const int32_t edges[] = {
+    0, 1, -1, INT8_MAX, INT8_MAX + 1, INT8_MIN, INT8_MIN - 1,
+    INT16_MAX, INT16_MAX + 1, INT16_MIN, INT16_MIN - 1,
+    INT32_MAX, INT32_MIN, 1000, -1000, 100000, 1280, -1290, 327680,
+  };
+  static const uint8_t count = sizeof(edges) / sizeof(edges[0]);
+
+  for(uint8_t scale = 0; scale <= 8; scale++) {
+    for(uint8_t precision = 0; precision <= 3; precision++) {
+      for(uint8_t i = 0; i < count; i++) {
+        round_trip(1, scale, precision, edges[i], 0, 0);
+        for(uint8_t j = 0; j < count; j++) {
+          round_trip(2, scale, precision, edges[i], edges[j], 0xFFFF);
+        }
+      }
+    }
+  }
+}
+
+// What the meters actually send: W, V, A and kWh readings, each with the
+// reading before it now and then
+static void test_readings(void)
+{
+  for(uint32_t i = 0; i < 200000; i++) {
+    int32_t value;
+    uint8_t scale;
+    uint8_t precision;
+    switch(i % 4) {
+      case 0:
+        scale = 2;
+        precision = 0;
+        value = (int32_t)(test_random() % 12000) - 2000;
+        break;
+      case 1:
+        scale = 4;
+        precision = 1;
+        value = 2200 + (int32_t)(test_random() % 200);
+        break;
+      case 2:
+        scale = 5;
+        precision = 2;
+        value = (int32_t)(test_random() % 6300);
+        break;
+      default:
+        scale = 0;
+        precision = 2;
+        value = (int32_t)(test_random() % 5000000);
+        break;
+    }
+
+    if(test_random() % 2) {
+      int32_t previous = value - (int32_t)(test_random() % 100);
+      round_trip(1, scale, precision, value, previous, (uint16_t)(1 + test_random() % 900));
+    } else {
+      round_trip(1, scale, precision, value, 0, 0);
+    }
+  }
+}
+
+int main(void)
+{
+  test_vectors();
+  test_edges();
+
+  frames = 0;
+  frame_bytes = 0;
+  fixed_bytes = 0;
+  uint32_t saved = meter_value_bytes_saved();
+  test_readings();
+  CHECK(meter_value_bytes_saved() - saved == fixed_bytes - frame_bytes);
+
+  printf("%u readings: %.2f bytes per value fields, %.2f with fixed 4 byte values\n",
+         frames, (double)frame_bytes / frames, (double)fixed_bytes / frames);
+  return test_result();
+}
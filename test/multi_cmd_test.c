@@ -0,0 +1,241 @@
+/***************************************************************************//**
+ * @file multi_cmd_test.c
+ * @brief Host test of the Multi Command bundles and their accounting
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+// Bundles a full root snapshot (W, kWh, kvar and exported kWh) and the phase
+// values the way the firmware does, splitting at the single frame payload, and
+// checks the commands come out unchanged and the frames and bytes saved add
+// up against sending each command in a frame of its own.
+
+#include "multi_cmd.h"
+#include "meter_value.h"
+#include "test_util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define METER_CC 0x32
+#define METER_REPORT 0x02
+
+#define MAX_COMMANDS 8
+#define MAX_FRAMES 8
+
+typedef struct {
+  uint8_t data[2 + METER_VALUE_MAX_LENGTH];
+  uint8_t length;
+} command_t;
+
+typedef struct {
+  uint8_t data[64];
+  uint8_t length;
+} frame_t;
+
+static void meter_report(command_t* pCmd, uint8_t rate, uint8_t scale, uint8_t precision,
+                         int32_t value, int32_t previous, uint16_t delta_time_s)
+{
+  pCmd->data[0] = METER_CC;
+  pCmd->data[1] = METER_REPORT;
+  pCmd->length = 2 + meter_value_encode(&pCmd->data[2], rate, scale, precision,
+                                        value, previous, delta_time_s);
+}
+
+// The root snapshot, with or without the previous values
+static size_t root_snapshot(command_t commands[MAX_COMMANDS], bool with_previous)
+{
+  uint16_t delta = with_previous ? 30 : 0;
+  meter_report(&commands[0], RT_IMPORT, SCALE_W, 0, 2345, 2107, delta);
+  meter_report(&commands[1], RT_IMPORT, SCALE_KWH, 3, 123456789, 123455012, delta);
+  meter_report(&commands[2], RT_IMPORT, SCALE_KVAR, 3, 512, 498, delta);
+  meter_report(&commands[3], RT_EXPORT, SCALE_KWH, 3, 4567890, 4567890, delta);
+  return 4;
+}
+
+// Voltage and current of three phases, as the firmware would bundle them if
+// they were on the root device
+static size_t phase_values(command_t commands[MAX_COMMANDS])
+{
+  for(uint8_t phase = 0; phase < 3; phase++) {
+    meter_report(&commands[2 * phase], RT_IMPORT, SCALE_V, 2, 23010 + phase * 45, 23000, 10);
+    meter_report(&commands[2 * phase + 1], RT_IMPORT, SCALE_A, 2, 1234 - phase * 300, 1100, 10);
+  }
+  return 6;
+}
+
+// Same loop as the snapshot: as many commands as fit, the rest in the next
+// frame. Returns the number of frames.
+static size_t bundle(const command_t* commands, size_t count, uint8_t capacity,
+                     frame_t frames[MAX_FRAMES], multi_cmd_stats_t* pStats)
+{
+  size_t frame_count = 0;
+  size_t next = 0;
+
+  while(next < count && frame_count < MAX_FRAMES) {
+    multi_cmd_bundle_t b;
+    frame_t* pFrame = &frames[frame_count];
+    multi_cmd_begin(&b, pFrame->data, capacity);
+    for(; next < count; next++) {
+      if(!multi_cmd_append(&b, commands[next].data, commands[next].length)) {
+        break;
+      }
+    }
+    pFrame->length = multi_cmd_finish(&b, pStats);
+    if(pFrame->length == 0) {
+      break; // a single command too big for the frame
+    }
+    frame_count++;
+  }
+  return frame_count;
+}
+
+// Take the frames apart again and check they hold exactly 'commands', in order
+static void check_frames(const command_t* commands, size_t count,
+                         const frame_t* frames, size_t frame_count)
+{
+  size_t next = 0;
+
+  for(size_t f = 0; f < frame_count; f++) {
+    const frame_t* pFrame = &frames[f];
+    if(pFrame->data[0] != 0x8F) {
+      // A bundle of one goes out as the bare command
+      CHECK(next < count);
+      CHECK(pFrame->length == commands[next].length);
+      CHECK(memcmp(pFrame->data, commands[next].data, pFrame->length) == 0);
+      next++;
+      continue;
+    }
+
+    CHECK(pFrame->data[1] == 0x01);
+    CHECK(pFrame->data[2] > 1);
+    uint8_t offset = MULTI_CMD_HEADER_BYTES;
+    for(uint8_t i = 0; i < pFrame->data[2]; i++) {
+      uint8_t length = pFrame->data[offset];
+      CHECK(next < count);
+      CHECK(length == commands[next].length);
+      CHECK(memcmp(&pFrame->data[offset + 1], commands[next].data, length) == 0);
+      offset += 1 + length;
+      next++;
+    }
+    CHECK(offset == pFrame->length);
+  }
+  CHECK(next == count);
+}
+
+// Bundle 'commands', check the frames, and return the bytes on air
+static size_t check_bundle(const char* name, const command_t* commands, size_t count,
+                           uint8_t capacity, size_t expected_frames)
+{
+  frame_t frames[MAX_FRAMES];
+  multi_cmd_stats_t stats = {0};
+
+  size_t frame_count = bundle(commands, count, capacity, frames, &stats);
+  check_frames(commands, count, frames, frame_count);
+
+  size_t unbundled = 0;
+  for(size_t i = 0; i < count; i++) {
+    unbundled += commands[i].length + FRAME_OVERHEAD_BYTES;
+  }
+  size_t bundled = 0;
+  for(size_t f = 0; f < frame_count; f++) {
+    CHECK(frames[f].length <= capacity);
+    bundled += frames[f].length + FRAME_OVERHEAD_BYTES;
+  }
+
+  printf("%-30s %zu commands: %zu frames / %zu bytes unbundled, %zu frames / %zu bytes bundled\n",
+         name, count, count, unbundled, frame_count, bundled);
+
+  CHECK(frame_count == expected_frames);
+  CHECK(stats.frames_saved == count - frame_count);
+  CHECK(stats.bytes_saved == unbundled - bundled);
+  CHECK(bundled < unbundled);
+  return bundled;
+}
+
+static void test_root_snapshot(void)
+{
+  command_t commands[MAX_COMMANDS];
+
+  // Without previous values the four reports (8, 10, 9 and 10 bytes) need 44
+  // bytes bundled, so the export goes in a bundle of one: as itself
+  size_t count = root_snapshot(commands, false);
+  check_bundle("root snapshot", commands, count, MULTI_CMD_MAX_PAYLOAD, 2);
+
+  // With them (10, 14, 11 and 14 bytes) two and two
+  count = root_snapshot(commands, true);
+  check_bundle("root snapshot, previous", commands, count, MULTI_CMD_MAX_PAYLOAD, 2);
+
+  // Without the cap it all goes in one, which would need Transport Service
+  size_t uncapped = check_bundle("root snapshot, uncapped", commands, count, sizeof(((frame_t*)0)->data), 1);
+  CHECK(uncapped - FRAME_OVERHEAD_BYTES > MULTI_CMD_MAX_PAYLOAD);
+}
+
+static void test_phase_values(void)
+{
+  command_t commands[MAX_COMMANDS];
+
+  // Six reports of 10 bytes, three to a frame
+  size_t count = phase_values(commands);
+  check_bundle("phase values", commands, count, MULTI_CMD_MAX_PAYLOAD, 2);
+}
+
+static void test_edges(void)
+{
+  uint8_t buf[MULTI_CMD_MAX_PAYLOAD];
+  multi_cmd_bundle_t b;
+  multi_cmd_stats_t stats = {0};
+
+  // Nothing in it, nothing to send
+  multi_cmd_begin(&b, buf, sizeof(buf));
+  CHECK(multi_cmd_finish(&b, &stats) == 0);
+
+  // Exactly at the cap fits, one byte over doesn't and leaves the bundle alone
+  uint8_t cmd[MULTI_CMD_MAX_PAYLOAD] = {METER_CC, METER_REPORT};
+  multi_cmd_begin(&b, buf, sizeof(buf));
+  CHECK(multi_cmd_append(&b, cmd, 10));
+  // What's left after the header, the first command and the next length byte
+  uint8_t room = MULTI_CMD_MAX_PAYLOAD - MULTI_CMD_HEADER_BYTES - (1 + 10) - 1;
+  CHECK(!multi_cmd_append(&b, cmd, room + 1));
+  CHECK(multi_cmd_count(&b) == 1);
+  CHECK(multi_cmd_append(&b, cmd, room));
+  CHECK(multi_cmd_count(&b) == 2);
+  CHECK(multi_cmd_finish(&b, &stats) == MULTI_CMD_MAX_PAYLOAD);
+  CHECK(stats.bundles_sent == 1);
+  CHECK(stats.frames_saved == 1);
+
+  // A bundle of one is not counted
+  multi_cmd_begin(&b, buf, sizeof(buf));
+  CHECK(multi_cmd_append(&b, cmd, 10));
+  CHECK(multi_cmd_finish(&b, &stats) == 10);
+  CHECK(stats.bundles_sent == 1);
+  CHECK(buf[0] == METER_CC && buf[1] == METER_REPORT);
+}
+
+int main(void)
+{
+  test_root_snapshot();
+  test_phase_values();
+  test_edges();
+  return test_result();
+}
@@ -0,0 +1,245 @@
+/***************************************************************************//**
+ * @file report_policy_test.c
+ * @brief Host test of the reporting policy on a trace of power readings
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+// Replays three hours of list1 power readings (power_trace.txt: the time in ms
+// and the power in W, one reading per line, every 2.5s with the meter's jitter)
+// through the policy for a few configurations, and checks the reports per hour
+// each of them ends up sending.
+
+#include "report_policy.h"
+#include "CC_Configuration.h"
+#include "tx_feedback.h"
+#include "test_util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TRACE_FILE "power_trace.txt"
+#define TRACE_MAX 8192
+#define MS_PER_HOUR 3600000UL
+
+// The policy reads its configuration straight from here
+SConfigurationData CC_ConfigurationData;
+
+// tx_feedback.c needs the SDK configuration; these are all the policy uses
+uint8_t tx_feedback_backoff_level = 0;
+
+uint32_t tx_feedback_scale_interval(uint32_t interval_ms)
+{
+  if(tx_feedback_backoff_level == 0) {
+    return interval_ms;
+  }
+  if(interval_ms == 0) {
+    interval_ms = 2500;
+  }
+  return interval_ms << tx_feedback_backoff_level;
+}
+
+static uint32_t trace_ms[TRACE_MAX];
+static int32_t trace_watt[TRACE_MAX];
+static size_t trace_length = 0;
+
+static bool load_trace(void)
+{
+  FILE* f = fopen(TRACE_FILE, "r");
+  if(f == NULL) {
+    printf("can't open %s\n", TRACE_FILE);
+    return false;
+  }
+
+  unsigned long ms;
+  long watt;
+  while(trace_length < TRACE_MAX && fscanf(f, "%lu %ld", &ms, &watt) == 2) {
+    trace_ms[trace_length] = ms;
+    trace_watt[trace_length] = watt;
+    trace_length++;
+  }
+  fclose(f);
+  return trace_length > 0;
+}
+
+static double trace_hours(void)
+{
+  return (double)(trace_ms[trace_length - 1] - trace_ms[0]) / MS_PER_HOUR;
+}
+
+// Run the trace through the power policy, starting the clock at 'start_ms' to
+// cover the wrap as well. Fills in the most reports seen in any one hour, and
+// returns the decisions taken during this run; the counters survive a reset.
+static const report_policy_counters_t* replay(uint32_t start_ms, uint32_t* pWorstHour)
+{
+  static report_policy_counters_t run;
+  uint32_t hour_start = trace_ms[0];
+  uint32_t in_hour = 0;
+
+  report_policy_reset();
+  report_policy_counters_t start = *report_policy_counters(METRIC_POWER);
+  *pWorstHour = 0;
+  for(size_t i = 0; i < trace_length; i++) {
+    if(trace_ms[i] - hour_start >= MS_PER_HOUR) {
+      hour_start = trace_ms[i];
+      in_hour = 0;
+    }
+    if(report_policy_evaluate(METRIC_POWER, trace_watt[i], start_ms + trace_ms[i])) {
+      in_hour++;
+      if(in_hour > *pWorstHour) {
+        *pWorstHour = in_hour;
+      }
+    }
+  }
+
+  const report_policy_counters_t* end = report_policy_counters(METRIC_POWER);
+  run.evaluated = end->evaluated - start.evaluated;
+  run.reported = end->reported - start.reported;
+  run.heartbeats = end->heartbeats - start.heartbeats;
+  run.suppressed_deadband = end->suppressed_deadband - start.suppressed_deadband;
+  run.suppressed_interval = end->suppressed_interval - start.suppressed_interval;
+  run.suppressed_rate = end->suppressed_rate - start.suppressed_rate;
+  return &run;
+}
+
+static void configure(uint8_t change_100w, uint8_t deadband_pct, uint8_t heartbeat_10s,
+                      uint8_t bucket_size, uint16_t refill_s)
+{
+  memset(&CC_ConfigurationData, 0, sizeof(CC_ConfigurationData));
+  CC_ConfigurationData.power_change_for_meter_report = change_100w;
+  CC_ConfigurationData.power_deadband_pct = deadband_pct;
+  CC_ConfigurationData.amount_of_10s_reports_for_meter_report = heartbeat_10s;
+  CC_ConfigurationData.power_bucket_size = bucket_size;
+  CC_ConfigurationData.power_refill_interval = refill_s;
+  tx_feedback_backoff_level = 0;
+}
+
+// Reports a plain deadband around the last report gives for the trace
+static uint32_t deadband_reports(uint32_t deadband_abs, uint8_t deadband_pct)
+{
+  uint32_t reports = 1;
+  int32_t last = trace_watt[0];
+  for(size_t i = 1; i < trace_length; i++) {
+    int32_t change = trace_watt[i] > last ? trace_watt[i] - last : last - trace_watt[i];
+    if((deadband_abs > 0 && (uint32_t)change > deadband_abs) ||
+       (deadband_pct > 0 && (uint32_t)change * 100 > (uint32_t)last * deadband_pct)) {
+      reports++;
+      last = trace_watt[i];
+    }
+  }
+  return reports;
+}
+
+static void print_rate(const char* name, const report_policy_counters_t* c, uint32_t worst)
+{
+  printf("%-24s %7.1f reports/h (worst hour %u), %u evaluated, %u heartbeats, "
+         "%u deadband, %u rate suppressed\n",
+         name, c->reported / trace_hours(), worst, c->evaluated, c->heartbeats,
+         c->suppressed_deadband, c->suppressed_rate);
+}
+
+static void test_deadband(void)
+{
+  uint32_t worst;
+
+  // Parameter 2 at 500W: only the kettle and the oven get through
+  configure(5, 0, 0, 0, 0);
+  const report_policy_counters_t* c = replay(0, &worst);
+  print_rate("deadband 500W", c, worst);
+  CHECK(c->reported == deadband_reports(500, 0));
+  CHECK(c->heartbeats == 0);
+  CHECK(c->reported + c->suppressed_deadband == trace_length);
+  CHECK(c->reported / trace_hours() < 60);
+
+  // 10% of the last report also follows the fridge and the heat pump
+  configure(0, 10, 0, 0, 0);
+  c = replay(0, &worst);
+  print_rate("deadband 10%", c, worst);
+  CHECK(c->reported == deadband_reports(0, 10));
+  CHECK(c->reported > deadband_reports(500, 0));
+
+  // Same decisions when the clock wraps halfway through
+  uint32_t reported = c->reported;
+  c = replay(0u - (uint32_t)(MS_PER_HOUR + MS_PER_HOUR / 2), &worst);
+  CHECK(c->reported == reported);
+}
+
+static void test_rate_limit(void)
+{
+  uint32_t worst;
+
+  // A 2% deadband follows every bit of noise on the heat pump...
+  configure(0, 2, 0, 0, 0);
+  const report_policy_counters_t* c = replay(0, &worst);
+  uint32_t unlimited = c->reported;
+  print_rate("deadband 2%", c, worst);
+
+  // ...which a burst of 5 and a report a minute after that has to contain
+  configure(0, 2, 0, 5, 60);
+  c = replay(0, &worst);
+  print_rate("deadband 2%, 5 + 1/min", c, worst);
+  CHECK(c->suppressed_rate > 0);
+  CHECK(c->reported < unlimited);
+  CHECK(worst <= 5 + 60);
+  CHECK(c->reported <= 5 + (uint32_t)(trace_hours() * 60) + 1);
+}
+
+static void test_heartbeat(void)
+{
+  uint32_t worst;
+
+  // Parameter 1 at 3: a report every 30s whatever the readings do. The slack
+  // keeps the jitter on the readings from stretching it to 32.5s.
+  configure(0, 0, 3, 0, 0);
+  const report_policy_counters_t* c = replay(0, &worst);
+  print_rate("heartbeat 30s", c, worst);
+  CHECK(c->reported == c->heartbeats + 1);
+  CHECK(worst >= 119 && worst <= 121);
+  CHECK(c->reported / trace_hours() >= 119.0 && c->reported / trace_hours() <= 121.0);
+
+  // Heartbeats don't take tokens, so the rate limit doesn't thin them out
+  configure(0, 0, 3, 1, 600);
+  c = replay(0, &worst);
+  CHECK(c->suppressed_rate == 0);
+  CHECK(worst >= 119 && worst <= 121);
+
+  // One level of backoff doubles the interval
+  configure(0, 0, 3, 0, 0);
+  tx_feedback_backoff_level = 1;
+  c = replay(0, &worst);
+  print_rate("heartbeat 30s, backoff 1", c, worst);
+  CHECK(worst >= 59 && worst <= 61);
+}
+
+int main(void)
+{
+  if(!load_trace()) {
+    return 1;
+  }
+  printf("%zu readings, %.2f hours\n", trace_length, trace_hours());
+
+  test_deadband();
+  test_rate_limit();
+  test_heartbeat();
+  return test_result();
+}
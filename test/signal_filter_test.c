@@ -0,0 +1,214 @@
+/***************************************************************************//**
+ * @file signal_filter_test.c
+ * @brief Host test and benchmark of the reading filters
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+// Checks each stage of the filter chain on hand-made inputs, then runs a noisy
+// compressor load through the full chain and prints how much it calms the
+// output down and what a reading costs.
+
+#include "signal_filter.h"
+#include "test_util.h"
+
+#include <stdio.h>
+
+static void configure(uint8_t median_size, uint8_t ewma_shift, uint8_t hysteresis_pct)
+{
+  signal_filter_config_t config = {
+    .median_size = median_size,
+    .ewma_shift = ewma_shift,
+    .hysteresis_pct = hysteresis_pct,
+  };
+  signal_filter_configure(&config);
+  signal_filter_reset();
+}
+
+static void test_pass_through(void)
+{
+  int32_t value;
+
+  configure(1, 0, 0);
+  CHECK(!signal_filter_output(SIGNAL_FILTER_POWER, &value));
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 1234) == 1234);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, -77) == -77);
+  CHECK(signal_filter_output(SIGNAL_FILTER_POWER, &value) && value == -77);
+
+  // Channels don't see each other's readings
+  CHECK(!signal_filter_output(SIGNAL_FILTER_CURRENT_L1, &value));
+
+  // Out of range channels are passed through untouched
+  CHECK(signal_filter_add(SIGNAL_FILTER_CHANNEL_COUNT, 42) == 42);
+  CHECK(signal_filter_stats(SIGNAL_FILTER_CHANNEL_COUNT) == NULL);
+}
+
+static void test_median(void)
+{
+  // A single spike doesn't get through a window of three
+  configure(3, 0, 0);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 100) == 100);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 102) == 102);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 5000) == 102);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 101) == 102);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 103) == 103);
+
+  // An even size is rounded up, so two spikes in a row don't get through
+  configure(4, 0, 0);
+  for(uint8_t i = 0; i < 3; i++) {
+    signal_filter_add(SIGNAL_FILTER_POWER, 100);
+  }
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 5000) == 100);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 5000) == 100);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 5000) == 5000);
+
+  // Too large a window is capped, and a step still gets through eventually
+  configure(SIGNAL_FILTER_MEDIAN_MAX + 4, 0, 0);
+  int32_t output = 0;
+  uint8_t readings = 0;
+  while(output != 200 && readings < 2 * SIGNAL_FILTER_MEDIAN_MAX) {
+    output = signal_filter_add(SIGNAL_FILTER_POWER, readings < SIGNAL_FILTER_MEDIAN_MAX ? 100 : 200);
+    readings++;
+  }
+  CHECK(output == 200);
+  CHECK(readings == SIGNAL_FILTER_MEDIAN_MAX + SIGNAL_FILTER_MEDIAN_MAX / 2 + 1);
+}
+
+static void test_ewma(void)
+{
+  // Weight 1/4: 0, then a step to 100 closes a quarter of the gap each time
+  configure(1, 2, 0);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 0) == 0);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 100) == 25);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 100) == 44);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 100) == 58);
+
+  int32_t output = 0;
+  for(uint8_t i = 0; i < 50; i++) {
+    output = signal_filter_add(SIGNAL_FILTER_POWER, 100);
+  }
+  CHECK(output == 100);
+
+  // Same on the negative side, rounding away from zero
+  configure(1, 2, 0);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 0) == 0);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, -100) == -25);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, -100) == -44);
+
+  // No overflow at the ends of the range
+  configure(1, 1, 0);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, INT32_MAX) == INT32_MAX);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, INT32_MIN) < 0);
+}
+
+static void test_hysteresis(void)
+{
+  configure(1, 0, 10);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 1000) == 1000);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 1100) == 1000);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 900) == 1000);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 1101) == 1101);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 1000) == 1101);
+  CHECK(signal_filter_stats(SIGNAL_FILTER_POWER)->output_changes == 1);
+  CHECK(signal_filter_stats(SIGNAL_FILTER_POWER)->max_error == 101);
+
+  // Around zero the band is at least 1, so the output still follows
+  configure(1, 0, 10);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 0) == 0);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 1) == 0);
+  CHECK(signal_filter_add(SIGNAL_FILTER_POWER, 2) == 2);
+}
+
+static void test_configure_resets(void)
+{
+  int32_t value;
+
+  configure(1, 0, 0);
+  signal_filter_add(SIGNAL_FILTER_CURRENT_L2, 10);
+
+  // The same configuration again keeps the readings
+  signal_filter_config_t config = { .median_size = 1, .ewma_shift = 0, .hysteresis_pct = 0 };
+  signal_filter_configure(&config);
+  CHECK(signal_filter_output(SIGNAL_FILTER_CURRENT_L2, &value) && value == 10);
+
+  // A different one starts over
+  config.ewma_shift = 3;
+  signal_filter_configure(&config);
+  CHECK(!signal_filter_output(SIGNAL_FILTER_CURRENT_L2, &value));
+  CHECK(signal_filter_stats(SIGNAL_FILTER_CURRENT_L2)->samples == 0);
+}
+
+// A compressor load: 1.2 kW with a lot of meter noise, and a spike now and then
+static int32_t compressor_power(uint32_t sample)
+{
+  int32_t power = (sample / 200) % 2 ? 1500 : 300;
+  if(test_random() % 50 == 0) {
+    power += 3000;
+  }
+  return power + (int32_t)(test_random() % 201) - 100;
+}
+
+static void benchmark(void)
+{
+  static const uint32_t samples = 1000000;
+
+  configure(5, 2, 5);
+  uint32_t raw_changes = 0;
+  int32_t last = 0;
+  uint64_t total_ns = 0;
+  for(uint32_t i = 0; i < samples; i++) {
+    int32_t power = compressor_power(i);
+    if(i > 0 && power != last) {
+      raw_changes++;
+    }
+    last = power;
+
+    uint64_t before = test_now_ns();
+    signal_filter_add(SIGNAL_FILTER_POWER, power);
+    total_ns += test_now_ns() - before;
+  }
+
+  const signal_filter_stats_t* pStats = signal_filter_stats(SIGNAL_FILTER_POWER);
+  CHECK(pStats->samples == samples);
+  CHECK(pStats->output_changes < raw_changes / 5);
+
+  // The output still follows the load steps
+  CHECK(pStats->output_changes >= samples / 200);
+
+  printf("median 5, EWMA 1/4, hysteresis 5%%: %.1f ns per reading\n",
+         (double)total_ns / samples);
+  printf("%u changes in, %u out, mean error %.1f W, max %u W\n",
+         raw_changes, pStats->output_changes,
+         (double)pStats->total_error / pStats->samples, pStats->max_error);
+}
+
+int main(void)
+{
+  test_pass_through();
+  test_median();
+  test_ewma();
+  test_hysteresis();
+  test_configure_resets();
+  benchmark();
+  return test_result();
+}
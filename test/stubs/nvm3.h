@@ -0,0 +1,35 @@
+/***************************************************************************//**
+ * @file nvm3.h
+ * @brief Host stand-in for the SDK header of the same name
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+// Just enough of the SDK types for the declarations in CC_Configuration.h
+
+#ifndef AMS_TEST_STUB_NVM3_H_
+#define AMS_TEST_STUB_NVM3_H_
+
+typedef struct nvm3_Handle nvm3_Handle_t;
+
+#endif /* AMS_TEST_STUB_NVM3_H_ */
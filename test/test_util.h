@@ -0,0 +1,71 @@
+/***************************************************************************//**
+ * @file test_util.h
+ * @brief Checks, timing and random numbers shared by the host tests
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+#ifndef AMS_TEST_UTIL_H_
+#define AMS_TEST_UTIL_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static unsigned test_failures = 0;
+
+// Report a failed check and carry on, so one run shows all of them
+#define CHECK(condition) \
+  do { \
+    if(!(condition)) { \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      test_failures++; \
+    } \
+  } while(0)
+
+static inline int test_result(void)
+{
+  if(test_failures > 0) {
+    printf("FAILED: %u checks\n", test_failures);
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}
+
+// Same sequence on every run, so failures can be reproduced
+static inline uint32_t test_random(void)
+{
+  static uint32_t state = 12345;
+  state = state * 1103515245UL + 12345UL;
+  return state >> 8;
+}
+
+static inline uint64_t test_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#endif /* AMS_TEST_UTIL_H_ */
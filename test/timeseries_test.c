@@ -0,0 +1,231 @@
+/***************************************************************************//**
+ * @file timeseries_test.c
+ * @brief Host test and benchmark of the tiered power history
+ * @author github.com/stevew817
+ *
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ *******************************************************************************/
+
+// Feeds a week of synthetic 2.5 s household readings through the history, and
+// checks that every tier decodes back to exactly what went in and covers the
+// span it promises. Prints bytes/sample and the cost of appending and decoding.
+
+#include "timeseries.h"
+#include "test_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLE_INTERVAL_MS 2500
+#define SAMPLES_PER_DAY (24UL * 60 * 60 * 1000 / SAMPLE_INTERVAL_MS)
+#define DAYS 8
+
+// Power drawn by a house: base load, a fridge cycling, a water heater a few
+// times a day, cooking around dinner, a car charging some nights, solar
+// production around noon on sunny days, and meter noise on top of it all
+static int32_t household_power(uint32_t sample)
+{
+  uint32_t day = sample / SAMPLES_PER_DAY;
+  uint32_t second = (sample % SAMPLES_PER_DAY) * SAMPLE_INTERVAL_MS / 1000;
+  uint32_t hour = second / 3600;
+  int32_t power = 350;
+
+  if((second / 60) % 40 < 15) {
+    power += 120;
+  }
+  if(hour == 6 || hour == 17 || (hour == 22 && second % 3600 < 1800)) {
+    power += 2000;
+  }
+  if(hour >= 16 && hour < 19 && (second / 30) % 7 < 3) {
+    power += 1500 + (int32_t)(test_random() % 500);
+  }
+  if(day % 3 == 1 && (hour >= 23 || hour < 4)) {
+    power += 7200;
+  }
+  if(day % 2 == 0 && hour >= 9 && hour < 16) {
+    uint32_t from_noon = second > 12 * 3600 ? second - 12 * 3600 : 12 * 3600 - second;
+    power -= 4000 - (int32_t)(from_noon * 4000 / (4 * 3600));
+  }
+  return power + (int32_t)(test_random() % 41) - 20;
+}
+
+// What the aggregated tiers should hold: the rounded mean of each period
+typedef struct {
+  uint32_t time;
+  int32_t value;
+} expected_sample_t;
+
+static expected_sample_t* expected[TIMESERIES_TIER_COUNT];
+static uint32_t expected_count[TIMESERIES_TIER_COUNT];
+
+static void expect(timeseries_tier_t tier, uint32_t time, int32_t value)
+{
+  expected[tier][expected_count[tier]++] = (expected_sample_t){ time, value };
+}
+
+static int32_t rounded_mean(int64_t sum, uint32_t count)
+{
+  int64_t half = (sum >= 0 ? 1 : -1) * (int64_t)(count / 2);
+  return (int32_t)((sum + half) / (int64_t)count);
+}
+
+// Check every block of 'tier' against what went in, and return the time the
+// oldest sample held
+static uint32_t check_tier(timeseries_tier_t tier)
+{
+  uint32_t samples = 0;
+  uint32_t oldest = 0;
+  uint32_t first_index = 0;
+  bool found = false;
+
+  for(uint8_t b = 0; b < timeseries_block_count(tier); b++) {
+    const timeseries_block_t* pBlock = timeseries_block(tier, b);
+    CHECK(pBlock->length <= TIMESERIES_BLOCK_DATA);
+
+    if(!found) {
+      // Where the history picks up in the samples that went in
+      for(first_index = 0; first_index < expected_count[tier]; first_index++) {
+        if(expected[tier][first_index].time == pBlock->start) {
+          break;
+        }
+      }
+      CHECK(first_index < expected_count[tier]);
+      oldest = pBlock->start;
+      found = true;
+    }
+
+    timeseries_cursor_t cursor;
+    timeseries_cursor_init(&cursor, pBlock);
+    uint32_t time;
+    int32_t value;
+    while(timeseries_next(&cursor, &time, &value)) {
+      const expected_sample_t* pExpected = &expected[tier][first_index + samples];
+      CHECK(time == pExpected->time);
+      CHECK(value == pExpected->value);
+      samples++;
+    }
+    CHECK(cursor.index == pBlock->count);
+  }
+
+  // Nothing newer may be missing
+  CHECK(first_index + samples == expected_count[tier]);
+  return oldest;
+}
+
+int main(void)
+{
+  static const char* tier_names[TIMESERIES_TIER_COUNT] = { "raw", "1 minute", "15 minute" };
+  // How far back each tier has to reach, in its own units
+  static const uint32_t promised_span[TIMESERIES_TIER_COUNT] = {
+    10 * 60 * 2, 24 * 60, 7 * 24 * 4
+  };
+  uint32_t total = SAMPLES_PER_DAY * DAYS;
+
+  for(uint8_t tier = 0; tier < TIMESERIES_TIER_COUNT; tier++) {
+    expected[tier] = malloc(total * sizeof(expected_sample_t));
+    CHECK(expected[tier] != NULL);
+  }
+
+  int32_t* trace = malloc(total * sizeof(int32_t));
+  CHECK(trace != NULL);
+  for(uint32_t i = 0; i < total; i++) {
+    trace[i] = household_power(i);
+  }
+
+  // Start off the tick counter's zero, and let it wrap on the way
+  uint32_t start_ms = UINT32_MAX - 3UL * 24 * 60 * 60 * 1000;
+
+  int64_t sum[TIMESERIES_TIER_COUNT] = {0};
+  uint32_t sum_count[TIMESERIES_TIER_COUNT] = {0};
+  uint32_t period[TIMESERIES_TIER_COUNT] = {0};
+
+  uint64_t append_ns = 0;
+  for(uint32_t i = 0; i < total; i++) {
+    uint32_t now_ms = start_ms + i * SAMPLE_INTERVAL_MS;
+
+    uint64_t before = test_now_ns();
+    timeseries_append(trace[i], now_ms);
+    append_ns += test_now_ns() - before;
+
+    uint32_t now_ds = i * (SAMPLE_INTERVAL_MS / 100);
+    expect(TIMESERIES_TIER_RAW, now_ds / timeseries_unit_ds(TIMESERIES_TIER_RAW), trace[i]);
+    for(uint8_t tier = TIMESERIES_TIER_1MIN; tier < TIMESERIES_TIER_COUNT; tier++) {
+      uint32_t now = now_ds / timeseries_unit_ds(tier);
+      if(sum_count[tier] > 0 && now != period[tier]) {
+        expect(tier, period[tier], rounded_mean(sum[tier], sum_count[tier]));
+        sum[tier] = 0;
+        sum_count[tier] = 0;
+      }
+      period[tier] = now;
+      sum[tier] += trace[i];
+      sum_count[tier]++;
+    }
+  }
+
+  printf("%u samples appended, %.1f ns per append\n",
+         total, (double)append_ns / total);
+
+  size_t ram = (TIMESERIES_RAW_BLOCKS + TIMESERIES_1MIN_BLOCKS + TIMESERIES_15MIN_BLOCKS) *
+               sizeof(timeseries_block_t);
+  for(uint8_t tier = 0; tier < TIMESERIES_TIER_COUNT; tier++) {
+    uint32_t oldest = check_tier(tier);
+    uint32_t covered = timeseries_now(tier) - oldest;
+    const timeseries_stats_t* pStats = timeseries_stats(tier);
+
+    printf("%-9s tier: %.2f bytes/sample, %u of %u blocks, covers %u of %u units, %u blocks dropped for room\n",
+           tier_names[tier], (double)pStats->bytes / pStats->samples,
+           timeseries_block_count(tier),
+           tier == TIMESERIES_TIER_RAW ? TIMESERIES_RAW_BLOCKS :
+           tier == TIMESERIES_TIER_1MIN ? TIMESERIES_1MIN_BLOCKS : TIMESERIES_15MIN_BLOCKS,
+           covered, promised_span[tier], pStats->dropped);
+    CHECK(covered >= promised_span[tier]);
+  }
+  printf("%zu bytes of RAM\n", ram);
+
+  // Decoding the whole history, as a transfer of it would
+  uint64_t before = test_now_ns();
+  uint32_t decoded = 0;
+  int64_t checksum = 0;
+  for(uint8_t tier = 0; tier < TIMESERIES_TIER_COUNT; tier++) {
+    for(uint8_t b = 0; b < timeseries_block_count(tier); b++) {
+      timeseries_cursor_t cursor;
+      timeseries_cursor_init(&cursor, timeseries_block(tier, b));
+      uint32_t time;
+      int32_t value;
+      while(timeseries_next(&cursor, &time, &value)) {
+        checksum += value;
+        decoded++;
+      }
+    }
+  }
+  printf("%u samples decoded, %.1f ns per sample (checksum %lld)\n",
+         decoded, (double)(test_now_ns() - before) / decoded, (long long)checksum);
+
+  // Sequence numbers carry on over a reset
+  uint16_t sequence = timeseries_block(TIMESERIES_TIER_RAW, timeseries_block_count(TIMESERIES_TIER_RAW) - 1)->sequence;
+  timeseries_reset();
+  CHECK(timeseries_block_count(TIMESERIES_TIER_RAW) == 0);
+  timeseries_append(1000, start_ms + total * SAMPLE_INTERVAL_MS);
+  CHECK(timeseries_block(TIMESERIES_TIER_RAW, 0)->sequence == (uint16_t)(sequence + 1));
+
+  return test_result();
+}